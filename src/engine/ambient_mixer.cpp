@@ -0,0 +1,140 @@
+#include "ambient_mixer.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+bool AmbientMixer::start() {
+    if (hooked) return true;
+    int freq = 0, ch = 0;
+    Uint16 format = 0;
+    if (!Mix_QuerySpec(&freq, &format, &ch) || format != AUDIO_S16SYS) {
+        std::cerr << "Ambient mixer needs 16-bit output; ambients disabled" << std::endl;
+        return false;
+    }
+    rate = freq;
+    channels = ch;
+    scratch.assign(static_cast<size_t>(BLOCK_FRAMES) * channels, 0.0f);
+    Mix_HookMusic(&AmbientMixer::callback, this);
+    hooked = true;
+    return true;
+}
+
+void AmbientMixer::stop() {
+    if (!hooked) return;
+    Mix_HookMusic(nullptr, nullptr);  // Takes the audio lock, so no callback is still running
+    hooked = false;
+}
+
+bool AmbientMixer::push(const Command& c) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) == QUEUE_SIZE) return false;
+    queue[t & (QUEUE_SIZE - 1)] = c;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+}
+
+bool AmbientMixer::play(AmbientLayer layer, const Mix_Chunk* track, float fade_s) {
+    return push({Command::PLAY, static_cast<uint8_t>(layer), track, 1.0f, fade_s});
+}
+
+bool AmbientMixer::set_gain(AmbientLayer layer, float gain, float ramp_s) {
+    return push({Command::GAIN, static_cast<uint8_t>(layer), nullptr, std::max(0.0f, gain), ramp_s});
+}
+
+bool AmbientMixer::duck(AmbientLayer layer, float level, float hold_s) {
+    return push({Command::DUCK, static_cast<uint8_t>(layer), nullptr, std::clamp(level, 0.0f, 1.0f), hold_s});
+}
+
+float AmbientMixer::ramp_step(float from, float to, float seconds) const {
+    float frames = std::max(1.0f, seconds * rate);
+    return std::abs(to - from) / frames;
+}
+
+void AmbientMixer::apply(const Command& c) {
+    Layer& l = layers[c.layer];
+    switch (c.type) {
+    case Command::PLAY: {
+        const Mix_Chunk* track = c.track && c.track->alen >= sizeof(Sint16) * channels ? c.track : nullptr;
+        if (l.outgoing.track == track && track) std::swap(l.current, l.outgoing);  // Back to the one fading out
+        if (l.current.track != track) {
+            if (l.current.track) l.outgoing = l.current;  // Anything already fading out is cut
+            l.current = Voice();
+            l.current.track = track;
+        }
+        l.outgoing.target = 0.0f;
+        l.outgoing.step = ramp_step(l.outgoing.gain, 0.0f, c.seconds);
+        l.current.target = 1.0f;
+        l.current.step = ramp_step(l.current.gain, 1.0f, c.seconds);
+        break;
+    }
+    case Command::GAIN:
+        l.gain_target = c.value;
+        l.gain_step = ramp_step(l.gain, c.value, c.seconds);
+        break;
+    case Command::DUCK:
+        l.duck_level = c.value;
+        l.duck_hold = static_cast<size_t>(std::max(0.0f, c.seconds) * rate);
+        break;
+    }
+}
+
+void AmbientMixer::callback(void* self, Uint8* stream, int len) {
+    AmbientMixer& m = *static_cast<AmbientMixer*>(self);
+    size_t h = m.head.load(std::memory_order_relaxed), t = m.tail.load(std::memory_order_acquire);
+    for (; h != t; ++h) m.apply(m.queue[h & (QUEUE_SIZE - 1)]);
+    m.head.store(h, std::memory_order_release);
+    m.mix(reinterpret_cast<Sint16*>(stream), len / static_cast<int>(sizeof(Sint16) * m.channels));
+}
+
+void AmbientMixer::mix_layer(Layer& l, float* acc, int frames) {
+    const float attack = 1.0f / (DUCK_ATTACK_S * rate), release = 1.0f / (DUCK_RELEASE_S * rate);
+    Voice* voices[2] = {&l.current, &l.outgoing};
+    for (int f = 0; f < frames; ++f) {
+        if (l.gain < l.gain_target) l.gain = std::min(l.gain_target, l.gain + l.gain_step);
+        else if (l.gain > l.gain_target) l.gain = std::max(l.gain_target, l.gain - l.gain_step);
+        if (l.duck_hold > 0) {
+            --l.duck_hold;
+            l.duck = std::max(l.duck_level, l.duck - attack);
+        } else if (l.duck < 1.0f) {
+            l.duck = std::min(1.0f, l.duck + release);
+        }
+        float g = l.gain * l.duck * (1.0f / 32768.0f);
+
+        for (Voice* v : voices) {
+            if (!v->track) continue;
+            if (v->gain < v->target) v->gain = std::min(v->target, v->gain + v->step);
+            else if (v->gain > v->target) v->gain = std::max(v->target, v->gain - v->step);
+            const Sint16* src = reinterpret_cast<const Sint16*>(v->track->abuf) + v->pos * channels;
+            float k = g * v->gain;
+            for (int c = 0; c < channels; ++c) acc[f * channels + c] += src[c] * k;
+            if (++v->pos >= v->track->alen / (sizeof(Sint16) * channels)) v->pos = 0;  // Loops
+        }
+    }
+    if (l.outgoing.track && l.outgoing.gain <= 0.0f) l.outgoing = Voice();
+}
+
+void AmbientMixer::mix(Sint16* out, int frames) {
+    for (int done = 0; done < frames;) {
+        int n = std::min(BLOCK_FRAMES, frames - done);
+        bool any = false;
+        std::fill(scratch.begin(), scratch.begin() + static_cast<size_t>(n) * channels, 0.0f);
+        for (Layer& l : layers) {
+            if (!l.current.track && !l.outgoing.track) {  // Silent: ramps have nothing to shape
+                l.gain = l.gain_target;
+                l.duck = 1.0f;
+                l.duck_hold = 0;
+                continue;
+            }
+            mix_layer(l, scratch.data(), n);
+            any = true;
+        }
+        if (any) {  // On top of whatever is in the stream already
+            Sint16* dst = out + static_cast<size_t>(done) * channels;
+            for (int i = 0; i < n * channels; ++i) {
+                float s = dst[i] + scratch[i] * 32767.0f;
+                dst[i] = static_cast<Sint16>(std::clamp(s, -32768.0f, 32767.0f));
+            }
+        }
+        done += n;
+    }
+}
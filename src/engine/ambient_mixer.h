@@ -0,0 +1,75 @@
+#ifndef AMBIENT_MIXER_H
+#define AMBIENT_MIXER_H
+
+#include <SDL2/SDL_mixer.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "audio_sink.h"  // AmbientLayer
+
+// Looping ambient beds, mixed on SDL_mixer's audio thread in place of its one
+// music stream, so day/night music, weather and fire play at once. Each layer
+// plays one track and crossfades to the next; its gain and ducking ramp per
+// sample. The game thread only pushes commands into a single-producer,
+// single-consumer ring that the audio callback drains before each buffer, so
+// it never takes the mixer lock. Tracks are decoded chunks in the device
+// format and must outlive the mixer.
+class AmbientMixer {
+public:
+    static constexpr size_t QUEUE_SIZE = 256;  // Commands in flight; a power of two
+    static constexpr int BLOCK_FRAMES = 1024;  // Mixed at a time in float
+    static constexpr float DUCK_ATTACK_S = 0.05f;
+    static constexpr float DUCK_RELEASE_S = 0.5f;
+
+    AmbientMixer() = default;
+    ~AmbientMixer() { stop(); }
+    AmbientMixer(const AmbientMixer&) = delete;
+    AmbientMixer& operator=(const AmbientMixer&) = delete;
+
+    bool start();  // After Mix_OpenAudio; false unless the device is 16-bit
+    void stop();  // Unhooks; waits for the callback to finish
+
+    // Game thread. Each returns false if the ring is full; try again next frame
+    bool play(AmbientLayer layer, const Mix_Chunk* track, float fade_s);  // nullptr fades the layer out
+    bool set_gain(AmbientLayer layer, float gain, float ramp_s);
+    bool duck(AmbientLayer layer, float level, float hold_s);  // Dips to level, holds, then recovers
+    bool running() const { return hooked; }
+
+private:
+    struct Command {
+        enum Type : uint8_t { PLAY, GAIN, DUCK } type;
+        uint8_t layer;
+        const Mix_Chunk* track;
+        float value, seconds;
+    };
+    struct Voice {
+        const Mix_Chunk* track = nullptr;
+        size_t pos = 0;  // Frame
+        float gain = 0.0f, target = 0.0f, step = 0.0f;  // Crossfade, per frame
+    };
+    struct Layer {
+        Voice current, outgoing;
+        float gain = 1.0f, gain_target = 1.0f, gain_step = 0.0f;
+        float duck = 1.0f, duck_level = 1.0f;
+        size_t duck_hold = 0;  // Frames left at duck_level
+    };
+
+    static void callback(void* self, Uint8* stream, int len);
+    bool push(const Command& c);
+    void apply(const Command& c);
+    void mix(Sint16* out, int frames);
+    void mix_layer(Layer& layer, float* acc, int frames);
+    float ramp_step(float from, float to, float seconds) const;
+
+    // The ring: tail is written by the game thread, head by the audio thread
+    std::array<Command, QUEUE_SIZE> queue;
+    std::atomic<size_t> head{0}, tail{0};
+
+    std::array<Layer, AMBIENT_LAYERS> layers;  // Audio thread only once started
+    std::vector<float> scratch;  // BLOCK_FRAMES * channels
+    int rate = 44100, channels = 2;
+    bool hooked = false;
+};
+
+#endif
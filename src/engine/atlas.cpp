@@ -0,0 +1,102 @@
+#include "atlas.h"
+#include <algorithm>
+#include <cstdint>
+
+bool SpriteAtlas::place(Page& page, int w, int h, SDL_Rect& out) {
+    int x = page.shelf_x, y = page.shelf_y, row_h = page.shelf_h;
+    if (x + w > PAGE_SIZE) {  // Start a new row
+        y += row_h + PADDING;
+        x = 0;
+        row_h = 0;
+    }
+    if (y + h > PAGE_SIZE) return false;  // Page untouched, so a later, smaller sprite can still use the row
+    out = {x, y, w, h};
+    page.shelf_x = x + w + PADDING;
+    page.shelf_y = y;
+    page.shelf_h = std::max(row_h, h);
+    return true;
+}
+
+int SpriteAtlas::open_page() {
+    int slot = 0;
+    while (slot < static_cast<int>(pages.size()) && pages[slot].pixels) ++slot;
+    if (slot == static_cast<int>(pages.size())) pages.emplace_back();
+    pages[slot] = Page();
+    pages[slot].pixels = SDL_CreateSurface(PAGE_SIZE, PAGE_SIZE, SDL_PIXELFORMAT_RGBA32);
+    if (!pages[slot].pixels) {
+        SDL_Log("Atlas page error: %s", SDL_GetError());
+        return -1;
+    }
+    return slot;
+}
+
+AtlasRegion SpriteAtlas::add(SDL_Surface* surface, const SDL_Rect* src) {
+    SDL_Rect from = src ? *src : SDL_Rect{0, 0, surface->w, surface->h};
+    if (from.w <= 0 || from.h <= 0 || from.w > PAGE_SIZE || from.h > PAGE_SIZE) {
+        SDL_Log("Atlas: %dx%d sprite does not fit a %d page", from.w, from.h, PAGE_SIZE);
+        return {};
+    }
+
+    // First live page with room, else a fresh one
+    SDL_Rect to;
+    int page = 0;
+    while (page < static_cast<int>(pages.size()) && !(pages[page].pixels && place(pages[page], from.w, from.h, to))) ++page;
+    if (page == static_cast<int>(pages.size())) {
+        page = open_page();
+        if (page < 0) return {};
+        place(pages[page], from.w, from.h, to);
+    }
+
+    Page& p = pages[page];
+    SDL_SetSurfaceBlendMode(surface, SDL_BLENDMODE_NONE);  // Copy alpha as is
+    SDL_BlitSurface(surface, &from, p.pixels, &to);
+    if (p.dirty.w == 0) {
+        p.dirty = to;
+    } else {
+        int x1 = std::max(p.dirty.x + p.dirty.w, to.x + to.w), y1 = std::max(p.dirty.y + p.dirty.h, to.y + to.h);
+        p.dirty.x = std::min(p.dirty.x, to.x);
+        p.dirty.y = std::min(p.dirty.y, to.y);
+        p.dirty.w = x1 - p.dirty.x;
+        p.dirty.h = y1 - p.dirty.y;
+    }
+
+    const float size = static_cast<float>(PAGE_SIZE);
+    return {page, {to.x / size, to.y / size, to.w / size, to.h / size}, from.w, from.h};
+}
+
+SDL_Texture* SpriteAtlas::page_texture(int page) {
+    if (!page_live(page)) return nullptr;
+    Page& p = pages[page];
+    if (!p.texture) {
+        p.texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, PAGE_SIZE, PAGE_SIZE);
+        if (!p.texture) return nullptr;
+        SDL_SetTextureBlendMode(p.texture, SDL_BLENDMODE_BLEND);
+        p.dirty = {0, 0, PAGE_SIZE, PAGE_SIZE};
+    }
+    if (p.dirty.w > 0) {
+        const uint8_t* first = static_cast<const uint8_t*>(p.pixels->pixels) + p.dirty.y * p.pixels->pitch + p.dirty.x * 4;
+        SDL_UpdateTexture(p.texture, &p.dirty, first, p.pixels->pitch);
+        p.dirty = {0, 0, 0, 0};
+    }
+    return p.texture;
+}
+
+void SpriteAtlas::release_page(int page) {
+    if (!page_live(page)) return;
+    if (pages[page].texture) SDL_DestroyTexture(pages[page].texture);
+    SDL_DestroySurface(pages[page].pixels);
+    pages[page] = Page();
+}
+
+size_t SpriteAtlas::memory_bytes() const {
+    size_t bytes = 0;
+    for (const auto& page : pages) {
+        if (page.pixels) bytes += 4 * PAGE_SIZE * PAGE_SIZE * (page.texture ? 2 : 1);
+    }
+    return bytes;
+}
+
+void SpriteAtlas::clear() {
+    for (int page = 0; page < static_cast<int>(pages.size()); ++page) release_page(page);
+    pages.clear();
+}
@@ -0,0 +1,54 @@
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include <SDL3/SDL.h>
+#include <vector>
+
+static constexpr int LOADING_PAGE = -2;
+
+// Where a sprite ended up: page index plus normalised texture coordinates
+struct AtlasRegion {
+    int page = -1;  // -1 = not in the atlas, LOADING_PAGE = on its way (TextureManager)
+    SDL_FRect uv = {0, 0, 0, 0};
+    int w = 0, h = 0;  // Source size in pixels
+
+    bool valid() const { return page >= 0; }
+};
+
+// Packs sprites into a few large textures so that everything on one page can
+// be drawn with a single SDL_RenderGeometry call. Sprites are copied into a
+// CPU-side page and shelf-packed; the changed part of a page uploads on first
+// use after a change. Pages are freed whole, never single sprites.
+class SpriteAtlas {
+public:
+    static constexpr int PAGE_SIZE = 1024;
+    static constexpr int PADDING = 1;  // Transparent gap so linear filtering doesn't bleed
+
+    explicit SpriteAtlas(SDL_Renderer* r) : renderer(r) {}
+    ~SpriteAtlas() { clear(); }
+    SpriteAtlas(const SpriteAtlas&) = delete;
+    SpriteAtlas& operator=(const SpriteAtlas&) = delete;
+
+    AtlasRegion add(SDL_Surface* surface, const SDL_Rect* src = nullptr);  // Copies; src = nullptr for the whole surface
+    SDL_Texture* page_texture(int page);  // Uploads pending sprites first; nullptr for a released page
+    size_t page_count() const { return pages.size(); }  // Including released slots
+    bool page_live(int page) const { return page >= 0 && page < static_cast<int>(pages.size()) && pages[page].pixels; }
+    void release_page(int page);  // Its regions become invalid; the slot is reused
+    size_t memory_bytes() const;  // Per live page: its texture, and the CPU copy packing works on
+    void clear();
+
+private:
+    struct Page {
+        SDL_Surface* pixels = nullptr;
+        SDL_Texture* texture = nullptr;
+        SDL_Rect dirty = {0, 0, 0, 0};  // Not uploaded yet
+        int shelf_x = 0, shelf_y = 0, shelf_h = 0;  // Current row
+    };
+    bool place(Page& page, int w, int h, SDL_Rect& out);
+    int open_page();  // A released slot or a new one
+
+    SDL_Renderer* renderer;
+    std::vector<Page> pages;
+};
+
+#endif
@@ -1,79 +1,306 @@
 #include "audio.h"
 #include <SDL2/SDL_mixer.h>
+#include <nlohmann/json.hpp>
 #include <algorithm>
+#include <cmath>
+#include <fstream>
 #include <iostream>
 
+namespace {
+// Set from the audio thread as channels finish, so update() needn't poll Mix_Playing under the mixer lock
+std::atomic<uint32_t> finished_channels{0};
+
+void on_channel_finished(int channel) {
+    finished_channels.fetch_or(1u << channel, std::memory_order_relaxed);
+}
+}  // namespace
+
 AudioManager::AudioManager() {
     Mix_Init(MIX_INIT_OGG);
     Mix_OpenAudio(44100, AUDIO_S16SYS, 2, 2048);
-    Mix_AllocateChannels(num_channels);
+    Mix_AllocateChannels(num_channels);  // At most 32, one bit each in finished_channels
+    Mix_ChannelFinished(on_channel_finished);
+    voices.resize(num_channels);
+    ambient_mixer.start();
+    for (int i = 0; i < DECODE_THREADS; ++i) workers.emplace_back(&AudioManager::worker_loop, this);
 }
 
 AudioManager::~AudioManager() {
-    for (auto& pair : sfx) Mix_FreeChunk(pair.second);
-    for (auto& pair : music) Mix_FreeMusic(pair.second);
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    work_cv.notify_all();
+    for (auto& worker : workers) worker.join();
+    ambient_mixer.stop();  // Before its tracks go
+    Mix_ChannelFinished(nullptr);
+    Mix_HaltChannel(-1);
+    for (auto& l : loaded) {
+        if (l.chunk) Mix_FreeChunk(l.chunk);
+    }
+    for (auto& s : sounds) {
+        if (s.chunk) Mix_FreeChunk(s.chunk);
+    }
     Mix_CloseAudio();
     Mix_Quit();
 }
 
-void AudioManager::load_sfx(const std::string& path, const std::string& id) {
-    sfx[id] = Mix_LoadWAV(path.c_str());
-    if (!sfx[id]) std::cerr << "SFX load error: " << Mix_GetError() << std::endl;
+SoundId AudioManager::sound(const std::string& id) {
+    auto it = sound_ids.find(id);
+    if (it != sound_ids.end()) return it->second;
+    SoundId handle = static_cast<SoundId>(sounds.size());
+    sounds.emplace_back();
+    pending_slot.push_back(-1);
+    sound_ids.emplace(id, handle);
+    return handle;
 }
 
-void AudioManager::load_bgm(const std::string& path, const std::string& id) {
-    music[id] = Mix_LoadMUS(path.c_str());
-    if (!music[id]) std::cerr << "BGM load error: " << Mix_GetError() << std::endl;
+SoundId AudioManager::load_sfx(const std::string& path, const std::string& id) {
+    SoundId handle = sound(id);
+    Sound& s = sounds[handle];
+    if (s.path == path && s.state != State::FAILED) return handle;
+    if (s.ambient && s.state == State::RESIDENT) {  // The mixer may be reading it
+        std::cerr << "Ambient track already loaded: " << id << std::endl;
+        return handle;
+    }
+    if (s.state == State::RESIDENT) {  // A different file under the same id
+        for (int ch = 0; ch < num_channels; ++ch) {
+            if (voices[ch].sound == handle) Mix_HaltChannel(ch);
+        }
+        memory_used -= s.chunk->alen;
+        Mix_FreeChunk(s.chunk);
+        s.chunk = nullptr;
+    }
+    s.path = path;
+    s.state = State::UNLOADED;
+    request(handle);
+    return handle;
 }
 
-int AudioManager::play_sfx(const std::string& id, int volume, float pan, float distance) {
-    if (sfx.find(id) == sfx.end()) return -1;
-    int channel = Mix_PlayChannel(-1, sfx[id], 0);
-    if (channel != -1) {
-        int vol = std::max(0, static_cast<int>(volume / (distance + 1.0f)));
-        Mix_Volume(channel, vol);
-        // Pan: -128 left to 127 right
-        Mix_SetPanning(channel, static_cast<int>((pan + 1.0f) * 64 - 64), static_cast<int>((1.0f - pan) * 64));
+void AudioManager::set_sfx_policy(SoundId id, const SfxPolicy& policy) {
+    if (id >= 0 && id < static_cast<SoundId>(sounds.size())) sounds[id].policy = policy;
+}
+
+SoundId AudioManager::load_ambient(const std::string& path, const std::string& id) {
+    sounds[sound(id)].ambient = true;
+    return load_sfx(path, id);
+}
+
+bool AudioManager::load_manifest(const std::string& path) {
+    std::ifstream f(path);
+    nlohmann::json j = nlohmann::json::parse(f, nullptr, false);
+    if (!f.is_open() || j.is_discarded()) {
+        std::cerr << "Audio manifest error: " << path << std::endl;
+        return false;
+    }
+    std::string root = j.value("root", "");
+    for (const auto& entry : j.value("sfx", nlohmann::json::array())) {
+        SoundId id = sound(entry["id"]);
+        SfxPolicy& policy = sounds[id].policy;  // Anything left out keeps its current value
+        policy.priority = entry.value("priority", policy.priority);
+        policy.max_instances = entry.value("max_instances", policy.max_instances);
+        policy.cooldown_ms = entry.value("cooldown_ms", policy.cooldown_ms);
+        load_sfx(root + entry["file"].get<std::string>(), entry["id"]);
     }
-    return channel;
+    for (const auto& entry : j.value("ambient", nlohmann::json::array())) {
+        load_ambient(root + entry["file"].get<std::string>(), entry["id"]);
+    }
+    return true;
+}
+
+void AudioManager::request(SoundId id) {
+    Sound& s = sounds[id];
+    if (s.state != State::UNLOADED || s.path.empty()) return;
+    s.state = State::QUEUED;
+    queue_load({id, s.path});
 }
 
-void AudioManager::play_bgm(const std::string& id, int volume, int fade_ms) {
-    if (music.find(id) == music.end()) return;
-    if (current_bgm != id) {
-        stop_bgm(fade_ms / 2);
-        Mix_FadeInMusic(music[id], -1, fade_ms);
-        current_bgm = id;
+void AudioManager::queue_load(LoadJob job) {
+    ++loads_total;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        jobs.push_back(std::move(job));
     }
-    Mix_VolumeMusic(volume);
+    work_cv.notify_one();
 }
 
-void AudioManager::play_overlay(const std::string& id, int volume, bool additive) {
-    if (music.find(id) == music.end()) return;
-    if (current_overlay != id) {
-        stop_overlay(current_overlay, 500);
-        Mix_PlayMusic(music[id], -1);
-        Mix_VolumeMusic(volume);
-        current_overlay = id;
+void AudioManager::worker_loop() {
+    while (true) {
+        LoadJob job;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            work_cv.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (stopping) return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        Loaded result = {std::move(job), nullptr};
+        result.chunk = Mix_LoadWAV(result.job.path.c_str());  // To PCM in the output format
+        if (!result.chunk) std::cerr << "Audio load error: " << result.job.path << ": " << Mix_GetError() << std::endl;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            loaded.push_back(std::move(result));
+        }
+        ++loads_done;
     }
 }
 
-void AudioManager::stop_bgm(int fade_ms) {
-    if (!current_bgm.empty()) {
-        Mix_FadeOutMusic(fade_ms);
-        current_bgm = "";
+void AudioManager::collect() {
+    std::deque<Loaded> arrived;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        arrived.swap(loaded);
+    }
+    for (Loaded& l : arrived) {
+        Sound& s = sounds[l.job.sound];
+        if (s.state != State::QUEUED || s.path != l.job.path) {  // Superseded by a later load_sfx()
+            if (l.chunk) Mix_FreeChunk(l.chunk);
+            continue;
+        }
+        s.chunk = l.chunk;
+        s.state = l.chunk ? State::RESIDENT : State::FAILED;
+        s.last_used = frame;  // New arrivals count as used, so they aren't evicted straight away
+        if (l.chunk && !s.ambient) memory_used += l.chunk->alen;
     }
 }
 
-void AudioManager::stop_overlay(const std::string& id, int fade_ms) {
-    if (current_overlay == id) {
-        Mix_FadeOutMusic(fade_ms);
-        current_overlay = "";
+bool AudioManager::voice_playing(SoundId id) const {
+    for (const Voice& v : voices) {
+        if (v.sound == id) return true;
     }
+    return false;
 }
 
-void AudioManager::crossfade_bgm(const std::string& new_id, int fade_ms) {
-    play_bgm(new_id, 60, fade_ms);
+void AudioManager::evict() {
+    while (memory_used > memory_budget) {
+        // Least recently played effect that's too long to pin, isn't playing and wasn't wanted last frame
+        SoundId victim = NO_SOUND;
+        for (SoundId id = 0; id < static_cast<SoundId>(sounds.size()); ++id) {
+            const Sound& s = sounds[id];
+            if (s.state != State::RESIDENT || s.ambient || s.chunk->alen <= PIN_BYTES || s.last_used + 1 >= frame || voice_playing(id)) continue;
+            if (victim == NO_SOUND || s.last_used < sounds[victim].last_used) victim = id;
+        }
+        if (victim == NO_SOUND) return;  // Pinned or playing; over budget until that changes
+        Sound& s = sounds[victim];
+        memory_used -= s.chunk->alen;
+        Mix_FreeChunk(s.chunk);
+        s.chunk = nullptr;
+        s.state = State::UNLOADED;
+    }
+}
+
+void AudioManager::play_sfx(SoundId id, int volume, float pan, float distance) {
+    if (id < 0 || id >= static_cast<SoundId>(sounds.size())) return;
+    if (sounds[id].ambient) return;  // Layers only; see set_ambient()
+    if (sounds[id].state != State::RESIDENT) {  // Never waits: decodes for next time instead
+        request(id);
+        return;
+    }
+    int vol = std::max(0, static_cast<int>(volume / (distance + 1.0f)));
+    int& slot = pending_slot[id];
+    if (slot < 0) {
+        slot = static_cast<int>(pending.size());
+        pending.push_back({id, vol, pan});
+    } else if (vol > pending[slot].volume) {  // Same sound twice this frame: keep the loudest
+        pending[slot] = {id, vol, pan};
+    }
+}
+
+void AudioManager::play_sfx(const std::string& id, int volume, float pan, float distance) {
+    auto it = sound_ids.find(id);
+    if (it != sound_ids.end()) play_sfx(it->second, volume, pan, distance);
+}
+
+void AudioManager::update() {
+    ++frame;
+    collect();
+    flush_ambience();
+    Clock::time_point now = Clock::now();
+    uint32_t finished = finished_channels.exchange(0, std::memory_order_relaxed);
+    for (int ch = 0; ch < num_channels; ++ch) {
+        if (finished & (1u << ch)) voices[ch].sound = NO_SOUND;
+    }
+
+    // Most important first, so they get the channels; ties in request order
+    std::stable_sort(pending.begin(), pending.end(), [this](const Request& a, const Request& b) {
+        return sounds[a.sound].policy.priority > sounds[b.sound].policy.priority;
+    });
+    for (const Request& r : pending) {
+        pending_slot[r.sound] = -1;
+        Sound& s = sounds[r.sound];
+        if (s.state != State::RESIDENT) continue;
+        if (s.started && now - s.last_start < std::chrono::milliseconds(s.policy.cooldown_ms)) continue;
+        int instances = 0;
+        for (const Voice& v : voices) instances += v.sound == r.sound;
+        if (instances >= s.policy.max_instances) continue;
+
+        int channel = -1;
+        for (int ch = 0; ch < num_channels && channel < 0; ++ch) {
+            if (voices[ch].sound == NO_SOUND) channel = ch;
+        }
+        if (channel < 0) {  // Steal the least important voice, the oldest among equals
+            for (int ch = 0; ch < num_channels; ++ch) {
+                const Voice& v = voices[ch];
+                if (v.priority >= s.policy.priority) continue;
+                if (channel < 0 || v.priority < voices[channel].priority ||
+                    (v.priority == voices[channel].priority && v.start < voices[channel].start)) channel = ch;
+            }
+            if (channel < 0) continue;
+            Mix_HaltChannel(channel);
+            finished_channels.fetch_and(~(1u << channel), std::memory_order_relaxed);  // Not finished: reused below
+        }
+
+        if (Mix_PlayChannel(channel, s.chunk, 0) < 0) continue;
+        Mix_Volume(channel, r.volume);
+        // Pan: -128 left to 127 right
+        Mix_SetPanning(channel, static_cast<int>((r.pan + 1.0f) * 64 - 64), static_cast<int>((1.0f - r.pan) * 64));
+        voices[channel] = {r.sound, s.policy.priority, now};
+        s.last_start = now;
+        s.started = true;
+        s.last_used = frame;
+    }
+    pending.clear();
+    evict();
+}
+
+void AudioManager::set_ambient(AmbientLayer layer, SoundId track, float gain, float fade_s) {
+    if (track < NO_SOUND || track >= static_cast<SoundId>(sounds.size())) return;
+    if (track != NO_SOUND) {
+        Sound& s = sounds[track];
+        if (!s.ambient && s.state == State::RESIDENT) {  // Budgeted and evictable, so the mixer can't hold it
+            std::cerr << "Not an ambient track: " << s.path << std::endl;
+            return;
+        }
+        s.ambient = true;
+    }
+    AmbientState& a = ambience[static_cast<int>(layer)];
+    if (track != a.track) {
+        a.track = track;
+        a.fade_s = fade_s;
+        a.track_sent = false;
+        if (track != NO_SOUND) request(track);
+    }
+    if (std::abs(gain - a.gain) > 0.005f) {
+        a.gain = gain;
+        a.gain_sent = false;
+    }
+}
+
+void AudioManager::duck_ambient(AmbientLayer layer, float level, float hold_s) {
+    ambient_mixer.duck(layer, level, hold_s);  // Momentary; dropped if the ring is full
+}
+
+void AudioManager::flush_ambience() {
+    if (!ambient_mixer.running()) return;
+    for (int i = 0; i < AMBIENT_LAYERS; ++i) {
+        AmbientState& a = ambience[i];
+        AmbientLayer layer = static_cast<AmbientLayer>(i);
+        if (!a.gain_sent) a.gain_sent = ambient_mixer.set_gain(layer, a.gain, 0.5f);
+        if (a.track_sent) continue;
+        const Sound* s = a.track != NO_SOUND ? &sounds[a.track] : nullptr;
+        if (s && (s->state == State::QUEUED || s->state == State::UNLOADED)) continue;  // Starts once decoded
+        a.track_sent = ambient_mixer.play(layer, s ? s->chunk : nullptr, a.fade_s);  // A failed track fades out
+    }
 }
 
 void AudioManager::register_event(const std::string& event, std::function<void()> callback) {
@@ -2,32 +2,142 @@
 #define AUDIO_H
 
 #include <SDL2/SDL_mixer.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 #include <functional>
+#include "ambient_mixer.h"
+#include "audio_sink.h"
+
+struct SfxPolicy {
+    int priority = 0;  // Higher steals from lower
+    int max_instances = 2;  // Voices of this sound at once
+    int cooldown_ms = 50;  // Between starts of this sound
+};
+
+struct AudioLoadProgress {
+    size_t done = 0, total = 0;  // Files decoded (or failed) out of those asked for
+};
+
+// Sound effects go through a small voice manager: play_sfx() only queues, and
+// update() starts the frame's requests once per frame. Requests for the same
+// sound in a frame merge into the loudest; a sound that is still in its
+// cooldown or already at max_instances is dropped; otherwise it takes a free
+// channel or steals the lowest-priority (then oldest) voice below it.
+//
+// Nothing decodes on the calling thread. Effects decode to PCM chunks on worker
+// threads and are cached within a memory budget: short ones stay pinned, longer
+// ones that haven't played lately are freed and decode again when next played
+// (that play is dropped rather than waited for). Ambient tracks decode the
+// same way but stay resident: the AmbientMixer loops them on the audio thread,
+// one per layer, and set_ambient() forwards only changes to it.
+class AudioManager : public AudioSink {
+public:
+    static constexpr size_t DEFAULT_MEMORY_BUDGET = 32u << 20;  // Bytes of decoded effects
+    static constexpr size_t PIN_BYTES = 256u << 10;  // Decoded effects up to this size are never evicted
+    static constexpr int DECODE_THREADS = 2;
 
-class AudioManager {
 private:
-    std::unordered_map<std::string, Mix_Chunk*> sfx;  // One-shots
-    std::unordered_map<std::string, Mix_Music*> music;  // Loops/ambients
+    using Clock = std::chrono::steady_clock;
+    enum class State : uint8_t { UNLOADED, QUEUED, RESIDENT, FAILED };
+    struct Sound {
+        std::string path;  // Empty until a load names the file
+        State state = State::UNLOADED;
+        Mix_Chunk* chunk = nullptr;  // While RESIDENT
+        SfxPolicy policy;
+        Clock::time_point last_start;
+        bool started = false;
+        uint64_t last_used = 0;  // Frame it last started, for eviction
+        bool ambient = false;  // Mixed by the AmbientMixer; never evicted or freed while it runs
+    };
+    struct Voice {
+        SoundId sound = NO_SOUND;
+        int priority = 0;
+        Clock::time_point start;
+    };
+    struct Request {
+        SoundId sound;
+        int volume;
+        float pan;
+    };
+
+    std::vector<Sound> sounds;  // One-shots, indexed by SoundId
+    std::unordered_map<std::string, SoundId> sound_ids;
+    std::vector<Voice> voices;  // Per channel, as of the last update()
+    std::vector<Request> pending;  // This frame's requests, at most one per sound
+    std::vector<int> pending_slot;  // Per sound: index into pending, or -1
+    struct LoadJob {
+        SoundId sound;
+        std::string path;
+    };
+    struct Loaded {
+        LoadJob job;
+        Mix_Chunk* chunk;  // nullptr if it failed
+    };
+    struct AmbientState {  // What the game last asked of each layer
+        SoundId track = NO_SOUND;
+        float gain = 1.0f, fade_s = 0.0f;
+        bool track_sent = true, gain_sent = true;  // Reached the mixer (the track may still be decoding)
+    };
+
+    void request(SoundId id);  // Starts decoding unless resident, on its way or failed
+    void queue_load(LoadJob job);
+    void worker_loop();
+    void collect();  // Takes in what the workers finished
+    void evict();
+    void flush_ambience();  // Sends layer changes whose tracks are ready
+    bool voice_playing(SoundId id) const;
+
+    AmbientMixer ambient_mixer;
+    std::array<AmbientState, AMBIENT_LAYERS> ambience;
+    size_t memory_used = 0;  // Effects only; ambient tracks aren't budgeted
+    size_t memory_budget = DEFAULT_MEMORY_BUDGET;
+    uint64_t frame = 0;
+    size_t loads_total = 0;
+    std::atomic<size_t> loads_done{0};  // Bumped by the workers, so progress can be polled mid-load
+
+    // Shared with the decode threads, guarded by mtx
+    std::vector<std::thread> workers;
+    std::mutex mtx;
+    std::condition_variable work_cv;
+    std::deque<LoadJob> jobs;
+    std::deque<Loaded> loaded;
+    bool stopping = false;
+
     int num_channels = 8;
     std::vector<std::function<void()>> event_callbacks;  // e.g., on_thunder
-    std::string current_bgm = "";
-    std::string current_overlay = "";
 
 public:
     AudioManager();
-    ~AudioManager();
-
-    void load_sfx(const std::string& path, const std::string& id);
-    void load_bgm(const std::string& path, const std::string& id);  // For music
-    int play_sfx(const std::string& id, int volume = MIX_MAX_VOLUME, float pan = 0.0f, float distance = 1.0f);  // Returns channel
-    void play_bgm(const std::string& id, int volume = 60, int fade_ms = 2000);  // Loop BGM with fade
-    void play_overlay(const std::string& id, int volume = 40, bool additive = true);  // Weather layer
-    void stop_bgm(int fade_ms = 2000);
-    void stop_overlay(const std::string& id, int fade_ms = 1000);
-    void crossfade_bgm(const std::string& new_id, int fade_ms = 3000);  // Smooth switch
+    ~AudioManager() override;
+    AudioManager(const AudioManager&) = delete;
+    AudioManager& operator=(const AudioManager&) = delete;
+
+    SoundId sound(const std::string& id) override;  // Valid before the sound is loaded
+    SoundId load_sfx(const std::string& path, const std::string& id);  // Background decode; keeps any policy already set for id
+    SoundId load_ambient(const std::string& path, const std::string& id);  // A looping bed; background decode
+    // Every effect (with its policy) and every ambient track in a JSON manifest;
+    // returns straight away, see load_progress()
+    bool load_manifest(const std::string& path);
+    AudioLoadProgress load_progress() const { return {loads_done.load(), loads_total}; }
+    void set_sfx_policy(SoundId id, const SfxPolicy& policy);
+    void set_memory_budget(size_t bytes) { memory_budget = bytes; }
+    size_t memory_bytes() const { return memory_used; }
+    void play_sfx(SoundId id, int volume = MIX_MAX_VOLUME, float pan = 0.0f, float distance = 1.0f) override;  // Queued until update()
+    void play_sfx(const std::string& id, int volume = MIX_MAX_VOLUME, float pan = 0.0f, float distance = 1.0f);
+    void update() override;  // Once a frame: takes in decoded sounds, starts the queued ones, evicts over budget
+
+    // Ambient layers play together. Call every frame if convenient: only a new
+    // track (crossfaded over fade_s) or a new gain goes to the audio thread.
+    void set_ambient(AmbientLayer layer, SoundId track, float gain = 1.0f, float fade_s = 2.0f) override;  // NO_SOUND fades it out
+    void duck_ambient(AmbientLayer layer, float level, float hold_s) override;  // e.g. under thunder
     void register_event(const std::string& event, std::function<void()> callback);
 
     void set_channel_volume(int channel, int volume);
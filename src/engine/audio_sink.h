@@ -0,0 +1,34 @@
+#ifndef AUDIO_SINK_H
+#define AUDIO_SINK_H
+
+#include <cstdint>
+#include <string>
+
+using SoundId = int;
+static constexpr SoundId NO_SOUND = -1;
+
+enum class AmbientLayer : uint8_t { BGM, WEATHER, FIRE, COUNT };
+static constexpr int AMBIENT_LAYERS = static_cast<int>(AmbientLayer::COUNT);
+
+// What the game needs from audio. AudioManager plays it through SDL_mixer;
+// NullAudio drops it, for headless runs with no audio device.
+class AudioSink {
+public:
+    virtual ~AudioSink() = default;
+    virtual SoundId sound(const std::string& id) = 0;  // Handle for id, resolved once
+    virtual void play_sfx(SoundId id, int volume = 128, float pan = 0.0f, float distance = 1.0f) = 0;
+    virtual void set_ambient(AmbientLayer layer, SoundId track, float gain = 1.0f, float fade_s = 2.0f) = 0;
+    virtual void duck_ambient(AmbientLayer layer, float level, float hold_s) = 0;
+    virtual void update() = 0;  // Once a tick
+};
+
+class NullAudio : public AudioSink {
+public:
+    SoundId sound(const std::string&) override { return NO_SOUND; }
+    void play_sfx(SoundId, int, float, float) override {}
+    void set_ambient(AmbientLayer, SoundId, float, float) override {}
+    void duck_ambient(AmbientLayer, float, float) override {}
+    void update() override {}
+};
+
+#endif
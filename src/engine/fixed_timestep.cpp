@@ -0,0 +1,43 @@
+#include "fixed_timestep.h"
+#include <algorithm>
+
+FixedTimestep::FixedTimestep(const Settings& settings) : settings(settings) {
+    this->settings.step = std::max(1e-4, settings.step);
+    this->settings.max_steps = std::max(1, settings.max_steps);
+}
+
+void FixedTimestep::apply_vsync(SDL_Renderer* renderer) const {
+    if (!SDL_SetRenderVSync(renderer, settings.vsync ? 1 : SDL_RENDERER_VSYNC_DISABLED) && settings.vsync) {
+        SDL_Log("VSync unavailable: %s", SDL_GetError());
+    }
+}
+
+int FixedTimestep::begin_frame() {
+    uint64_t now = SDL_GetTicksNS();
+    if (!started) {  // The first frame simulates one step
+        started = true;
+        frame_start = now;
+        accumulator = settings.step;
+    } else {
+        last_frame = (now - frame_start) / 1e9;
+        frame_start = now;
+        accumulator += last_frame;
+    }
+
+    double owed = settings.step * settings.max_steps;
+    if (accumulator > owed) {
+        dropped += accumulator - owed;
+        accumulator = owed;
+    }
+    int steps = static_cast<int>(accumulator / settings.step);
+    accumulator -= steps * settings.step;
+    steps_run += steps;
+    return steps;
+}
+
+void FixedTimestep::end_frame() {
+    if (settings.fps_limit <= 0.0) return;
+    uint64_t budget = static_cast<uint64_t>(1e9 / settings.fps_limit);
+    uint64_t spent = SDL_GetTicksNS() - frame_start;
+    if (spent < budget) SDL_DelayPrecise(budget - spent);  // Sleeps, then spins the last stretch
+}
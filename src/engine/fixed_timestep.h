@@ -0,0 +1,49 @@
+#ifndef FIXED_TIMESTEP_H
+#define FIXED_TIMESTEP_H
+
+#include <SDL3/SDL.h>
+#include <cstdint>
+
+// Frame timing for the main loop. The simulation advances in fixed steps paid
+// for out of an accumulator of real time, so its speed and results don't
+// depend on the frame rate; rendering runs as often as the pacing allows and
+// draws between the last two steps (see alpha()). A frame owes at most
+// max_steps; anything beyond that is dropped, so a slow machine runs the game
+// slower instead of falling further behind each frame.
+class FixedTimestep {
+public:
+    struct Settings {
+        double step = 1.0 / 60.0;  // Seconds of simulation per step
+        int max_steps = 5;  // Catch-up limit per frame
+        bool vsync = false;
+        double fps_limit = 0.0;  // Frames per second; 0 renders uncapped
+    };
+
+    explicit FixedTimestep(const Settings& settings);
+    FixedTimestep() : FixedTimestep(Settings()) {}
+
+    void apply_vsync(SDL_Renderer* renderer) const;  // Falls back to uncapped if the driver refuses
+    int begin_frame();  // Steps to simulate now
+    void end_frame();  // Waits out the rest of the frame under fps_limit
+
+    float step() const { return static_cast<float>(settings.step); }
+    // How far the frame is past the last step, 0..1; draw at prev + (cur - prev) * alpha
+    float alpha() const { return static_cast<float>(accumulator / settings.step); }
+    // Seconds the drawn frame trails the latest simulated state
+    float lag() const { return static_cast<float>(settings.step - accumulator); }
+    double sim_time() const { return steps_run * settings.step; }
+    uint64_t total_steps() const { return steps_run; }
+    double dropped_seconds() const { return dropped; }  // Real time given up by the catch-up limit
+    float frame_seconds() const { return static_cast<float>(last_frame); }
+
+private:
+    Settings settings;
+    uint64_t frame_start = 0;  // SDL_GetTicksNS
+    double accumulator = 0.0;
+    double last_frame = 0.0;
+    double dropped = 0.0;
+    uint64_t steps_run = 0;
+    bool started = false;
+};
+
+#endif
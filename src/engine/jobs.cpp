@@ -0,0 +1,108 @@
+#include "jobs.h"
+#include <algorithm>
+
+// JobGraph
+JobGraph::JobId JobGraph::add(std::function<void()> fn, const std::vector<JobId>& deps) {
+    Node& node = nodes.emplace_back();
+    node.fn = std::move(fn);
+    node.num_deps = static_cast<int>(deps.size());
+    for (JobId dep : deps) nodes[dep].successors.push_back(&node);
+    return static_cast<JobId>(nodes.size() - 1);
+}
+
+JobGraph::JobId JobGraph::parallel_for(size_t count, size_t grain, std::function<void(size_t, size_t)> fn, const std::vector<JobId>& deps) {
+    grain = std::max<size_t>(grain, 1);
+    auto shared = std::make_shared<std::function<void(size_t, size_t)>>(std::move(fn));
+    std::vector<JobId> parts;
+    for (size_t begin = 0; begin < count; begin += grain) {
+        size_t end = std::min(count, begin + grain);
+        parts.push_back(add([shared, begin, end] { (*shared)(begin, end); }, deps));
+    }
+    if (parts.empty()) return add([] {}, deps);
+    return add([] {}, parts);
+}
+
+// JobSystem
+JobSystem::JobSystem(unsigned threads) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned i = 0; i < threads; ++i) queues.push_back(std::make_unique<Queue>());
+    for (unsigned i = 1; i < threads; ++i) workers.emplace_back(&JobSystem::worker_loop, this, i);
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mtx);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) worker.join();
+}
+
+void JobSystem::push(unsigned queue, Node* job) {
+    {
+        std::lock_guard<std::mutex> lock(queues[queue]->mtx);
+        queues[queue]->jobs.push_back(job);
+    }
+    queued.fetch_add(1);
+    if (workers.empty()) return;
+    { std::lock_guard<std::mutex> lock(sleep_mtx); }  // A worker between its check and its wait can't miss this
+    wake.notify_one();
+}
+
+JobSystem::Node* JobSystem::pop(unsigned queue) {
+    {
+        Queue& own = *queues[queue];
+        std::lock_guard<std::mutex> lock(own.mtx);
+        if (!own.jobs.empty()) {
+            Node* job = own.jobs.back();
+            own.jobs.pop_back();
+            queued.fetch_sub(1);
+            return job;
+        }
+    }
+    for (size_t i = 1; i < queues.size(); ++i) {
+        Queue& victim = *queues[(queue + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mtx);
+        if (!victim.jobs.empty()) {
+            Node* job = victim.jobs.front();
+            victim.jobs.pop_front();
+            queued.fetch_sub(1);
+            return job;
+        }
+    }
+    return nullptr;
+}
+
+void JobSystem::execute(Node* job, unsigned queue) {
+    if (job->fn) job->fn();
+    for (Node* next : job->successors) {
+        if (next->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) push(queue, next);
+    }
+    remaining.fetch_sub(1, std::memory_order_release);
+}
+
+void JobSystem::worker_loop(unsigned queue) {
+    while (true) {
+        if (Node* job = pop(queue)) {
+            execute(job, queue);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_mtx);
+        wake.wait(lock, [this] { return stopping || queued.load() > 0; });
+        if (stopping) return;
+    }
+}
+
+void JobSystem::run(JobGraph& graph) {
+    if (graph.nodes.empty()) return;
+    std::lock_guard<std::mutex> lock(run_mtx);
+    remaining.store(graph.nodes.size());
+    for (auto& node : graph.nodes) node.pending.store(node.num_deps, std::memory_order_relaxed);
+    for (auto& node : graph.nodes) {
+        if (node.num_deps == 0) push(0, &node);
+    }
+    while (remaining.load(std::memory_order_acquire) > 0) {
+        if (Node* job = pop(0)) execute(job, 0);
+        else std::this_thread::yield();
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Jobs with dependencies, built up front and then handed to JobSystem::run.
+// A job starts once every job it depends on has finished.
+class JobGraph {
+public:
+    using JobId = uint32_t;
+
+    JobId add(std::function<void()> fn, const std::vector<JobId>& deps = {});
+    // Splits [0, count) into ranges of at most grain; the returned job finishes after all of them
+    JobId parallel_for(size_t count, size_t grain, std::function<void(size_t begin, size_t end)> fn, const std::vector<JobId>& deps = {});
+
+    size_t size() const { return nodes.size(); }
+    void clear() { nodes.clear(); }
+
+private:
+    friend class JobSystem;
+    struct Node {
+        std::function<void()> fn;
+        std::vector<Node*> successors;
+        int num_deps = 0;
+        std::atomic<int> pending{0};
+    };
+    std::deque<Node> nodes;  // Stable addresses while the graph grows
+};
+
+// Work-stealing thread pool. Each thread pops its own queue from the back and
+// steals from the front of the others; the thread calling run() works too.
+class JobSystem {
+public:
+    explicit JobSystem(unsigned threads = 0);  // Total threads including the caller; 0 = one per hardware thread
+    ~JobSystem();
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    void run(JobGraph& graph);  // Blocks until every job in the graph has run
+    unsigned thread_count() const { return static_cast<unsigned>(workers.size()) + 1; }
+
+private:
+    using Node = JobGraph::Node;
+    struct Queue {
+        std::mutex mtx;
+        std::deque<Node*> jobs;
+    };
+
+    void push(unsigned queue, Node* job);
+    Node* pop(unsigned queue);  // Own queue first, then steal
+    void execute(Node* job, unsigned queue);
+    void worker_loop(unsigned queue);
+
+    std::vector<std::unique_ptr<Queue>> queues;  // 0 belongs to the thread calling run()
+    std::vector<std::thread> workers;
+    std::atomic<size_t> queued{0};
+    std::atomic<size_t> remaining{0};  // Jobs of the running graph not finished yet
+    std::mutex sleep_mtx;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::mutex run_mtx;  // One graph at a time
+};
+
+#endif
@@ -1,66 +1,421 @@
 #include "lighting.h"
+#include "../game/world.h"
 #include <algorithm>
-#include <cmath>  // For visibility calc stub
-#include <random>
-
-void Lighting::update_occluders(const Tiles& tileset, const World& world, int map_layer) {
-    occluders.clear();
-    for (int x = 0; x < World::WIDTH; ++x) {
-        for (int y = 0; y < World::HEIGHT; ++y) {
-            for (const auto& h_entry : world.get_layer(map_layer)[x][y]) {
-                const auto* tile = tileset.get(*h_entry.second);
-                if (tile) {
-                    for (const auto& lev : tile->height_levels) {
-                        if (!lev.transparent) {
-                            int base_x = x * 32 - y * 32;  // Iso
-                            int base_y = (x + y) * 16;
-                            for (const auto& edge : lev.edges) {
-                                SDL_FPoint start = {base_x + edge.first, base_y + edge.second};
-                                SDL_FPoint end = {base_x + edge.third, base_y + edge.fourth};  // Assume edge as {x1,y1,x2,y2}
-                                occluders.emplace_back(start, end);
-                            }
-                        }
-                    }
+#include <cassert>
+#include <cmath>
+#include <set>
+
+void Lighting::build_occluders(const Tiles& tileset, const Chunk& chunk) {
+    auto& grids = occluders[chunk.coord.key()];
+    for (int map_layer = 0; map_layer < CHUNK_LAYERS; ++map_layer) {
+        OccluderGrid& grid = grids[map_layer];
+        grid.segments.clear();
+        grid.cell_start.clear();
+        grid.cols = grid.rows = 0;
+        grid.reach = 0;
+
+        // Outline edges of every height level that blocks sight, in world pixels
+        std::vector<Occluder>& segs = grid.segments;
+        for (int h = 0; h < CHUNK_HEIGHTS; ++h) {
+            chunk.layers[map_layer].for_each(h, [&](int lx, int ly, TileId id) {
+                const auto& hot = tileset.hot_data(id);
+                if (h >= hot.num_levels || !hot.blocks_sight(h)) return;
+                const auto& lev = tileset.cold_data(id).height_levels[h];
+                if (lev.edges.empty()) return;
+
+                int x = chunk.origin_x() + lx, y = chunk.origin_y() + ly;
+                int base_x = x * 32 - y * 32;  // Iso
+                int base_y = (x + y) * 16;
+                // Edges are the outline's corner points; close the loop
+                for (size_t i = 0; i < lev.edges.size(); ++i) {
+                    const auto& a = lev.edges[i];
+                    const auto& b = lev.edges[(i + 1) % lev.edges.size()];
+                    SDL_FPoint start = {static_cast<float>(base_x + a.first), static_cast<float>(base_y + a.second)};
+                    SDL_FPoint end = {static_cast<float>(base_x + b.first), static_cast<float>(base_y + b.second)};
+                    segs.emplace_back(start, end);
                 }
-            }
+            });
+        }
+        if (segs.empty()) continue;
+
+        // Bucket by midpoint, then counting sort into cell order
+        float x0 = INFINITY, y0 = INFINITY, x1 = -INFINITY, y1 = -INFINITY;
+        for (const auto& [a, b] : segs) {
+            float mx = (a.x + b.x) * 0.5f, my = (a.y + b.y) * 0.5f;
+            x0 = std::min(x0, mx); x1 = std::max(x1, mx);
+            y0 = std::min(y0, my); y1 = std::max(y1, my);
+            grid.reach = std::max(grid.reach, std::max(std::fabs(a.x - b.x), std::fabs(a.y - b.y)) * 0.5f);
+        }
+        grid.x0 = x0;
+        grid.y0 = y0;
+        grid.cols = static_cast<int>((x1 - x0) / OCCLUDER_CELL) + 1;
+        grid.rows = static_cast<int>((y1 - y0) / OCCLUDER_CELL) + 1;
+        grid.cell_start.assign(grid.cols * grid.rows + 1, 0);
+        occluder_scratch.clear();
+        for (const auto& seg : segs) {
+            int cx = static_cast<int>(((seg.first.x + seg.second.x) * 0.5f - x0) / OCCLUDER_CELL);
+            int cy = static_cast<int>(((seg.first.y + seg.second.y) * 0.5f - y0) / OCCLUDER_CELL);
+            uint32_t cell = cy * grid.cols + cx;
+            occluder_scratch.emplace_back(cell, seg);
+            ++grid.cell_start[cell + 1];
+        }
+        for (size_t c = 1; c < grid.cell_start.size(); ++c) grid.cell_start[c] += grid.cell_start[c - 1];
+        std::vector<uint32_t> next(grid.cell_start.begin(), grid.cell_start.end() - 1);
+        for (const auto& [cell, seg] : occluder_scratch) segs[next[cell]++] = seg;
+    }
+    ++chunks_rebuilt;
+}
+
+SDL_FRect Lighting::grid_bounds(const OccluderGrid& grid) {
+    return {grid.x0 - grid.reach, grid.y0 - grid.reach, grid.cols * OCCLUDER_CELL + 2 * grid.reach, grid.rows * OCCLUDER_CELL + 2 * grid.reach};
+}
+
+void Lighting::update_occluders(const Tiles& tileset, const World& world) {
+    const ChunkCache& chunks = world.get_chunks();
+    chunks_rebuilt = 0;
+    if (occluders_built && chunks.revision() == seen_revision) return;  // Static scene: nothing to do
+
+    auto invalidate_chunk = [&](ChunkCoord coord) {  // Lights that can reach the chunk's walls
+        auto it = occluders.find(coord.key());
+        if (it == occluders.end()) return;
+        for (int map_layer = 0; map_layer < CHUNK_LAYERS; ++map_layer) {
+            if (!it->second[map_layer].segments.empty()) invalidate_lit(map_layer, grid_bounds(it->second[map_layer]));
+        }
+    };
+    std::unordered_map<uint64_t, ChunkCoord> touched;
+    bool tracked = occluders_built && chunks.changes_since(seen_revision, [&](const ChunkCache::Change& c) {
+        ChunkCoord coord = ChunkCoord::of_tile(c.x, c.y);
+        touched.emplace(coord.key(), coord);
+        if (c.layer >= 0) {  // Lights near the cell; outlines stay within a cell's distance of their tile
+            float base_x = (c.x - c.y) * 32.0f, base_y = (c.x + c.y) * 16.0f;
+            invalidate_lit(c.layer, {base_x - OCCLUDER_CELL, base_y - OCCLUDER_CELL, 64 + 2 * OCCLUDER_CELL, 32 + 2 * OCCLUDER_CELL});
+        } else {  // Paged in or out: whatever lit its old walls
+            invalidate_chunk(coord);
+        }
+    });
+    if (tracked) {
+        for (const auto& [key, coord] : touched) {
+            if (const Chunk* chunk = chunks.find(coord)) build_occluders(tileset, *chunk);
+            else occluders.erase(key);  // Paged out
+        }
+        chunks.changes_since(seen_revision, [&](const ChunkCache::Change& c) {  // ...and its new ones
+            if (c.layer < 0) invalidate_chunk(ChunkCoord::of_tile(c.x, c.y));
+        });
+    } else {  // First time, or the log moved on without us
+        occluders.clear();
+        for (auto& area : lit) area.valid = false;
+        chunks.for_each_resident([&](const Chunk& chunk) { build_occluders(tileset, chunk); });
+    }
+    seen_revision = chunks.revision();
+    occluders_built = true;
+}
+
+void Lighting::occluders_in(int map_layer, const SDL_FRect& area, std::vector<Occluder>& out) const {
+    for (const auto& entry : occluders) {
+        const OccluderGrid& grid = entry.second[map_layer];
+        if (grid.segments.empty()) continue;
+        // Cells whose midpoints could belong to a segment crossing the area
+        int c0 = static_cast<int>(std::floor((area.x - grid.reach - grid.x0) / OCCLUDER_CELL));
+        int c1 = static_cast<int>(std::floor((area.x + area.w + grid.reach - grid.x0) / OCCLUDER_CELL));
+        int r0 = static_cast<int>(std::floor((area.y - grid.reach - grid.y0) / OCCLUDER_CELL));
+        int r1 = static_cast<int>(std::floor((area.y + area.h + grid.reach - grid.y0) / OCCLUDER_CELL));
+        c0 = std::max(c0, 0); c1 = std::min(c1, grid.cols - 1);
+        r0 = std::max(r0, 0); r1 = std::min(r1, grid.rows - 1);
+        if (c0 > c1) continue;
+        for (int r = r0; r <= r1; ++r) {  // A row's cells are contiguous in segments
+            out.insert(out.end(), grid.segments.begin() + grid.cell_start[r * grid.cols + c0],
+                       grid.segments.begin() + grid.cell_start[r * grid.cols + c1 + 1]);
+        }
+    }
+}
+
+void Lighting::invalidate_lit(int map_layer, const SDL_FRect& area) {
+    for (auto& l : lit) {
+        if (!l.valid || l.map_layer != map_layer) continue;
+        float reach = l.radius * LIGHT_TILE_PX;
+        if (l.pos.x + reach < area.x || l.pos.x - reach > area.x + area.w) continue;
+        if (l.pos.y + reach < area.y || l.pos.y - reach > area.y + area.h) continue;
+        l.valid = false;
+    }
+}
+
+namespace {
+
+constexpr uint32_t NO_SEGMENT = UINT32_MAX;
+
+struct SweepEvent {
+    float angle;
+    uint32_t segment;
+    bool begin;
+};
+
+// Distance along the ray from o in direction (dx, dy) to the line through seg; INFINITY if parallel or behind
+float ray_distance(SDL_FPoint o, float dx, float dy, const Occluder& seg) {
+    float ex = seg.second.x - seg.first.x, ey = seg.second.y - seg.first.y;
+    float denom = dx * ey - dy * ex;
+    if (std::fabs(denom) < 1e-9f) return INFINITY;
+    float t = ((seg.first.x - o.x) * ey - (seg.first.y - o.y) * ex) / denom;
+    return t >= 0 ? t : INFINITY;
+}
+
+// Cuts seg down to the part inside the box; false if none of it is
+bool clip_to_box(Occluder& seg, float x0, float y0, float x1, float y1) {
+    float dx = seg.second.x - seg.first.x, dy = seg.second.y - seg.first.y;
+    const float p[4] = {-dx, dx, -dy, dy};
+    const float q[4] = {seg.first.x - x0, x1 - seg.first.x, seg.first.y - y0, y1 - seg.first.y};
+    float t0 = 0, t1 = 1;
+    for (int i = 0; i < 4; ++i) {
+        if (p[i] == 0) {
+            if (q[i] < 0) return false;  // Parallel to this side and beyond it
+            continue;
         }
+        float r = q[i] / p[i];
+        if (p[i] < 0) t0 = std::max(t0, r);
+        else t1 = std::min(t1, r);
     }
+    if (t0 >= t1) return false;
+    SDL_FPoint a = seg.first;
+    if (t0 > 0) seg.first = {a.x + t0 * dx, a.y + t0 * dy};
+    if (t1 < 1) seg.second = {a.x + t1 * dx, a.y + t1 * dy};
+    return true;
 }
 
-VisibilityPolygon Lighting::compute_visibility(const SDL_FPoint& light_pos, const std::vector<std::pair<SDL_FPoint, SDL_FPoint>>& walls) {
+}  // namespace
+
+// Sweeps a ray once around the light. Segments open and close at their
+// endpoints' angles; between two consecutive event angles the nearest open
+// segment is what the light sees, and wherever that changes the polygon gets
+// the points where the ray leaves the old nearest and meets the new one. A
+// square of half-size reach closes the polygon where there are no walls.
+// Tile outlines are their cells' diamonds, which only meet at corners or share
+// edges, and walls are cut at the square, so no two segments cross: the order
+// of the open ones along the ray only changes at events, and a tree keeps them
+// nearest first.
+VisibilityPolygon Lighting::compute_visibility(const SDL_FPoint& light_pos, float reach, const std::vector<Occluder>& walls) {
+    const float x0 = light_pos.x - reach, x1 = light_pos.x + reach, y0 = light_pos.y - reach, y1 = light_pos.y + reach;
+    std::vector<Occluder> segs = {{{x0, y0}, {x1, y0}}, {{x1, y0}, {x1, y1}}, {{x1, y1}, {x0, y1}}, {{x0, y1}, {x0, y0}}};
+    for (Occluder w : walls) {
+        if (clip_to_box(w, x0, y0, x1, y1)) segs.push_back(w);
+    }
+
+    // Open segments ordered by distance along the ray at dir, which is kept
+    // between the last event angle and the next
+    SDL_FPoint dir = {};
+    auto nearer = [&](uint32_t l, uint32_t r) {
+        float tl = ray_distance(light_pos, dir.x, dir.y, segs[l]), tr = ray_distance(light_pos, dir.x, dir.y, segs[r]);
+        return tl < tr || (tl == tr && l < r);  // Shared edges tie
+    };
+    using OpenSet = std::set<uint32_t, decltype(nearer)>;
+    OpenSet open(nearer);
+    std::vector<OpenSet::iterator> slot(segs.size(), open.end());  // Where each open segment is
+    auto aim = [&](float angle) { dir = {std::cos(angle), std::sin(angle)}; };
+    auto add = [&](uint32_t s) { slot[s] = open.insert(s).first; };
+    auto remove = [&](uint32_t s) {
+        if (slot[s] == open.end()) return;
+        open.erase(slot[s]);
+        slot[s] = open.end();
+    };
+    auto nearest = [&]() {
+        if (open.empty()) return NO_SEGMENT;
+        uint32_t front = *open.begin();
+        float t = ray_distance(light_pos, dir.x, dir.y, segs[front]);
+        // Walls that crossed would leave the tree's order stale; the front would fall behind the next
+        assert(open.size() < 2 || t <= ray_distance(light_pos, dir.x, dir.y, segs[*std::next(open.begin())]) * 1.001f + 0.01f);
+        return t == INFINITY ? NO_SEGMENT : front;
+    };
+
+    // Each segment begins at whichever end comes first going clockwise (angle increasing, y down)
+    std::vector<SweepEvent> events;
+    events.reserve(segs.size() * 2);
+    std::vector<uint32_t> wrapped;  // Open where the sweep starts at -pi
+    for (uint32_t s = 0; s < segs.size(); ++s) {
+        float a = std::atan2(segs[s].first.y - light_pos.y, segs[s].first.x - light_pos.x);
+        float b = std::atan2(segs[s].second.y - light_pos.y, segs[s].second.x - light_pos.x);
+        float span = b - a;
+        if (span > M_PI) span -= 2 * M_PI;
+        if (span <= -M_PI) span += 2 * M_PI;
+        if (std::fabs(span) < 1e-6f) continue;  // Edge-on to the light; blocks nothing
+        if (span < 0) std::swap(a, b);
+        events.push_back({a, s, true});
+        events.push_back({b, s, false});
+        if (a > b) wrapped.push_back(s);
+    }
+    std::sort(events.begin(), events.end(), [](const SweepEvent& l, const SweepEvent& r) { return l.angle < r.angle; });
+
+    auto point_on = [&](uint32_t s, float angle) {
+        float dx = std::cos(angle), dy = std::sin(angle);
+        float t = std::min(ray_distance(light_pos, dx, dy, segs[s]), 2 * reach);  // The box is within 2 * reach
+        return SDL_FPoint{light_pos.x + dx * t, light_pos.y + dy * t};
+    };
+
     VisibilityPolygon poly;
-    int r = 100;  // Scaled
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<> dis(0.0f, 2 * M_PI);
-    for (int i = 0; i < 8; ++i) {
-        float angle = i * M_PI / 4;
-        poly.points.push_back({light_pos.x + static_cast<float>(r * cos(angle)), light_pos.y + static_cast<float>(r * sin(angle))});
+    float first_angle = events.empty() ? static_cast<float>(M_PI) : events.front().angle;
+    aim((static_cast<float>(-M_PI) + first_angle) / 2);
+    for (uint32_t s : wrapped) add(s);
+    uint32_t current = nearest();
+    if (current == NO_SEGMENT) return poly;
+    poly.points.push_back(point_on(current, static_cast<float>(-M_PI)));
+    for (size_t i = 0; i < events.size();) {
+        float angle = events[i].angle;
+        size_t group = i;
+        for (; i < events.size() && events[i].angle == angle; ++i) {
+            if (!events[i].begin) remove(events[i].segment);
+        }
+        // Segments opening here go in by their distance just past the angle
+        float next_angle = i < events.size() ? events[i].angle : static_cast<float>(M_PI);
+        aim((angle + next_angle) / 2);
+        for (; group < i; ++group) {
+            if (events[group].begin) add(events[group].segment);
+        }
+        uint32_t next = nearest();
+        if (next == current || next == NO_SEGMENT) continue;
+        SDL_FPoint leave = point_on(current, angle), meet = point_on(next, angle);
+        poly.points.push_back(leave);
+        if (std::fabs(leave.x - meet.x) > 0.01f || std::fabs(leave.y - meet.y) > 0.01f) poly.points.push_back(meet);
+        current = next;
+    }
+    return poly;
+}
+
+void Lighting::update_lights(JobSystem& jobs) {
+    lit.resize(sources.size());
+    stale.clear();
+    for (size_t i = 0; i < sources.size(); ++i) {
+        const Light& light = sources[i];
+        const LitArea& l = lit[i];
+        if (!l.valid || l.pos.x != light.pos.x || l.pos.y != light.pos.y || l.radius != light.radius || l.map_layer != light.map_layer) stale.push_back(i);
+    }
+    lights_recomputed = stale.size();
+    if (stale.empty()) return;
+
+    JobGraph graph;
+    graph.parallel_for(stale.size(), 4, [this](size_t begin, size_t end) {
+        std::vector<Occluder> walls;
+        for (size_t k = begin; k < end; ++k) {
+            const Light& light = sources[stale[k]];
+            float reach = light.radius * LIGHT_TILE_PX;
+            walls.clear();
+            occluders_in(light.map_layer, {light.pos.x - reach, light.pos.y - reach, 2 * reach, 2 * reach}, walls);
+            LitArea& l = lit[stale[k]];
+            l.poly = compute_visibility(light.pos, reach, walls);
+            l.pos = light.pos;
+            l.radius = light.radius;
+            l.map_layer = light.map_layer;
+            l.valid = true;
+        }
+    });
+    jobs.run(graph);
+}
+
+bool Lighting::fit_target() {
+    int out_w = 800, out_h = 600;
+    SDL_GetCurrentRenderOutputSize(renderer, &out_w, &out_h);
+    int w = std::max(1, static_cast<int>(std::ceil(out_w * scale))), h = std::max(1, static_cast<int>(std::ceil(out_h * scale)));
+    if (shadow_tex && w == target_w && h == target_h) return true;
+    if (shadow_tex) SDL_DestroyTexture(shadow_tex);
+    shadow_tex = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, w, h);
+    if (!shadow_tex) {
+        SDL_Log("Lighting target error: %s", SDL_GetError());
+        target_w = target_h = 0;
+        return false;
     }
-    return poly;  // Stub; real clip with walls
+    SDL_SetTextureScaleMode(shadow_tex, SDL_SCALEMODE_LINEAR);  // Bilinear upsample hides the low resolution
+    SDL_SetTextureBlendMode(shadow_tex, SDL_BLENDMODE_MOD);
+    target_w = w;
+    target_h = h;
+    return true;
+}
+
+void Lighting::set_resolution_scale(float s) {
+    scale = std::clamp(s, 0.125f, 1.0f);
 }
 
-void Lighting::render_lighting(const World& world, int map_layer) {
-    if (!shadow_tex) return;
+void Lighting::render_lighting(const World& world, SDL_FPoint offset) {
+    if (!fit_target()) return;
 
+    // Ambient base: daylight tint and moonlight, from the lightmap
+    const LightMap& lightmap = world.get_lightmap();
+    const auto& ambient = lightmap.ambient();
     SDL_SetRenderTarget(renderer, shadow_tex);
-    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);  // Black shadow base
+    SDL_SetRenderDrawColor(renderer, static_cast<Uint8>(ambient[0] * 255), static_cast<Uint8>(ambient[1] * 255), static_cast<Uint8>(ambient[2] * 255), 255);
     SDL_RenderClear(renderer);
 
-    // Additive lights
-    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_ADD);
-    for (const auto& light : sources) {
-        // Stub circle; use poly for visibility
-        SDL_SetRenderDrawColor(renderer, light.color[0], light.color[1], light.color[2], light.intensity * 255);
-        // SDL_RenderFillCircle (stub)
-    }
+    fan_vertices.clear();
+    fan_indices.clear();
+    fog_vertices.clear();
+    fog_indices.clear();
+    // Everything is drawn in target pixels: screen pixels times scale
+    auto at = [&](float x, float y) { return SDL_FPoint{(x + offset.x) * scale, (y + offset.y) * scale}; };
+    auto diamond = [&](std::vector<SDL_Vertex>& vertices, std::vector<int>& indices, float x, float y, SDL_FColor color) {
+        int first = static_cast<int>(vertices.size());
+        vertices.push_back({at(x + 32, y), color, {0, 0}});
+        vertices.push_back({at(x + 64, y + 16), color, {0, 0}});
+        vertices.push_back({at(x + 32, y + 32), color, {0, 0}});
+        vertices.push_back({at(x, y + 16), color, {0, 0}});
+        indices.insert(indices.end(), {first, first + 1, first + 2, first, first + 2, first + 3});
+    };
+
+    // Tiles on screen (s = gx + gy down the screen, d = gx - gy across)
+    float view_w = target_w / scale, view_h = target_h / scale;
+    int s0 = static_cast<int>(std::floor(-offset.y / 16)) - 2, s1 = static_cast<int>(std::ceil((view_h - offset.y) / 16)) + 1;
+    int d0 = static_cast<int>(std::floor(-offset.x / 32)) - 2, d1 = static_cast<int>(std::ceil((view_w - offset.x) / 32)) + 1;
+    const Vision& vision = world.get_vision();
+    ViewerId viewer = world.player_viewer();
+    int fog_layer = viewer != NO_VIEWER ? vision.viewer_layer(viewer) : -1;
 
-    // Ambient dim for layer
-    int ambient = map_layer * 30;
-    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255 - ambient);
-    SDL_RenderFillRect(renderer, nullptr);
+    // Every layer's light adds into the one target: the lightmap's tile light
+    // above the ambient, and each light's visibility fan fading out to its reach
+    for (int map_layer = 0; map_layer < CHUNK_LAYERS; ++map_layer) {
+        bool lit_layer = lightmap.layer_lit(map_layer);
+        if (!lit_layer && map_layer != fog_layer) continue;
+        for (int sum = s0; sum <= s1; ++sum) {
+            for (int diff = d0 + ((sum + d0) & 1); diff <= d1; diff += 2) {
+                int gx = (sum + diff) / 2, gy = (sum - diff) / 2;
+                if (gx < 0 || gy < 0 || gx >= world.width() || gy >= world.height()) continue;
+                float x = diff * 32.0f, y = sum * 16.0f;
+                if (map_layer == fog_layer && !vision.can_see(viewer, gx, gy)) {  // Fog where the player can't see
+                    diamond(fog_vertices, fog_indices, x, y, {FOG_LEVEL, FOG_LEVEL, FOG_LEVEL, 1.0f});
+                    continue;  // Its light would be fogged anyway
+                }
+                if (!lit_layer) continue;
+                std::array<float, 3> rgb = lightmap.color_at(map_layer, gx, gy);
+                SDL_FColor color = {rgb[0] - ambient[0], rgb[1] - ambient[1], rgb[2] - ambient[2], 1.0f};
+                if (color.r < 1 / 255.0f && color.g < 1 / 255.0f && color.b < 1 / 255.0f) continue;
+                diamond(fan_vertices, fan_indices, x, y, color);
+            }
+        }
+    }
+    for (size_t i = 0; i < sources.size() && i < lit.size(); ++i) {
+        const Light& light = sources[i];
+        const auto& points = lit[i].poly.points;
+        if (!lit[i].valid || points.size() < 3) continue;
+        float reach = light.radius * LIGHT_TILE_PX;
+        SDL_FColor color = {light.color[0] / 255.0f * light.intensity, light.color[1] / 255.0f * light.intensity,
+                            light.color[2] / 255.0f * light.intensity, 1.0f};
+        int centre = static_cast<int>(fan_vertices.size());
+        fan_vertices.push_back({at(light.pos.x, light.pos.y), color, {0, 0}});
+        for (const auto& p : points) {
+            float fade = std::max(0.0f, 1.0f - std::hypot(p.x - light.pos.x, p.y - light.pos.y) / reach);
+            fan_vertices.push_back({at(p.x, p.y), {color.r * fade, color.g * fade, color.b * fade, 1.0f}, {0, 0}});
+        }
+        int n = static_cast<int>(points.size());
+        for (int k = 0; k < n; ++k) {
+            fan_indices.insert(fan_indices.end(), {centre, centre + 1 + k, centre + 1 + (k + 1) % n});
+        }
+    }
+    if (!fan_indices.empty()) {
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_ADD);
+        SDL_RenderGeometry(renderer, nullptr, fan_vertices.data(), static_cast<int>(fan_vertices.size()),
+                           fan_indices.data(), static_cast<int>(fan_indices.size()));
+    }
+    if (!fog_indices.empty()) {  // Multiplied in after the lights, so fogged tiles stay dim
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_MOD);
+        SDL_RenderGeometry(renderer, nullptr, fog_vertices.data(), static_cast<int>(fog_vertices.size()),
+                           fog_indices.data(), static_cast<int>(fog_indices.size()));
+    }
 
+    // One multiply over the frame, stretched back up to the output
     SDL_SetRenderTarget(renderer, nullptr);
-    SDL_SetTextureBlendMode(shadow_tex, SDL_BLENDMODE_MOD);
     SDL_RenderTexture(renderer, shadow_tex, nullptr, nullptr);
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
 }
@@ -4,15 +4,19 @@
 #include <SDL3/SDL.h>
 #include <vector>
 #include <utility>  // pair
+#include <unordered_map>
 #include "../game/tiles.h"  // For LightSource
+#include "../game/chunk.h"  // CHUNK_LAYERS
 #include <array>
 
 // Forward declarations
 class World;
+class JobSystem;
 
 struct Light {
-    SDL_FPoint pos;  // Iso screen pos
-    int radius = 5;
+    SDL_FPoint pos;  // Iso world pos, the space occluders are in
+    int radius = 5;  // Tiles
+    int map_layer = 1;  // Whose occluders cast its shadows
     std::array<int, 3> color = {255, 255, 255};
     float intensity = 1.0f;
 };
@@ -21,23 +25,76 @@ struct VisibilityPolygon {
     std::vector<SDL_FPoint> points;  // Clockwise polygon verts
 };
 
+using Occluder = std::pair<SDL_FPoint, SDL_FPoint>;  // Line (start, end)
+
 class Lighting {
 private:
     SDL_Renderer* renderer;
     std::vector<Light> sources;
-    SDL_Texture* shadow_tex = nullptr;
-    std::vector<std::pair<SDL_FPoint, SDL_FPoint>> occluders;  // Lines (start, end)
+    SDL_Texture* shadow_tex = nullptr;  // Sized to the output times scale; remade on resize
+    int target_w = 0, target_h = 0;
+    float scale = 0.5f;
+    bool fit_target();
+
+    // Occluders of one layer of one chunk, bucketed by midpoint into a grid of
+    // OCCLUDER_CELL squares; a query widens its area by reach to catch segments
+    // that stick out of their cell
+    struct OccluderGrid {
+        std::vector<Occluder> segments;  // Sorted by cell
+        std::vector<uint32_t> cell_start;  // cols * rows + 1 offsets into segments
+        float x0 = 0, y0 = 0;
+        int cols = 0, rows = 0;
+        float reach = 0;  // Longest half segment
+    };
+    static constexpr float OCCLUDER_CELL = 128.0f;  // World pixels
+    std::unordered_map<uint64_t, std::array<OccluderGrid, CHUNK_LAYERS>> occluders;  // By ChunkCoord::key
+    std::vector<std::pair<uint32_t, Occluder>> occluder_scratch;  // (cell, segment) while building
+    uint64_t seen_revision = 0;  // ChunkCache::revision() already applied
+    bool occluders_built = false;
+    size_t chunks_rebuilt = 0;  // Last update
+    void build_occluders(const Tiles& tileset, const Chunk& chunk);
+    static SDL_FRect grid_bounds(const OccluderGrid& grid);
+
+    // Visibility polygon of each source, parallel to sources; kept until the
+    // light moves or occluders around it are rebuilt
+    struct LitArea {
+        VisibilityPolygon poly;
+        SDL_FPoint pos = {0, 0};
+        int radius = 0, map_layer = 0;
+        bool valid = false;
+    };
+    static constexpr float LIGHT_TILE_PX = 32.0f;  // Pixels of reach per tile of Light::radius
+    std::vector<LitArea> lit;
+    std::vector<size_t> stale;  // update_lights scratch
+    size_t lights_recomputed = 0;  // Last update
+    std::vector<SDL_Vertex> fan_vertices;  // render_lighting scratch
+    std::vector<int> fan_indices;
+    std::vector<SDL_Vertex> fog_vertices;
+    std::vector<int> fog_indices;
+    static constexpr float FOG_LEVEL = 0.35f;  // Light left on tiles the player can't see
+    void invalidate_lit(int map_layer, const SDL_FRect& area);
 
 public:
-    Lighting(SDL_Renderer* r) : renderer(r) {
-        shadow_tex = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, 800, 600);
-    }
+    Lighting(SDL_Renderer* r) : renderer(r) {}
     ~Lighting() { if (shadow_tex) SDL_DestroyTexture(shadow_tex); }
 
-    void add_source(const Light& light) { sources.push_back(light); }
-    void update_occluders(const Tiles& tileset, const World& world, int map_layer);
-    VisibilityPolygon compute_visibility(const SDL_FPoint& light_pos, const std::vector<std::pair<SDL_FPoint, SDL_FPoint>>& walls);
-    void render_lighting(const World& world, int map_layer);
+    size_t add_source(const Light& light) { sources.push_back(light); return sources.size() - 1; }
+    void move_source(size_t index, SDL_FPoint pos) { sources[index].pos = pos; }
+    void clear_sources() { sources.clear(); }
+    // Rebuilds the occluders of chunks that changed or paged in since the last call; once a frame
+    void update_occluders(const Tiles& tileset, const World& world);
+    // Appends the occluders of map_layer that can cross area (world pixels)
+    void occluders_in(int map_layer, const SDL_FRect& area, std::vector<Occluder>& out) const;
+    size_t occluder_chunks_rebuilt() const { return chunks_rebuilt; }
+    // Area lit from light_pos within a square of half-size reach, by an angular sweep over the walls; thread-safe
+    static VisibilityPolygon compute_visibility(const SDL_FPoint& light_pos, float reach, const std::vector<Occluder>& walls);
+    void update_lights(JobSystem& jobs);  // Recomputes moved or invalidated polygons across worker threads; once a frame
+    size_t lights_updated() const { return lights_recomputed; }
+    // Once a frame, after every layer: all layers' light into one target at a fraction
+    // of the output size, multiplied over the frame; offset = world to screen
+    void render_lighting(const World& world, SDL_FPoint offset);
+    void set_resolution_scale(float s);  // Of the output size; 0.5 = half, 0.25 = quarter
+    float resolution_scale() const { return scale; }
 };
 
 #endif
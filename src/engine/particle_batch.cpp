@@ -0,0 +1,59 @@
+#include "particle_batch.h"
+#include <cmath>
+
+void ParticleBatch::clear() {
+    for (auto& batch : batches) {
+        batch.vertices.clear();
+        batch.indices.clear();
+    }
+}
+
+void ParticleBatch::set_atlas(SDL_Texture* texture, const std::array<SDL_FRect, NUM_PARTICLE_KINDS>& uv) {
+    atlas = texture;
+    atlas_uv = uv;
+}
+
+ParticleBatch::Batch& ParticleBatch::batch_for(SDL_BlendMode blend, SDL_Texture* texture) {
+    for (auto& batch : batches) {
+        if (batch.blend == blend && batch.texture == texture) return batch;
+    }
+    batches.push_back({blend, texture, {}, {}});
+    return batches.back();
+}
+
+void ParticleBatch::push_quad(Batch& batch, const std::array<SDL_FPoint, 4>& corners, SDL_FColor color, const SDL_FRect& uv) {
+    int base = static_cast<int>(batch.vertices.size());
+    const SDL_FPoint tex[4] = {{uv.x, uv.y}, {uv.x + uv.w, uv.y}, {uv.x + uv.w, uv.y + uv.h}, {uv.x, uv.y + uv.h}};
+    for (int i = 0; i < 4; ++i) {
+        batch.vertices.push_back({{corners[i].x + offset.x, corners[i].y + offset.y}, color, tex[i]});
+    }
+    for (int i : {0, 1, 2, 0, 2, 3}) batch.indices.push_back(base + i);
+}
+
+void ParticleBatch::quad(SDL_BlendMode blend, ParticleKind kind, float cx, float cy, float size, SDL_FColor color) {
+    const SDL_FRect& uv = atlas_uv[static_cast<size_t>(kind)];
+    SDL_Texture* texture = atlas && uv.w > 0 ? atlas : nullptr;
+    float h = size / 2;
+    push_quad(batch_for(blend, texture), {{{cx - h, cy - h}, {cx + h, cy - h}, {cx + h, cy + h}, {cx - h, cy + h}}}, color, texture ? uv : SDL_FRect{0, 0, 0, 0});
+}
+
+void ParticleBatch::streak(SDL_BlendMode blend, float x0, float y0, float x1, float y1, float width, SDL_FColor color) {
+    float dx = x1 - x0, dy = y1 - y0;
+    float len = std::sqrt(dx * dx + dy * dy);
+    if (len <= 0.0f) return;
+    float nx = -dy / len * width / 2, ny = dx / len * width / 2;  // Half-width normal
+    push_quad(batch_for(blend, nullptr), {{{x0 + nx, y0 + ny}, {x1 + nx, y1 + ny}, {x1 - nx, y1 - ny}, {x0 - nx, y0 - ny}}}, color, {0, 0, 0, 0});
+}
+
+void ParticleBatch::flush(SDL_Renderer* renderer) {
+    draw_calls = 0;
+    for (auto& batch : batches) {
+        if (batch.indices.empty()) continue;
+        if (batch.texture) SDL_SetTextureBlendMode(batch.texture, batch.blend);
+        else SDL_SetRenderDrawBlendMode(renderer, batch.blend);
+        SDL_RenderGeometry(renderer, batch.texture, batch.vertices.data(), static_cast<int>(batch.vertices.size()),
+                           batch.indices.data(), static_cast<int>(batch.indices.size()));
+        ++draw_calls;
+    }
+    clear();
+}
@@ -0,0 +1,44 @@
+#ifndef PARTICLE_BATCH_H
+#define PARTICLE_BATCH_H
+
+#include <SDL3/SDL.h>
+#include <array>
+#include <vector>
+#include "particle_budget.h"  // ParticleKind
+
+// Collects particle quads and streaks from every emitter, grouped by blend
+// mode and texture, and draws each group with one SDL_RenderGeometry call.
+class ParticleBatch {
+public:
+    void clear();  // Keeps the buffers' capacity
+    void set_offset(SDL_FPoint o) { offset = o; }  // Added to every position, e.g. the camera
+    void set_lag(float seconds) { lag_s = seconds; }  // How far behind the last simulation step to draw
+    float lag() const { return lag_s; }
+    // Textured quads for kinds with a sprite; uv is normalised, w == 0 means the kind draws flat
+    void set_atlas(SDL_Texture* texture, const std::array<SDL_FRect, NUM_PARTICLE_KINDS>& uv);
+
+    void quad(SDL_BlendMode blend, ParticleKind kind, float cx, float cy, float size, SDL_FColor color);
+    void streak(SDL_BlendMode blend, float x0, float y0, float x1, float y1, float width, SDL_FColor color);
+
+    void flush(SDL_Renderer* renderer);  // Draws and clears
+    size_t last_draw_calls() const { return draw_calls; }
+
+private:
+    struct Batch {
+        SDL_BlendMode blend;
+        SDL_Texture* texture;
+        std::vector<SDL_Vertex> vertices;
+        std::vector<int> indices;
+    };
+    Batch& batch_for(SDL_BlendMode blend, SDL_Texture* texture);
+    void push_quad(Batch& batch, const std::array<SDL_FPoint, 4>& corners, SDL_FColor color, const SDL_FRect& uv);
+
+    std::vector<Batch> batches;  // A handful at most; looked up linearly
+    SDL_FPoint offset = {0, 0};
+    float lag_s = 0.0f;
+    SDL_Texture* atlas = nullptr;
+    std::array<SDL_FRect, NUM_PARTICLE_KINDS> atlas_uv{};
+    size_t draw_calls = 0;
+};
+
+#endif
@@ -0,0 +1,112 @@
+#include "particle_budget.h"
+#include "particles.h"
+#include <algorithm>
+#include <cmath>
+
+// Share of the budget per kind, in ParticleKind order
+static constexpr std::array<float, NUM_PARTICLE_KINDS> KIND_SHARE = {
+    0.05f,  // GRASS
+    0.05f,  // FOG
+    0.08f,  // SPLASH
+    0.15f,  // SNOW
+    0.20f,  // RAIN
+    0.15f,  // SMOKE
+    0.07f,  // SPARK
+    0.25f,  // FIRE
+};
+
+const char* particle_kind_name(ParticleKind kind) {
+    static const char* names[] = {"grass", "fog", "splash", "snow", "rain", "smoke", "spark", "fire"};
+    return kind < ParticleKind::COUNT ? names[static_cast<size_t>(kind)] : "unknown";
+}
+
+// 1 at low use, falling to 0 over the last quarter of the limit
+static float pressure_scale(size_t live, size_t limit) {
+    if (limit == 0) return 0.0f;
+    float use = static_cast<float>(live) / limit;
+    return std::clamp((1.0f - use) / 0.25f, 0.0f, 1.0f);
+}
+
+void ParticleBudget::set_budget(size_t new_budget) {
+    budget = new_budget;
+    for (size_t k = 0; k < NUM_PARTICLE_KINDS; ++k) quotas[k] = static_cast<size_t>(budget * KIND_SHARE[k]);
+}
+
+void ParticleBudget::begin_frame(SDL_FPoint new_focus) {
+    focus = new_focus;
+    entries.clear();
+}
+
+void ParticleBudget::add(ParticleEmitter& emitter) {
+    float distance = 0.0f;
+    if (!emitter.is_screen_space()) {
+        SDL_FPoint pos = emitter.get_origin();
+        distance = std::hypot(pos.x - focus.x, pos.y - focus.y);
+    }
+    entries.push_back({&emitter, distance});
+}
+
+void ParticleBudget::end_frame() {
+    ParticleBudgetReport report;
+    report.budget = budget;
+    for (size_t k = 0; k < NUM_PARTICLE_KINDS; ++k) report.kinds[k].quota = quotas[k];
+    for (const auto& e : entries) {
+        auto& kind = report.kinds[static_cast<size_t>(e.emitter->get_kind())];
+        kind.live += e.emitter->particle_count();
+        ++kind.emitters;
+    }
+    for (const auto& kind : report.kinds) report.total += kind.live;
+
+    // Over budget: lowest priority kind first, farthest emitters first within a kind
+    if (report.total > budget) {
+        std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+            if (a.emitter->get_kind() != b.emitter->get_kind()) return a.emitter->get_kind() < b.emitter->get_kind();
+            return a.distance > b.distance;
+        });
+        size_t excess = report.total - budget;
+        for (auto& e : entries) {
+            if (excess == 0) break;
+            size_t n = std::min(excess, e.emitter->particle_count());
+            e.emitter->trim(n);
+            report.kinds[static_cast<size_t>(e.emitter->get_kind())].dropped += n;
+            report.kinds[static_cast<size_t>(e.emitter->get_kind())].live -= n;
+            report.total -= n;
+            excess -= n;
+        }
+    }
+
+    // Next frame's allowance: quota pressure per kind, overall pressure, then distance
+    float global_scale = pressure_scale(report.total, budget);
+    for (auto& kind : report.kinds) kind.spawn_scale = std::min(global_scale, pressure_scale(kind.live, kind.quota));
+    for (const auto& e : entries) {
+        auto& kind = report.kinds[static_cast<size_t>(e.emitter->get_kind())];
+        ParticleLod lod;
+        lod.spawn_scale = kind.spawn_scale;
+        lod.max_particles = kind.quota / std::max<size_t>(kind.emitters, 1);
+        if (e.distance > FAR_DISTANCE) {
+            lod.spawn_scale *= 0.1f;
+            lod.step_every = 4;
+        } else if (e.distance > NEAR_DISTANCE) {
+            float t = (e.distance - NEAR_DISTANCE) / (FAR_DISTANCE - NEAR_DISTANCE);
+            lod.spawn_scale *= 1.0f - 0.75f * t;
+            lod.step_every = 2;
+        }
+        if (lod.step_every > 1) ++kind.far_emitters;
+        e.emitter->set_lod(lod);
+    }
+    entries.clear();
+    last_report = report;
+
+    // Log when the set of throttled or dropped kinds changes, not every frame
+    std::string summary;
+    for (size_t k = 0; k < NUM_PARTICLE_KINDS; ++k) {
+        const auto& kind = report.kinds[k];
+        if (kind.emitters == 0 || (kind.spawn_scale >= 1.0f && kind.dropped == 0)) continue;
+        summary += std::string(" ") + particle_kind_name(static_cast<ParticleKind>(k));
+    }
+    if (summary != last_summary) {
+        if (summary.empty()) SDL_Log("Particles: back within budget (%zu/%zu)", report.total, budget);
+        else SDL_Log("Particles: %zu/%zu live, degrading:%s", report.total, budget, summary.c_str());
+        last_summary = summary;
+    }
+}
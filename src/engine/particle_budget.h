@@ -0,0 +1,70 @@
+#ifndef PARTICLE_BUDGET_H
+#define PARTICLE_BUDGET_H
+
+#include <SDL3/SDL.h>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ParticleEmitter;
+
+// Lowest priority first; over budget, kinds are dropped in this order
+enum class ParticleKind : uint8_t { GRASS, FOG, SPLASH, SNOW, RAIN, SMOKE, SPARK, FIRE, COUNT };
+static constexpr size_t NUM_PARTICLE_KINDS = static_cast<size_t>(ParticleKind::COUNT);
+const char* particle_kind_name(ParticleKind kind);
+
+// What the budget allows one emitter for the next frame
+struct ParticleLod {
+    float spawn_scale = 1.0f;  // Multiplies the emitter's spawn rate
+    int step_every = 1;  // Simulate every Nth frame with the accumulated dt
+    size_t max_particles = SIZE_MAX;
+};
+
+struct ParticleBudgetReport {
+    struct Kind {
+        size_t live = 0, quota = 0, emitters = 0;
+        size_t far_emitters = 0;  // Stepping at a reduced rate
+        size_t dropped = 0;  // Removed this frame to get back under budget
+        float spawn_scale = 1.0f;  // Quota pressure, before distance LOD
+    };
+    size_t total = 0, budget = 0;
+    std::array<Kind, NUM_PARTICLE_KINDS> kinds;
+};
+
+// Caps the total number of live particles. Each kind gets a share of the
+// budget that throttles its spawn rate (bursts may borrow past it); emitters far
+// from the focus spawn less and step less often, and when the total is still
+// over budget the lowest-priority, farthest particles go first.
+class ParticleBudget {
+public:
+    static constexpr float NEAR_DISTANCE = 512.0f;  // World pixels; full rate inside
+    static constexpr float FAR_DISTANCE = 1536.0f;  // Minimum rate beyond
+
+    explicit ParticleBudget(size_t budget = 100000) { set_budget(budget); }
+    void set_budget(size_t budget);
+    size_t get_budget() const { return budget; }
+
+    // Once per frame, after all emitters have updated
+    void begin_frame(SDL_FPoint focus);
+    void add(ParticleEmitter& emitter);
+    void end_frame();  // Trims, hands out the next frame's ParticleLod, updates the report
+
+    const ParticleBudgetReport& report() const { return last_report; }
+
+private:
+    struct Entry {
+        ParticleEmitter* emitter;
+        float distance;
+    };
+
+    size_t budget = 0;
+    std::array<size_t, NUM_PARTICLE_KINDS> quotas{};
+    SDL_FPoint focus = {0, 0};
+    std::vector<Entry> entries;
+    ParticleBudgetReport last_report;
+    std::string last_summary;  // Logged when it changes
+};
+
+#endif
@@ -0,0 +1,191 @@
+#include "particle_pool.h"
+#include <algorithm>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <xmmintrin.h>
+#endif
+
+void ParticlePool::reserve(size_t n) {
+    for (auto* v : {&x, &y, &vx, &vy, &life, &size, &aux, &r, &g, &b, &a}) v->reserve(n);
+    owner.reserve(n);
+}
+
+void ParticlePool::clear() {
+    for (auto* v : {&x, &y, &vx, &vy, &life, &size, &aux, &r, &g, &b, &a}) v->clear();
+    owner.clear();
+}
+
+size_t ParticlePool::add(uint32_t powner, float px, float py, float pvx, float pvy, float plife, float psize, std::array<float, 4> color, float paux) {
+    x.push_back(px);
+    y.push_back(py);
+    vx.push_back(pvx);
+    vy.push_back(pvy);
+    life.push_back(plife);
+    size.push_back(psize);
+    aux.push_back(paux);
+    r.push_back(color[0]);
+    g.push_back(color[1]);
+    b.push_back(color[2]);
+    a.push_back(color[3]);
+    owner.push_back(powner);
+    return life.size() - 1;
+}
+
+void ParticlePool::remove(size_t i) {
+    for (auto* v : {&x, &y, &vx, &vy, &life, &size, &aux, &r, &g, &b, &a}) {
+        (*v)[i] = v->back();
+        v->pop_back();
+    }
+    owner[i] = owner.back();
+    owner.pop_back();
+}
+
+namespace {
+
+// Lane types for the kernel below; each provides LANES, load, store, set1, add,
+// mul, and greater/select on a mask M.
+struct ScalarLanes {
+    using V = float;
+    using M = bool;
+    static constexpr size_t LANES = 1;
+    static V load(const float* p) { return *p; }
+    static void store(float* p, V v) { *p = v; }
+    static V set1(float f) { return f; }
+    static V add(V a, V b) { return a + b; }
+    static V mul(V a, V b) { return a * b; }
+    static M greater(V a, V b) { return a > b; }
+    static V select(M m, V a, V b) { return m ? a : b; }
+};
+
+#if defined(__AVX__)
+struct SimdLanes {
+    using V = __m256;
+    using M = __m256;
+    static constexpr size_t LANES = 8;
+    static V load(const float* p) { return _mm256_loadu_ps(p); }
+    static void store(float* p, V v) { _mm256_storeu_ps(p, v); }
+    static V set1(float f) { return _mm256_set1_ps(f); }
+    static V add(V a, V b) { return _mm256_add_ps(a, b); }
+    static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+    static M greater(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static V select(M m, V a, V b) { return _mm256_blendv_ps(b, a, m); }
+};
+#elif defined(__SSE2__) || defined(_M_X64)
+struct SimdLanes {
+    using V = __m128;
+    using M = __m128;
+    static constexpr size_t LANES = 4;
+    static V load(const float* p) { return _mm_loadu_ps(p); }
+    static void store(float* p, V v) { _mm_storeu_ps(p, v); }
+    static V set1(float f) { return _mm_set1_ps(f); }
+    static V add(V a, V b) { return _mm_add_ps(a, b); }
+    static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+    static M greater(V a, V b) { return _mm_cmpgt_ps(a, b); }
+    static V select(M m, V a, V b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+};
+#else
+using SimdLanes = ScalarLanes;
+#endif
+
+// Steps particles [begin, end) in blocks of L::LANES; returns where it stopped. The
+// dt-scaled terms vanish at dt 0 on their own, the factors are picked per lane.
+template <typename L>
+size_t integrate_range(ParticlePool& p, const ParticleMotion& m, const float* dt, size_t begin, size_t end) {
+    using V = typename L::V;
+    const V zero = L::set1(0.0f), one = L::set1(1.0f);
+    const V drift = L::set1(m.drift_x), gravity = L::set1(m.gravity);
+    const V damping = L::set1(m.damping), age = L::set1(-m.age_rate);
+    const V shrink = L::set1(m.shrink), grow = L::set1(m.grow), spin = L::set1(m.spin);
+    const V fade = L::set1(m.fade), alpha_from_life = L::set1(m.alpha_from_life), alpha_bias = L::set1(m.alpha_bias);
+    const bool alpha_tracks_life = m.alpha_from_life != 0.0f;
+
+    size_t i = begin;
+    for (; i + L::LANES <= end; i += L::LANES) {
+        V vdt = L::load(&dt[i]);
+        auto stepped = L::greater(vdt, zero);
+        V damp = L::select(stepped, damping, one);
+        V vx = L::load(&p.vx[i]), vy = L::load(&p.vy[i]);
+        L::store(&p.x[i], L::add(L::load(&p.x[i]), L::mul(L::add(vx, drift), vdt)));
+        L::store(&p.y[i], L::add(L::load(&p.y[i]), L::mul(vy, vdt)));
+        L::store(&p.vx[i], L::mul(vx, damp));
+        L::store(&p.vy[i], L::mul(L::add(vy, L::mul(gravity, vdt)), damp));
+        V life = L::add(L::load(&p.life[i]), L::mul(age, vdt));
+        L::store(&p.life[i], life);
+        L::store(&p.size[i], L::add(L::mul(L::load(&p.size[i]), L::select(stepped, shrink, one)), L::mul(grow, vdt)));
+        L::store(&p.aux[i], L::add(L::load(&p.aux[i]), L::mul(spin, vdt)));
+        V alpha = L::load(&p.a[i]);
+        L::store(&p.a[i], alpha_tracks_life ? L::select(stepped, L::add(L::mul(life, alpha_from_life), alpha_bias), alpha)
+                                            : L::mul(alpha, L::select(stepped, fade, one)));
+    }
+    return i;
+}
+
+}  // namespace
+
+void integrate_particles(ParticlePool& pool, const ParticleMotion& motion, const float* dt) {
+    size_t n = pool.count();
+    size_t done = integrate_range<SimdLanes>(pool, motion, dt, 0, n);
+    integrate_range<ScalarLanes>(pool, motion, dt, done, n);  // Tail
+}
+
+uint32_t ParticleGroup::acquire() {
+    uint32_t slot;
+    if (free_slots.empty()) {
+        slot = static_cast<uint32_t>(slots.size());
+        slots.emplace_back();
+    } else {
+        slot = free_slots.back();
+        free_slots.pop_back();
+        slots[slot] = Slot{};
+    }
+    slots[slot].held = true;
+    return slot;
+}
+
+void ParticleGroup::release(uint32_t slot) {
+    Slot& s = slots[slot];
+    s.held = false;
+    s.dt = 0.0f;
+    if (s.resident == 0) free_slots.push_back(slot);
+    else dirty = true;
+}
+
+void ParticleGroup::add(uint32_t slot, float px, float py, float pvx, float pvy, float plife, float psize, std::array<float, 4> color, float paux) {
+    pool.add(slot, px, py, pvx, pvy, plife, psize, color, paux);
+    ++slots[slot].resident;
+}
+
+void ParticleGroup::trim(uint32_t slot, size_t n) {
+    n = std::min(n, count(slot));
+    if (n == 0) return;
+    slots[slot].trimmed += static_cast<uint32_t>(n);
+    dirty = true;
+}
+
+void ParticleGroup::begin_step() {
+    step_dt.resize(pool.count());
+    for (size_t i = 0; i < pool.count(); ++i) step_dt[i] = slots[pool.owner[i]].dt;
+}
+
+void ParticleGroup::end_step() {
+    for (Slot& s : slots) s.dt = 0.0f;
+    cull();
+}
+
+void ParticleGroup::cull() {
+    for (size_t i = 0; i < pool.count();) {
+        // Slots only matter with a trim or release pending; otherwise it's the life check alone
+        if (pool.life[i] > 0.0f && (!dirty || (slots[pool.owner[i]].held && slots[pool.owner[i]].trimmed == 0))) {
+            ++i;
+            continue;
+        }
+        uint32_t slot = pool.owner[i];
+        Slot& s = slots[slot];
+        if (s.trimmed > 0) --s.trimmed;  // Whichever particle goes counts towards the trim
+        pool.remove(i);  // The particle moved in from the back is checked next
+        if (--s.resident == 0 && !s.held) free_slots.push_back(slot);
+    }
+    dirty = false;
+}
@@ -0,0 +1,99 @@
+#ifndef PARTICLE_POOL_H
+#define PARTICLE_POOL_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+// Structure-of-arrays particle storage. Particles are unordered: removing one
+// moves the last particle into its slot.
+class ParticlePool {
+public:
+    std::vector<float> x, y, vx, vy;
+    std::vector<float> life, size;
+    std::vector<float> aux;  // Rotation for snow and grass, streak length for rain
+    std::vector<float> r, g, b, a;  // 0..1
+    std::vector<uint32_t> owner;  // Emitter slot in the ParticleGroup
+
+    size_t count() const { return life.size(); }
+    bool empty() const { return life.empty(); }
+    void reserve(size_t n);
+    void clear();
+
+    size_t add(uint32_t powner, float px, float py, float pvx, float pvy, float plife, float psize,
+               std::array<float, 4> color = {0.4f, 0.6f, 1.0f, 0.5f}, float paux = 0.0f);
+    void remove(size_t i);  // Swap-and-pop
+};
+
+// How an emitter kind moves, ages and fades its particles. Applied per step, in order:
+//   pos += (vel + (drift_x, 0)) * dt;  vel.y += gravity * dt;  vel *= damping
+//   life -= age_rate * dt;  size = size * shrink + grow * dt;  aux += spin * dt
+//   a = alpha_from_life != 0 ? life * alpha_from_life + alpha_bias : a * fade
+struct ParticleMotion {
+    float drift_x = 0.0f;  // Wind
+    float gravity = 0.0f;
+    float damping = 1.0f;
+    float age_rate = 1.0f;
+    float shrink = 1.0f, grow = 0.0f;
+    float spin = 0.0f;
+    float fade = 1.0f;
+    float alpha_from_life = 0.0f, alpha_bias = 0.0f;
+};
+
+// SIMD (AVX when compiled with it, else SSE, else scalar) over the whole pool, with
+// dt per particle; particles at dt 0 are left as they are. Dead particles are kept.
+void integrate_particles(ParticlePool& pool, const ParticleMotion& motion, const float* dt);
+
+// Every particle of one kind, whichever emitter spawned it, in one pool so the
+// kind integrates in a single pass. Each emitter holds a slot and its particles
+// carry it as their owner; the slot keeps the emitter's count, its dt for the
+// next step and anything the budget trimmed. Not thread safe: one thread at a
+// time per group.
+class ParticleGroup {
+public:
+    uint32_t acquire();
+    void release(uint32_t slot);  // Its particles go at the next cull; the slot is reused after
+    size_t count(uint32_t slot) const { return slots[slot].resident - slots[slot].trimmed; }
+    size_t size() const { return pool.count(); }
+    void add(uint32_t slot, float px, float py, float pvx, float pvy, float plife, float psize,
+             std::array<float, 4> color = {0.4f, 0.6f, 1.0f, 0.5f}, float paux = 0.0f);
+    void set_step(uint32_t slot, float dt) { slots[slot].dt = dt; }  // For the next step only; 0 holds the slot still
+    void trim(uint32_t slot, size_t n);  // Drops n of its particles at the next cull
+    // Screen-space emitters wrap their particles within this
+    void set_bounds(uint32_t slot, float w, float h) { slots[slot].width = w; slots[slot].height = h; }
+    float width(uint32_t slot) const { return slots[slot].width; }
+    float height(uint32_t slot) const { return slots[slot].height; }
+
+    // A step: begin_step gathers each particle's dt from its slot, integrate and
+    // any pass of the kind's own use dt(i), end_step culls and clears the slots' dts
+    void begin_step();
+    void integrate(const ParticleMotion& motion) { integrate_particles(pool, motion, step_dt.data()); }
+    float dt(size_t i) const { return step_dt[i]; }
+    void end_step();
+    void cull();  // Drops dead particles, trimmed ones and those of released slots
+    bool needs_cull() const { return dirty; }
+
+    ParticlePool& particles() { return pool; }
+    const ParticlePool& particles() const { return pool; }
+    float rand01() { return std::uniform_real_distribution<float>(0.0f, 1.0f)(rng); }  // For the kind's own passes
+
+private:
+    struct Slot {
+        uint32_t resident = 0;  // In the pool, trimmed ones included
+        uint32_t trimmed = 0;
+        float dt = 0.0f;
+        float width = 0.0f, height = 0.0f;
+        bool held = false;  // False once the emitter let go
+    };
+
+    ParticlePool pool;
+    std::vector<Slot> slots;
+    std::vector<uint32_t> free_slots;  // Released and empty
+    std::vector<float> step_dt;  // Parallel to pool during a step
+    bool dirty = false;  // A trim or release is waiting for cull()
+    std::minstd_rand rng;
+};
+
+#endif
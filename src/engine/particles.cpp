@@ -1,323 +1,376 @@
 #include "particles.h"
+#include <atomic>
+#include <utility>
 #include <random>
 #include <algorithm>
 #include <cmath>
 
-std::random_device rd;
-std::mt19937 gen(rd());
-std::uniform_real_distribution<> dis(0.0f, 1.0f);  // Global for convenience
+namespace {
+
+// Particle i lag seconds back along its velocity: between the last two steps without keeping both
+SDL_FPoint draw_pos(const ParticlePool& p, size_t i, float lag) { return {p.x[i] - p.vx[i] * lag, p.y[i] - p.vy[i] * lag}; }
+
+}  // namespace
+
+// ParticleStore
+void ParticleStore::step(ParticleKind kind, float wind) {
+    ParticleGroup& group = (*this)[kind];
+    group.begin_step();
+    switch (kind) {
+    case ParticleKind::FIRE: FireEmitter::step(group); break;
+    case ParticleKind::SMOKE: SmokeEmitter::step(group, wind); break;
+    case ParticleKind::RAIN: RainEmitter::step(group, wind); break;
+    case ParticleKind::SNOW: SnowEmitter::step(group, wind); break;
+    case ParticleKind::SPLASH: SplashEmitter::step(group); break;
+    case ParticleKind::SPARK: SparkEmitter::step(group); break;
+    case ParticleKind::FOG: FogEmitter::step(group); break;
+    case ParticleKind::GRASS: GrassSwayEmitter::step(group, wind); break;
+    default: break;
+    }
+    group.end_step();
+}
+
+void ParticleStore::emit(ParticleKind kind, ParticleBatch& batch) const {
+    const ParticleGroup& group = (*this)[kind];
+    switch (kind) {
+    case ParticleKind::FIRE: FireEmitter::emit(group, batch); break;
+    case ParticleKind::SMOKE: SmokeEmitter::emit(group, batch); break;
+    case ParticleKind::RAIN: RainEmitter::emit(group, batch); break;
+    case ParticleKind::SNOW: SnowEmitter::emit(group, batch); break;
+    case ParticleKind::SPLASH: SplashEmitter::emit(group, batch); break;
+    case ParticleKind::SPARK: SparkEmitter::emit(group, batch); break;
+    case ParticleKind::FOG: FogEmitter::emit(group, batch); break;
+    case ParticleKind::GRASS: GrassSwayEmitter::emit(group, batch); break;
+    default: break;
+    }
+}
+
+void ParticleStore::cull() {
+    for (auto& group : groups) {
+        if (group.needs_cull()) group.cull();
+    }
+}
+
+size_t ParticleStore::size() const {
+    size_t n = 0;
+    for (const auto& group : groups) n += group.size();
+    return n;
+}
+
+// ParticleEmitter
+uint32_t ParticleEmitter::next_seed() {
+    static std::atomic<uint32_t> counter{0};
+    return 0x9E3779B9u * ++counter;  // Creation order decides the seed, so serial spawning stays reproducible
+}
+
+ParticleEmitter::ParticleEmitter(ParticleEmitter&& other) noexcept
+    : group(std::exchange(other.group, nullptr)), slot(other.slot), emitter_pos(other.emitter_pos), type(std::move(other.type)),
+      kind(other.kind), screen_space(other.screen_space), lod(other.lod), skipped_frames(other.skipped_frames),
+      skipped_dt(other.skipped_dt), rng(other.rng) {}
+
+ParticleEmitter& ParticleEmitter::operator=(ParticleEmitter&& other) noexcept {
+    if (this == &other) return *this;
+    release();
+    group = std::exchange(other.group, nullptr);
+    slot = other.slot;
+    emitter_pos = other.emitter_pos;
+    type = std::move(other.type);
+    kind = other.kind;
+    screen_space = other.screen_space;
+    lod = other.lod;
+    skipped_frames = other.skipped_frames;
+    skipped_dt = other.skipped_dt;
+    rng = other.rng;
+    return *this;
+}
 
 void ParticleEmitter::spawn(const std::string& type, SDL_FPoint pos, int count) {
     this->type = type;
     emitter_pos = pos;
     for (int i = 0; i < count; ++i) {
-        Particle p;
-        p.pos = pos;
-        p.vel.x = dis(gen) * 40 - 20;
-        p.vel.y = -dis(gen) * 50;
-        p.life = dis(gen) * 1.5f + 0.5f;
-        p.size = dis(gen) * 4 + 4;
-        particles.push_back(p);
+        float vx = rand01() * 40 - 20;
+        float vy = -rand01() * 50;
+        float life = rand01() * 1.5f + 0.5f;
+        add(pos.x, pos.y, vx, vy, life, rand01() * 4 + 4);
     }
 }
 
-// Base class implementations removed - they're defined in the header
+bool ParticleEmitter::spawn_due(float& timer, float rate, float dt) const {
+    timer += dt;
+    float scaled = rate * lod.spawn_scale;
+    if (scaled <= 0 || timer < 1.0f / scaled || particle_count() >= lod.max_particles) return false;
+    timer = 0.0f;
+    return true;
+}
+
+bool ParticleEmitter::take_step(float& dt) {
+    skipped_dt += dt;
+    if (++skipped_frames < lod.step_every) return false;
+    dt = skipped_dt;
+    skipped_frames = 0;
+    skipped_dt = 0.0f;
+    group->set_step(slot, dt);
+    return true;
+}
 
 // FireEmitter
 void FireEmitter::update(float dt) {
-    spawn_timer += dt;
-    if (spawn_timer >= 1.0f / spawn_rate) {
-        spawn_particle();
-        spawn_timer = 0.0f;
-    }
-    ParticleEmitter::update(dt);
+    if (!take_step(dt)) return;
+    if (spawn_due(spawn_timer, spawn_rate, dt)) spawn_particle();
 }
 
-void FireEmitter::render(SDL_Renderer* renderer) {
-    for (auto& p : particles) {
-        float t = 1.0f - p.life / (p.life + 1.0f);
-        p.color[0] = 255;
-        p.color[1] = t * 165;
-        p.color[2] = 0;
-        p.color[3] = p.life * 0.8f + 0.2f;
+void FireEmitter::step(ParticleGroup& group) {
+    ParticleMotion motion;
+    group.integrate(motion);
+}
+
+void FireEmitter::emit(const ParticleGroup& group, ParticleBatch& batch) {
+    const ParticlePool& particles = group.particles();
+    for (size_t i = 0; i < particles.count(); ++i) {
+        SDL_FPoint p = draw_pos(particles, i, batch.lag());
+        float life = particles.life[i];
+        float t = 1.0f - life / (life + 1.0f);
+        batch.quad(SDL_BLENDMODE_ADD, ParticleKind::FIRE, p.x, p.y, particles.size[i], {1.0f, t * 165 / 255.0f, 0.0f, life * 0.8f + 0.2f});
     }
-    ParticleEmitter::render(renderer);
 }
 
 void FireEmitter::spawn_particle() {
-    Particle p;
-    p.pos = emitter_pos;
-    p.vel.x = dis(gen) * 40 - 20;
-    p.vel.y = -dis(gen) * 80;
-    p.life = dis(gen) * 0.8f + 0.2f;
-    p.size = dis(gen) * 3 + 2;
-    p.color = {1.0f, 0.0f, 0.0f, 1.0f};
-    particles.push_back(p);
+    float vx = rand01() * 40 - 20;
+    float vy = -rand01() * 80;
+    float life = rand01() * 0.8f + 0.2f;
+    add(emitter_pos.x, emitter_pos.y, vx, vy, life, rand01() * 3 + 2, {1.0f, 0.0f, 0.0f, 1.0f});
 }
 
 // SmokeEmitter
-void SmokeEmitter::update(float dt, float wind_strength) {
-    spawn_timer += dt;
-    if (spawn_timer >= 1.0f / spawn_rate) {
-        spawn_particle();
-        spawn_timer = 0.0f;
-    }
+void SmokeEmitter::update(float dt) {
+    if (!take_step(dt)) return;
+    if (spawn_due(spawn_timer, spawn_rate, dt)) spawn_particle();
+}
 
-    for (auto& p : particles) {
-        p.pos.x += p.vel.x * dt + wind_strength * 20 * dt;
-        p.pos.y += p.vel.y * dt;
-        p.vel.y += p.accel.y * dt;
-        p.life -= dt * 0.5f;
-        p.size += dt * 2;
-        p.color[3] = p.life * 0.8f;
-    }
-    particles.erase(std::remove_if(particles.begin(), particles.end(), [](const Particle& p){ return p.life <= 0; }), particles.end());
-}
-
-void SmokeEmitter::render(SDL_Renderer* renderer) {
-    for (auto& p : particles) {
-        float t = 1.0f - p.life;
-        p.color[0] = 100 + t * 100;
-        p.color[1] = 100 + t * 100;
-        p.color[2] = 100 + t * 155;
-        SDL_SetRenderDrawColor(renderer, p.color[0], p.color[1], p.color[2], p.color[3]*255);
-        SDL_FRect quad = {p.pos.x - p.size/2, p.pos.y - p.size/2, p.size, p.size};
-        SDL_RenderFillRect(renderer, &quad);
+void SmokeEmitter::step(ParticleGroup& group, float wind_strength) {
+    ParticleMotion motion;
+    motion.drift_x = wind_strength * 20;
+    motion.age_rate = 0.5f;
+    motion.grow = 2.0f;
+    motion.alpha_from_life = 0.8f;
+    group.integrate(motion);
+}
+
+void SmokeEmitter::emit(const ParticleGroup& group, ParticleBatch& batch) {
+    const ParticlePool& particles = group.particles();
+    for (size_t i = 0; i < particles.count(); ++i) {
+        SDL_FPoint p = draw_pos(particles, i, batch.lag());
+        float t = 1.0f - particles.life[i];
+        SDL_FColor color = {(100 + t * 100) / 255.0f, (100 + t * 100) / 255.0f, (100 + t * 155) / 255.0f, particles.a[i]};
+        batch.quad(SDL_BLENDMODE_BLEND, ParticleKind::SMOKE, p.x, p.y, particles.size[i], color);
     }
-    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
 }
 
 void SmokeEmitter::spawn_particle() {
-    Particle p;
-    p.pos = emitter_pos;
-    p.vel.x = dis(gen) * 100 - 50;
-    p.vel.y = -dis(gen) * 30;
-    p.life = dis(gen) * 3 + 2;
-    p.size = dis(gen) * 4 + 8;
-    p.color = {0.4f, 0.4f, 0.5f, 0.5f};
-    particles.push_back(p);
+    float vx = rand01() * 100 - 50;
+    float vy = -rand01() * 30;
+    float life = rand01() * 3 + 2;
+    add(emitter_pos.x, emitter_pos.y, vx, vy, life, rand01() * 4 + 8, {0.4f, 0.4f, 0.5f, 0.5f});
 }
 
 // RainEmitter
-void RainEmitter::update(float dt, float wind, float intensity) {
-    wind_speed = wind;
+void RainEmitter::update(float dt, float intensity) {
     spawn_rate = 200 * intensity;
-    spawn_timer += dt;
-    if (spawn_timer >= 1.0f / spawn_rate) {
-        spawn_drop();
-        spawn_timer = 0.0f;
-    }
+    if (!take_step(dt)) return;
+    if (particle_count() < MAX_DROPS && spawn_due(spawn_timer, spawn_rate, dt)) spawn_drop();
+}
 
-    for (auto& p : particles) {
-        p.pos.x += (p.vel.x + wind_speed) * dt;
-        p.pos.y += p.vel.y * dt;
-        if (p.pos.y > height + p.length) {
-            p.pos.x = dis(gen) * width;
-            p.pos.y = -p.length;
+void RainEmitter::step(ParticleGroup& group, float wind) {
+    ParticleMotion motion;
+    motion.drift_x = wind;
+    motion.age_rate = 0.0f;  // Drops wrap instead of dying
+    group.integrate(motion);
+    ParticlePool& particles = group.particles();
+    for (size_t i = 0; i < particles.count(); ++i) {
+        if (group.dt(i) <= 0.0f) continue;
+        float width = group.width(particles.owner[i]), height = group.height(particles.owner[i]);
+        float length = particles.aux[i];
+        if (particles.y[i] > height + length) {
+            particles.x[i] = group.rand01() * width;
+            particles.y[i] = -length;
         }
-        if (p.pos.x < -10 || p.pos.x > width + 10) p.pos.x = dis(gen) * width;
+        if (particles.x[i] < -10 || particles.x[i] > width + 10) particles.x[i] = group.rand01() * width;
     }
-    while (particles.size() > 500) particles.erase(particles.begin());
 }
 
-void RainEmitter::render(SDL_Renderer* renderer) {
-    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
-    SDL_SetRenderDrawColor(renderer, 100, 150, 255, 128);
-    for (const auto& p : particles) {
-        SDL_FPoint end = {p.pos.x - p.vel.x * (p.length / 300.0f), p.pos.y - p.vel.y * (p.length / 300.0f)};
-        SDL_RenderLine(renderer, p.pos.x, p.pos.y, end.x, end.y);
+void RainEmitter::emit(const ParticleGroup& group, ParticleBatch& batch) {
+    const ParticlePool& particles = group.particles();
+    for (size_t i = 0; i < particles.count(); ++i) {
+        SDL_FPoint p = draw_pos(particles, i, batch.lag());
+        float streak = particles.aux[i] / 300.0f;
+        batch.streak(SDL_BLENDMODE_BLEND, p.x, p.y, p.x - particles.vx[i] * streak, p.y - particles.vy[i] * streak,
+                     particles.size[i], {100 / 255.0f, 150 / 255.0f, 1.0f, 128 / 255.0f});
     }
-    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
 }
 
 void RainEmitter::spawn_drop() {
-    Particle p;
-    p.pos.x = dis(gen) * width;
-    p.pos.y = -dis(gen) * 20;
-    p.vel.x = dis(gen) * 20 - 10;
-    p.vel.y = 300 + dis(gen) * 100;
-    p.life = 1.0f;
-    p.length = dis(gen) * 10 + 10;
-    p.size = 1.5f + dis(gen) * 1.0f;
-    particles.push_back(p);
+    float x = rand01() * width;
+    float y = -rand01() * 20;
+    float vx = rand01() * 20 - 10;
+    float vy = 300 + rand01() * 100;
+    float length = rand01() * 10 + 10;
+    add(x, y, vx, vy, 1.0f, 1.5f + rand01() * 1.0f, {0.4f, 0.6f, 1.0f, 0.5f}, length);
 }
 
 // SnowEmitter
-void SnowEmitter::update(float dt, float wind) {
-    wind_speed = wind;
-    spawn_timer += dt;
-    if (spawn_timer >= 1.0f / spawn_rate) {
-        spawn_flake();
-        spawn_timer = 0.0f;
-    }
+void SnowEmitter::update(float dt) {
+    if (!take_step(dt)) return;
+    if (spawn_due(spawn_timer, spawn_rate, dt)) spawn_flake();
+}
 
-    for (auto& p : particles) {
-        p.pos.x += (p.vel.x + wind_speed * 5) * dt;
-        p.pos.y += p.vel.y * dt;
-        p.rotation += dt * 2;
-        if (p.pos.y > height) {
-            p.pos.y = -p.size * 2;
-            p.pos.x = dis(gen) * width;
+void SnowEmitter::step(ParticleGroup& group, float wind) {
+    ParticleMotion motion;
+    motion.drift_x = wind * 5;
+    motion.age_rate = 0.0f;  // Flakes wrap instead of dying
+    motion.spin = 2.0f;
+    group.integrate(motion);
+    ParticlePool& particles = group.particles();
+    for (size_t i = 0; i < particles.count(); ++i) {
+        if (group.dt(i) > 0.0f && particles.y[i] > group.height(particles.owner[i])) {
+            particles.y[i] = -particles.size[i] * 2;
+            particles.x[i] = group.rand01() * group.width(particles.owner[i]);
         }
     }
 }
 
-void SnowEmitter::render(SDL_Renderer* renderer) {
-    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
-    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 200);
-    for (const auto& p : particles) {
-        SDL_FRect quad = {p.pos.x - p.size/2, p.pos.y - p.size/2, p.size, p.size};
-        SDL_RenderFillRect(renderer, &quad);
+void SnowEmitter::emit(const ParticleGroup& group, ParticleBatch& batch) {
+    const ParticlePool& particles = group.particles();
+    for (size_t i = 0; i < particles.count(); ++i) {
+        SDL_FPoint p = draw_pos(particles, i, batch.lag());
+        batch.quad(SDL_BLENDMODE_BLEND, ParticleKind::SNOW, p.x, p.y, particles.size[i], {1.0f, 1.0f, 1.0f, 200 / 255.0f});
     }
-    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
 }
 
 void SnowEmitter::spawn_flake() {
-    Particle p;
-    p.pos.x = dis(gen) * width;
-    p.pos.y = -dis(gen) * 10;
-    p.vel.x = dis(gen) * 20 - 10;
-    p.vel.y = 80 + dis(gen) * 70;
-    p.life = 1.0f;
-    p.size = dis(gen) * 4 + 2;
-    p.rotation = dis(gen) * 2 * M_PI;
-    particles.push_back(p);
+    float x = rand01() * width;
+    float y = -rand01() * 10;
+    float vx = rand01() * 20 - 10;
+    float vy = 80 + rand01() * 70;
+    float size = rand01() * 4 + 2;
+    add(x, y, vx, vy, 1.0f, size, {1.0f, 1.0f, 1.0f, 0.8f}, rand01() * 2 * M_PI);
 }
 
 // SplashEmitter
 void SplashEmitter::update(float dt) {
-    for (auto& p : particles) {
-        p.pos.x += p.vel.x * dt;
-        p.pos.y += p.vel.y * dt;
-        p.vel.y += 200 * dt;
-        p.life -= dt;
-        p.color[3] *= 0.95f;
-    }
-    particles.erase(std::remove_if(particles.begin(), particles.end(), [](const Particle& p){ return p.life <= 0; }), particles.end());
+    take_step(dt);
+}
+
+void SplashEmitter::step(ParticleGroup& group) {
+    ParticleMotion motion;
+    motion.gravity = 200.0f;
+    motion.fade = 0.95f;
+    group.integrate(motion);
 }
 
-void SplashEmitter::render(SDL_Renderer* renderer) {
-    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
-    SDL_SetRenderDrawColor(renderer, 100, 150, 255, 128);
-    for (const auto& p : particles) {
-        SDL_FRect quad = {p.pos.x - p.size/2, p.pos.y - p.size/2, p.size, p.size};
-        SDL_RenderFillRect(renderer, &quad);
+void SplashEmitter::emit(const ParticleGroup& group, ParticleBatch& batch) {
+    const ParticlePool& particles = group.particles();
+    for (size_t i = 0; i < particles.count(); ++i) {
+        SDL_FPoint p = draw_pos(particles, i, batch.lag());
+        batch.quad(SDL_BLENDMODE_BLEND, ParticleKind::SPLASH, p.x, p.y, particles.size[i], {100 / 255.0f, 150 / 255.0f, 1.0f, 128 / 255.0f});
     }
 }
 
 void SplashEmitter::spawn_splash(int count) {
     for (int i = 0; i < count; ++i) {
-        Particle p;
-        p.pos = emitter_pos;
-        p.vel.x = dis(gen) * 100 - 50;
-        p.vel.y = -dis(gen) * 50;
-        p.life = dis(gen) * 0.3 + 0.2;
-        p.size = dis(gen) * 2 + 1;
-        p.color = {0.4f, 0.6f, 1.0f, 0.7f};
-        particles.push_back(p);
+        float vx = rand01() * 100 - 50;
+        float vy = -rand01() * 50;
+        float life = rand01() * 0.3 + 0.2;
+        add(emitter_pos.x, emitter_pos.y, vx, vy, life, rand01() * 2 + 1, {0.4f, 0.6f, 1.0f, 0.7f});
     }
 }
 
 // SparkEmitter
 void SparkEmitter::update(float dt) {
-    for (auto& p : particles) {
-        p.pos.x += p.vel.x * dt;
-        p.pos.y += p.vel.y * dt;
-        p.vel.x *= 0.95f;
-        p.vel.y *= 0.95f;
-        p.life -= dt * 2;
-        p.color[3] *= 0.9f;
-        p.size *= 0.98f;
-    }
-    particles.erase(std::remove_if(particles.begin(), particles.end(), [](const Particle& p){ return p.life <= 0; }), particles.end());
+    take_step(dt);
+}
+
+void SparkEmitter::step(ParticleGroup& group) {
+    ParticleMotion motion;
+    motion.damping = 0.95f;
+    motion.age_rate = 2.0f;
+    motion.fade = 0.9f;
+    motion.shrink = 0.98f;
+    group.integrate(motion);
 }
 
-void SparkEmitter::render(SDL_Renderer* renderer) {
-    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_ADD);
-    SDL_SetRenderDrawColor(renderer, 255, 255, 0, 255);
-    for (const auto& p : particles) {
-        SDL_FRect quad = {p.pos.x - p.size/2, p.pos.y - p.size/2, p.size, p.size};
-        SDL_RenderFillRect(renderer, &quad);
+void SparkEmitter::emit(const ParticleGroup& group, ParticleBatch& batch) {
+    const ParticlePool& particles = group.particles();
+    for (size_t i = 0; i < particles.count(); ++i) {
+        SDL_FPoint p = draw_pos(particles, i, batch.lag());
+        batch.quad(SDL_BLENDMODE_ADD, ParticleKind::SPARK, p.x, p.y, particles.size[i], {1.0f, 1.0f, 0.0f, 1.0f});
     }
 }
 
 void SparkEmitter::spawn(int count) {
     for (int i = 0; i < count; ++i) {
-        Particle p;
-        p.pos = emitter_pos;
-        p.vel.x = dis(gen) * 200 - 100;
-        p.vel.y = dis(gen) * 200 - 100;
-        p.life = dis(gen) * 0.5 + 0.5;
-        p.size = dis(gen) * 3 + 1;
-        p.color = {1.0f, 1.0f, 0.0f, 1.0f};
-        particles.push_back(p);
+        float vx = rand01() * 200 - 100;
+        float vy = rand01() * 200 - 100;
+        float life = rand01() * 0.5 + 0.5;
+        add(emitter_pos.x, emitter_pos.y, vx, vy, life, rand01() * 3 + 1, {1.0f, 1.0f, 0.0f, 1.0f});
     }
 }
 
 // FogEmitter
 void FogEmitter::update(float dt) {
-    spawn_timer += dt;
-    if (spawn_timer >= 1.0f / spawn_rate) {
-        spawn_fog_blob();
-        spawn_timer = 0.0f;
-    }
+    if (!take_step(dt)) return;
+    if (spawn_due(spawn_timer, spawn_rate, dt)) spawn_fog_blob();
+}
 
-    for (auto& p : particles) {
-        p.pos.x += p.vel.x * dt * 0.5f;
-        p.pos.y += p.vel.y * dt;
-        p.life -= dt * 0.2f;
-        p.size += dt * 0.5f;
-        p.color[3] = p.life * 0.3f + 0.1f;
-    }
-    particles.erase(std::remove_if(particles.begin(), particles.end(), [](const Particle& p){ return p.life <= 0; }), particles.end());
+void FogEmitter::step(ParticleGroup& group) {
+    ParticleMotion motion;
+    motion.age_rate = 0.2f;
+    motion.grow = 0.5f;
+    motion.alpha_from_life = 0.3f;
+    motion.alpha_bias = 0.1f;
+    group.integrate(motion);
 }
 
-void FogEmitter::render(SDL_Renderer* renderer) {
-    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_ADD);
-    SDL_SetRenderDrawColor(renderer, 150, 150, 150, 50);
-    for (const auto& p : particles) {
-        SDL_FRect quad = {p.pos.x - p.size/2, p.pos.y - p.size/2, p.size, p.size};
-        SDL_RenderFillRect(renderer, &quad);
+void FogEmitter::emit(const ParticleGroup& group, ParticleBatch& batch) {
+    const ParticlePool& particles = group.particles();
+    for (size_t i = 0; i < particles.count(); ++i) {
+        SDL_FPoint p = draw_pos(particles, i, batch.lag());
+        batch.quad(SDL_BLENDMODE_ADD, ParticleKind::FOG, p.x, p.y, particles.size[i], {150 / 255.0f, 150 / 255.0f, 150 / 255.0f, 50 / 255.0f});
     }
 }
 
 void FogEmitter::spawn_fog_blob() {
-    Particle p;
-    p.pos = emitter_pos;
-    p.vel.x = dis(gen) * 20 - 10;
-    p.vel.y = dis(gen) * 10;
-    p.life = dis(gen) * 5 + 3;
-    p.size = dis(gen) * 10 + 5;
-    p.color = {0.6f, 0.6f, 0.6f, 0.3f};
-    particles.push_back(p);
+    float vx = (rand01() * 20 - 10) * 0.5f;  // Fog drifts at half speed sideways
+    float vy = rand01() * 10;
+    float life = rand01() * 5 + 3;
+    add(emitter_pos.x, emitter_pos.y, vx, vy, life, rand01() * 10 + 5, {0.6f, 0.6f, 0.6f, 0.3f});
 }
 
 // GrassSwayEmitter
-void GrassSwayEmitter::update(float dt, float wind) {
-    for (auto& p : particles) {
-        p.rotation += wind * 5 * dt;
-        p.pos.y += std::sin(p.rotation) * dt * 2;
+void GrassSwayEmitter::update(float dt) {
+    take_step(dt);
+}
+
+void GrassSwayEmitter::step(ParticleGroup& group, float wind) {
+    ParticlePool& particles = group.particles();
+    for (size_t i = 0; i < particles.count(); ++i) {
+        float dt = group.dt(i);
+        particles.aux[i] += wind * 5 * dt;
+        particles.y[i] += std::sin(particles.aux[i]) * dt * 2;
     }
 }
 
-void GrassSwayEmitter::render(SDL_Renderer* renderer) {
-    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
-    SDL_SetRenderDrawColor(renderer, 0, 100, 0, 255);
-    for (const auto& p : particles) {
-        SDL_FPoint tip = {p.pos.x + std::sin(p.rotation) * 10, p.pos.y - 15};
-        SDL_RenderLine(renderer, p.pos.x, p.pos.y, tip.x, tip.y);
+void GrassSwayEmitter::emit(const ParticleGroup& group, ParticleBatch& batch) {
+    const ParticlePool& particles = group.particles();
+    for (size_t i = 0; i < particles.count(); ++i) {
+        SDL_FPoint p = draw_pos(particles, i, batch.lag());
+        batch.streak(SDL_BLENDMODE_BLEND, p.x, p.y, p.x + std::sin(particles.aux[i]) * 10, p.y - 15,
+                     1.0f, {0.0f, 100 / 255.0f, 0.0f, 1.0f});
     }
 }
 
 void GrassSwayEmitter::spawn_blades(int count) {
     for (int i = 0; i < count; ++i) {
-        Particle p;
-        p.pos.x = emitter_pos.x + dis(gen) * 64 - 32;
-        p.pos.y = emitter_pos.y;
-        p.vel = {0, 0};
-        p.life = 1.0f;
-        p.size = 1.0f;
-        p.rotation = dis(gen) * 2 * M_PI;
-        particles.push_back(p);
+        float x = emitter_pos.x + rand01() * 64 - 32;
+        add(x, emitter_pos.y, 0, 0, 1.0f, 1.0f, {0.0f, 0.4f, 0.0f, 1.0f}, rand01() * 2 * M_PI);
     }
 }
@@ -4,37 +4,95 @@
 #include <SDL3/SDL.h>
 #include <vector>
 #include <string>
+#include <algorithm>
 #include <array>
 #include <random>
+#include "particle_pool.h"
+#include "particle_budget.h"
+#include "particle_batch.h"
 
-struct Particle {
-    SDL_FPoint pos, vel;
-    SDL_FPoint accel = {0, 0};
-    float life = 1.0f, size = 2.0f, rotation = 0.0f;  // Rotation for snow
-    std::array<float, 4> color = {0.4f, 0.6f, 1.0f, 0.5f};  // RGBA
-    float length = 15.0f;  // For rain streaks
+// Isometric pixel position of the centre of grid cell (x, y) with the camera at
+// the origin; world-space emitters live in this space so they line up with tiles
+inline SDL_FPoint grid_to_world(float x, float y) { return {(x - y) * 32.0f + 32.0f, (x + y) * 16.0f + 16.0f}; }
+
+// Every live particle, in one ParticleGroup per kind: however many emitters a
+// kind has, it integrates in one pass over one pool. Kinds don't share state, so
+// different kinds may step on different threads.
+class ParticleStore {
+public:
+    ParticleGroup& operator[](ParticleKind kind) { return groups[static_cast<size_t>(kind)]; }
+    const ParticleGroup& operator[](ParticleKind kind) const { return groups[static_cast<size_t>(kind)]; }
+    // Moves the particles of every emitter of the kind that updated since the last step
+    void step(ParticleKind kind, float wind = 0.0f);
+    void emit(ParticleKind kind, ParticleBatch& batch) const;  // Appends the kind's particles to the batch
+    void cull();  // Drops what the budget trimmed, before it's drawn
+    size_t size() const;
+    static bool is_screen_space(ParticleKind kind) { return kind == ParticleKind::RAIN || kind == ParticleKind::SNOW || kind == ParticleKind::FOG; }
+private:
+    std::array<ParticleGroup, NUM_PARTICLE_KINDS> groups;
 };
 
+// An emitter spawns into its kind's group in the store and decides when its
+// particles step; the store moves and draws them. Move-only, as it holds a slot.
 class ParticleEmitter {
 public:
+    ParticleEmitter(ParticleStore& store, ParticleKind kind) : group(&store[kind]), slot(group->acquire()), kind(kind) {}
+    ParticleEmitter(ParticleEmitter&& other) noexcept;
+    ParticleEmitter& operator=(ParticleEmitter&& other) noexcept;
+    virtual ~ParticleEmitter() { release(); }
+
     void spawn(const std::string& type, SDL_FPoint pos, int count);
-    virtual void update(float dt) {}
-    virtual void render(SDL_Renderer* renderer) {}
+    virtual void update(float dt) {}  // Spawns and sets this emitter's dt for the kind's next step
+
+    // For ParticleBudget
+    ParticleKind get_kind() const { return kind; }
+    SDL_FPoint get_origin() const { return emitter_pos; }
+    bool is_screen_space() const { return screen_space; }
+    size_t particle_count() const { return group ? group->count(slot) : 0; }
+    void set_lod(const ParticleLod& new_lod) { lod = new_lod; }
+    void trim(size_t n) { if (group) group->trim(slot, n); }
 protected:
-    std::vector<Particle> particles;
-    SDL_FPoint emitter_pos;
+    bool spawn_due(float& timer, float rate, float dt) const;  // rate per second, scaled and capped by the LOD
+    bool take_step(float& dt);  // False on frames the LOD skips; otherwise dt covers the skipped frames too, and is set for the step
+    void add(float px, float py, float pvx, float pvy, float plife, float psize,
+             std::array<float, 4> color = {0.4f, 0.6f, 1.0f, 0.5f}, float paux = 0.0f) {
+        group->add(slot, px, py, pvx, pvy, plife, psize, color, paux);
+    }
+
+    ParticleGroup* group;  // Null once moved from
+    uint32_t slot;
+    SDL_FPoint emitter_pos = {0, 0};
     std::string type;
+    ParticleKind kind;
+    bool screen_space = false;  // Follows the camera rather than a world position
+    ParticleLod lod;
+    int skipped_frames = 0;
+    float skipped_dt = 0.0f;
+
+    // Each emitter has its own generator so emitters can update on different threads
+    static uint32_t next_seed();
+    float rand01() { return std::uniform_real_distribution<float>(0.0f, 1.0f)(rng); }
+    std::minstd_rand rng{next_seed()};
+private:
+    void release() { if (group) group->release(slot); }
 };
 
+// Each kind's step() and emit() work on its whole group; ParticleStore calls them
+
 class FireEmitter : public ParticleEmitter {
 public:
-    FireEmitter(SDL_FPoint pos, int intensity = 1) {
+    FireEmitter(ParticleStore& store, SDL_FPoint pos, int intensity = 1) : ParticleEmitter(store, ParticleKind::FIRE) {
         emitter_pos = pos;
         type = "fire";
         spawn_rate = 20 * intensity;
     }
     void update(float dt) override;
-    void render(SDL_Renderer* renderer) override;
+    static void step(ParticleGroup& group);
+    static void emit(const ParticleGroup& group, ParticleBatch& batch);
+    void set_origin(SDL_FPoint pos) { emitter_pos = pos; }
+    void set_intensity(int intensity) { spawn_rate = 20 * intensity; }
+    void stop() { spawn_rate = 0; }  // Let live particles die out
+    bool finished() const { return spawn_rate == 0 && particle_count() == 0; }
 private:
     int spawn_rate = 20;
     float spawn_timer = 0.0f;
@@ -43,13 +101,14 @@ private:
 
 class SmokeEmitter : public ParticleEmitter {
 public:
-    SmokeEmitter(SDL_FPoint pos, int intensity = 1) {
+    SmokeEmitter(ParticleStore& store, SDL_FPoint pos, int intensity = 1) : ParticleEmitter(store, ParticleKind::SMOKE) {
         emitter_pos = pos;
         type = "smoke";
         spawn_rate = 15 * intensity;
     }
-    void update(float dt, float wind_strength = 0.0f);
-    void render(SDL_Renderer* renderer) override;
+    void update(float dt) override;
+    static void step(ParticleGroup& group, float wind_strength);
+    static void emit(const ParticleGroup& group, ParticleBatch& batch);
 private:
     int spawn_rate = 15;
     float spawn_timer = 0.0f;
@@ -58,48 +117,54 @@ private:
 
 class RainEmitter : public ParticleEmitter {
 public:
-    RainEmitter(int screen_w, int screen_h, float intensity = 1.0f) {
+    RainEmitter(ParticleStore& store, int screen_w, int screen_h, float intensity = 1.0f) : ParticleEmitter(store, ParticleKind::RAIN) {
         type = "rain";
+        screen_space = true;
         spawn_rate = 200 * intensity;
         width = screen_w;
         height = screen_h;
+        group->set_bounds(slot, width, height);
     }
-    void update(float dt, float wind = 0.0f, float intensity = 1.0f);
-    void render(SDL_Renderer* renderer) override;
+    void update(float dt, float intensity = 1.0f);
+    static void step(ParticleGroup& group, float wind);  // Drops wrap within their emitter's screen
+    static void emit(const ParticleGroup& group, ParticleBatch& batch);
 private:
     int spawn_rate = 200;
     float spawn_timer = 0.0f;
+    static constexpr size_t MAX_DROPS = 500;
     int width, height;
-    float wind_speed = 0.0f;
     void spawn_drop();
 };
 
 class SnowEmitter : public ParticleEmitter {
 public:
-    SnowEmitter(int screen_w, int screen_h, float intensity = 1.0f) {
+    SnowEmitter(ParticleStore& store, int screen_w, int screen_h, float intensity = 1.0f) : ParticleEmitter(store, ParticleKind::SNOW) {
         type = "snow";
+        screen_space = true;
         spawn_rate = 100 * intensity;
         width = screen_w;
         height = screen_h;
+        group->set_bounds(slot, width, height);
     }
-    void update(float dt, float wind = 0.0f);
-    void render(SDL_Renderer* renderer) override;
+    void update(float dt) override;
+    static void step(ParticleGroup& group, float wind);  // Flakes wrap within their emitter's screen
+    static void emit(const ParticleGroup& group, ParticleBatch& batch);
 private:
     int spawn_rate = 100;
     float spawn_timer = 0.0f;
     int width, height;
-    float wind_speed = 0.0f;
     void spawn_flake();
 };
 
 class SplashEmitter : public ParticleEmitter {
 public:
-    SplashEmitter(SDL_FPoint pos) {
+    SplashEmitter(ParticleStore& store, SDL_FPoint pos) : ParticleEmitter(store, ParticleKind::SPLASH) {
         emitter_pos = pos;
         type = "splash";
     }
     void update(float dt) override;
-    void render(SDL_Renderer* renderer) override;
+    static void step(ParticleGroup& group);
+    static void emit(const ParticleGroup& group, ParticleBatch& batch);
     void spawn_splash(int count = 5);
 private:
     float spawn_timer = 0.0f;
@@ -107,26 +172,29 @@ private:
 
 class SparkEmitter : public ParticleEmitter {
 public:
-    SparkEmitter(SDL_FPoint pos, int count) {
+    SparkEmitter(ParticleStore& store, SDL_FPoint pos, int count) : ParticleEmitter(store, ParticleKind::SPARK) {
         emitter_pos = pos;
         type = "spark";
         spawn(count);
     }
     void update(float dt) override;
-    void render(SDL_Renderer* renderer) override;
+    static void step(ParticleGroup& group);
+    static void emit(const ParticleGroup& group, ParticleBatch& batch);
 private:
     void spawn(int count);
 };
 
 class FogEmitter : public ParticleEmitter {
 public:
-    FogEmitter(SDL_FPoint pos, int intensity = 1) {
+    FogEmitter(ParticleStore& store, SDL_FPoint pos, int intensity = 1) : ParticleEmitter(store, ParticleKind::FOG) {
         emitter_pos = pos;
         type = "fog";
+        screen_space = true;
         spawn_rate = 5 * intensity;
     }
     void update(float dt) override;
-    void render(SDL_Renderer* renderer) override;
+    static void step(ParticleGroup& group);
+    static void emit(const ParticleGroup& group, ParticleBatch& batch);
 private:
     int spawn_rate = 5;
     float spawn_timer = 0.0f;
@@ -135,13 +203,14 @@ private:
 
 class GrassSwayEmitter : public ParticleEmitter {
 public:
-    GrassSwayEmitter(SDL_FPoint pos, int blade_count = 10) {
+    GrassSwayEmitter(ParticleStore& store, SDL_FPoint pos, int blade_count = 10) : ParticleEmitter(store, ParticleKind::GRASS) {
         emitter_pos = pos;
         type = "grass_sway";
         spawn_blades(blade_count);
     }
-    void update(float dt, float wind = 0.0f);
-    void render(SDL_Renderer* renderer) override;
+    void update(float dt) override;
+    static void step(ParticleGroup& group, float wind);
+    static void emit(const ParticleGroup& group, ParticleBatch& batch);
 private:
     void spawn_blades(int count);
 };
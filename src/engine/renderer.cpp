@@ -1,8 +1,21 @@
 #include "renderer.h"
 #include <algorithm>
+#include <climits>
+#include <cmath>
+#include <fstream>
 #include <nlohmann/json.hpp>
 #include <SDL3_image/SDL_image.h>
 
+Renderer::~Renderer() {
+    for (auto& layer : regions) {
+        for (auto& [key, region] : layer) {
+            if (region.texture) SDL_DestroyTexture(region.texture);
+        }
+    }
+    for (SDL_Texture* tex : spare_regions) SDL_DestroyTexture(tex);
+    if (particle_texture) SDL_DestroyTexture(particle_texture);
+}
+
 SDL_FPoint Renderer::grid_to_iso(int grid_x, int grid_y) {
     float sx = (grid_x - grid_y) * (tile_w / 2.0f) + camera.x;
     float sy = (grid_x + grid_y) * (tile_h / 2.0f) + camera.y;
@@ -16,84 +29,359 @@ std::pair<int, int> Renderer::screen_to_grid(float mx, float my) {
     return {gx, gy};
 }
 
-void Renderer::update_camera(int px, int py) {
-    auto iso_pos = grid_to_iso(px, py);
-    camera.x = 400 - iso_pos.x;
-    camera.y = 300 - iso_pos.y;
+void Renderer::update_camera(float px, float py) {
+    int w = 800, h = 600;
+    SDL_GetCurrentRenderOutputSize(sdl_renderer, &w, &h);
+    // Centre on (px, py); grid_to_iso would add the old camera in
+    camera.x = static_cast<int>(std::lround(w / 2 - (px - py) * (tile_w / 2)));
+    camera.y = static_cast<int>(std::lround(h / 2 - (px + py) * (tile_h / 2)));
 }
 
-SDL_Texture* Renderer::load_texture(const std::string& path) {
-    auto it = texture_cache.find(path);
-    if (it != texture_cache.end()) return it->second;
+const AtlasRegion& Renderer::frame_region(const Tiles& tileset, FrameId frame) {
+    static const AtlasRegion missing;
+    if (frame == NO_FRAME) return missing;
+    if (frame_handles.size() < tileset.frame_count()) frame_handles.resize(tileset.frame_count(), NO_TEXTURE);
+    TextureHandle& h = frame_handles[frame];
+    if (h == NO_TEXTURE) h = textures.handle(tileset.frame_path(frame));
+    return textures.get(h);
+}
 
-    std::string full_path = "assets/graphics/tiles/" + path;
-    SDL_Surface* surf = IMG_Load(full_path.c_str());
-    if (!surf) {
-        SDL_Log("Texture load error: %s", SDL_GetError());
-        return nullptr;
+void Renderer::prefetch(const World& world, const Chunk& chunk) {
+    const auto& tileset = world.get_tileset();
+    std::vector<bool> seen(tileset.size(), false);
+    for (const auto& layer : chunk.layers) {
+        for (int h = 0; h < World::MAX_HEIGHT_LEVELS; ++h) {
+            layer.for_each(h, [&](int, int, TileId id) {
+                if (seen[id]) return;
+                seen[id] = true;
+                for (int i = 0; i < tileset.hot_data(id).num_frames; ++i) {
+                    FrameId frame = tileset.frame(id, i);
+                    if (frame_handles.size() < tileset.frame_count()) frame_handles.resize(tileset.frame_count(), NO_TEXTURE);
+                    if (frame_handles[frame] == NO_TEXTURE) frame_handles[frame] = textures.handle(tileset.frame_path(frame));
+                    textures.request(frame_handles[frame]);
+                }
+            });
+        }
     }
-    SDL_Texture* tex = SDL_CreateTextureFromSurface(sdl_renderer, surf);
-    SDL_DestroySurface(surf);
-    texture_cache[path] = tex;
-    return tex;
 }
 
-void Renderer::render_layer(const World& world, int map_layer, float time) {
-    std::vector<Renderable> batch;
-
-    for (int gy = 0; gy < World::HEIGHT; ++gy) {
-        for (int gx = World::WIDTH + gy; gx >= gy; --gx) {
-            if (gx >= World::WIDTH || gy >= World::HEIGHT) continue;
-            for (const auto& height_entry : world.get_layer(map_layer)[gx][gy]) {
-                int h = height_entry.first;
-                const auto& tile_id = height_entry.second;
-                if (!tile_id) continue;
-                const auto* tile = world.get_tileset().get(*tile_id);
-                if (!tile || h >= tile->height_levels.size()) continue;
-
-                const auto& lev = tile->height_levels[h];
-                auto [sx, sy] = grid_to_iso(gx, gy);
-                sy -= lev.height * (tile_h / 2.0f);
-                SDL_FRect rect = {sx, sy, (float)tile_w, (float)tile_h};
-                float depth = sy + lev.height;
-
-                // Animated frame
-                std::string frame_path = tile->get_animated_frame(time);
-                SDL_Texture* tex = load_texture(frame_path);
-                if (!tex) {
-                    SDL_SetRenderDrawColor(sdl_renderer, 0, 128, 255, 128);  // Water blue fallback
-                    SDL_RenderFillRect(sdl_renderer, &rect);
+void Renderer::flush_tiles(int page) {
+    if (tile_indices.empty()) return;
+    SDL_Texture* tex = page >= 0 ? textures.page_texture(page) : nullptr;
+    if (!tex) SDL_SetRenderDrawBlendMode(sdl_renderer, SDL_BLENDMODE_BLEND);
+    SDL_RenderGeometry(sdl_renderer, tex, tile_vertices.data(), static_cast<int>(tile_vertices.size()),
+                       tile_indices.data(), static_cast<int>(tile_indices.size()));
+    ++tile_calls;
+    tile_vertices.clear();
+    tile_indices.clear();
+}
+
+Renderer::VisibleCells Renderer::cells_in(const SDL_FRect& area, float raise) {
+    // area is in world pixels; screen_to_grid takes screen ones. A tile's sprite
+    // hangs right and down from its grid point, and raised levels come up from below.
+    float x0 = area.x + camera.x - tile_w, x1 = area.x + camera.x + area.w;
+    float y0 = area.y + camera.y - tile_h, y1 = area.y + camera.y + area.h + raise;
+    const std::pair<int, int> corners[] = {screen_to_grid(x0, y0), screen_to_grid(x1, y0), screen_to_grid(x0, y1), screen_to_grid(x1, y1)};
+    VisibleCells v = {INT_MAX, INT_MIN, INT_MAX, INT_MIN};
+    for (auto [gx, gy] : corners) {
+        v.s0 = std::min(v.s0, gx + gy); v.s1 = std::max(v.s1, gx + gy);
+        v.d0 = std::min(v.d0, gx - gy); v.d1 = std::max(v.d1, gx - gy);
+    }
+    v.s0 -= CULL_MARGIN; v.s1 += CULL_MARGIN;  // screen_to_grid truncates
+    v.d0 -= CULL_MARGIN; v.d1 += CULL_MARGIN;
+    return v;
+}
+
+void Renderer::refresh_band_raise(const Tiles& tileset) {
+    band_raise.fill(0);
+    for (size_t id = 0; id < tileset.size(); ++id) {
+        const auto& tile = tileset.hot_data(static_cast<TileId>(id));
+        for (int h = 0; h < World::MAX_HEIGHT_LEVELS && h < tile.num_levels; ++h) band_raise[h] = std::max<int>(band_raise[h], tile.level_height[h]);
+    }
+}
+
+void Renderer::collect_tiles(const World& world, int map_layer, const SDL_FRect& area, SDL_FPoint offset, float time,
+                             std::vector<Renderable>& out, float& next_frame_change, bool& loading) {
+    const auto& tileset = world.get_tileset();
+    for (int h = 0; h < World::MAX_HEIGHT_LEVELS; ++h) {
+        VisibleCells v = cells_in(area, band_raise[h] * (tile_h / 2.0f));
+        world.get_chunks().for_each_resident([&](const Chunk& chunk) {
+            const ChunkPlane& plane = chunk.layers[map_layer].planes[h];
+            if (plane.storage() == ChunkPlane::Storage::UNIFORM && plane.fill_tile() == EMPTY_TILE) return;
+            int ox = chunk.origin_x(), oy = chunk.origin_y();
+            if (ox + oy + 2 * (CHUNK_SIZE - 1) < v.s0 || ox + oy > v.s1) return;
+            if (ox - oy + (CHUNK_SIZE - 1) < v.d0 || ox - oy - (CHUNK_SIZE - 1) > v.d1) return;
+
+            for (int lx = 0; lx < CHUNK_SIZE; ++lx) {
+                int gx = ox + lx;
+                // Rows of the chunk inside the visible diamond for this column
+                int gy0 = std::max({oy, v.s0 - gx, gx - v.d1});
+                int gy1 = std::min({oy + CHUNK_SIZE - 1, v.s1 - gx, gx - v.d0});
+                for (int gy = gy0; gy <= gy1; ++gy) {
+                    TileId id = plane.get(lx, gy - oy);
+                    if (id == EMPTY_TILE) continue;
+                    const auto& tile = tileset.hot_data(id);
+                    if (h >= tile.num_levels) continue;
+
+                    float sx = (gx - gy) * (tile_w / 2.0f) + offset.x;
+                    float sy = (gx + gy) * (tile_h / 2.0f) + offset.y - tile.level_height[h] * (tile_h / 2.0f);
+                    SDL_FRect rect = {sx, sy, (float)tile_w, (float)tile_h};
+                    // Screen row of the sprite's top, nudged so a raised level stays behind the row it overhangs
+                    int depth = (gx + gy) * (tile_h / 2) - tile.level_height[h] * (tile_h / 2 - 1);
+
+                    // Animated frame; remember when the next one is due
+                    const AtlasRegion& region = frame_region(tileset, tileset.frame_at(id, time));
+                    out.push_back({region.page, rect, region.uv, depth, 0});
+                    if (region.page == LOADING_PAGE) loading = true;
+                    if (tile.num_frames > 1 && tile.animation_speed > 0) {
+                        next_frame_change = std::min(next_frame_change, (std::floor(time * tile.animation_speed) + 1) / tile.animation_speed);
+                    }
                 }
+            }
+        });
+    }
+}
+
+// Counting sort on the integer depth: O(n + rows), stable, and no allocation
+// once the buffers have grown to the usual list size
+void Renderer::sort_by_depth(std::vector<Renderable>& list) {
+    if (list.size() < 2) return;
+    auto [lo, hi] = std::minmax_element(list.begin(), list.end(), [](const Renderable& a, const Renderable& b) { return a.depth < b.depth; });
+    int min_depth = lo->depth;
+    depth_starts.assign(static_cast<size_t>(hi->depth - min_depth) + 2, 0);
+    for (const auto& item : list) ++depth_starts[item.depth - min_depth + 1];
+    for (size_t i = 1; i < depth_starts.size(); ++i) depth_starts[i] += depth_starts[i - 1];
+    depth_sorted.resize(list.size());
+    for (const auto& item : list) depth_sorted[depth_starts[item.depth - min_depth]++] = item;
+    list.swap(depth_sorted);
+}
+
+void Renderer::draw_tiles(std::vector<Renderable>& list) {
+    sort_by_depth(list);
+
+    // Consecutive tiles on the same atlas page go out as one draw call
+    int run_page = list.empty() ? -1 : list.front().page;
+    for (const auto& item : list) {
+        if (item.page != run_page) {
+            flush_tiles(run_page);
+            run_page = item.page;
+        }
+        SDL_FColor color = {1, 1, 1, 1};
+        if (item.page == LOADING_PAGE) color = {0.3f, 0.3f, 0.3f, 0.5f};  // Dim until the image arrives
+        else if (item.page < 0) color = {0, 0.5f, 1, 0.5f};  // Water blue fallback
+        const SDL_FRect& d = item.dst;
+        const SDL_FRect& uv = item.uv;
+        int base = static_cast<int>(tile_vertices.size());
+        tile_vertices.push_back({{d.x, d.y}, color, {uv.x, uv.y}});
+        tile_vertices.push_back({{d.x + d.w, d.y}, color, {uv.x + uv.w, uv.y}});
+        tile_vertices.push_back({{d.x + d.w, d.y + d.h}, color, {uv.x + uv.w, uv.y + uv.h}});
+        tile_vertices.push_back({{d.x, d.y + d.h}, color, {uv.x, uv.y + uv.h}});
+        for (int i : {0, 1, 2, 0, 2, 3}) tile_indices.push_back(base + i);
+    }
+    flush_tiles(run_page);
+}
+
+// Region cache
+static uint64_t region_key(int rx, int ry) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(rx)) << 32) | static_cast<uint32_t>(ry);
+}
+
+void Renderer::invalidate(int map_layer, const SDL_FRect& area) {
+    int rx0 = static_cast<int>(std::floor(area.x / REGION_SIZE)), rx1 = static_cast<int>(std::floor((area.x + area.w) / REGION_SIZE));
+    int ry0 = static_cast<int>(std::floor(area.y / REGION_SIZE)), ry1 = static_cast<int>(std::floor((area.y + area.h) / REGION_SIZE));
+    for (int layer = 0; layer < World::NUM_MAP_LAYERS; ++layer) {
+        if (map_layer >= 0 && layer != map_layer) continue;
+        for (int ry = ry0; ry <= ry1; ++ry) {
+            for (int rx = rx0; rx <= rx1; ++rx) {
+                auto it = regions[layer].find(region_key(rx, ry));
+                if (it != regions[layer].end()) it->second.valid = false;
+            }
+        }
+    }
+}
+
+void Renderer::apply_changes(const World& world) {
+    const ChunkCache& chunks = world.get_chunks();
+    float raise = *std::max_element(band_raise.begin(), band_raise.end()) * (tile_h / 2.0f);
+    bool tracked = chunks.changes_since(seen_revision, [&](const ChunkCache::Change& c) {
+        if (c.layer < 0) {  // Paged in, well before it's on screen: decode its images now
+            if (const Chunk* chunk = chunks.find(ChunkCoord::of_tile(c.x, c.y))) prefetch(world, *chunk);
+        }
+        if (c.layer >= 0) {  // One cell's sprite
+            invalidate(c.layer, {(c.x - c.y) * (tile_w / 2.0f), (c.x + c.y) * (tile_h / 2.0f) - raise, (float)tile_w, tile_h + raise});
+        } else {  // A whole chunk's diamond
+            float left = (c.x - c.y - (CHUNK_SIZE - 1)) * (tile_w / 2.0f);
+            float top = (c.x + c.y) * (tile_h / 2.0f) - raise;
+            invalidate(-1, {left, top, CHUNK_SIZE * (float)tile_w, CHUNK_SIZE * (float)tile_h + raise});
+        }
+    });
+    if (!tracked) {
+        chunks.for_each_resident([&](const Chunk& chunk) { prefetch(world, chunk); });
+        for (auto& layer : regions) {
+            for (auto& entry : layer) entry.second.valid = false;
+        }
+    }
+    seen_revision = chunks.revision();
+}
 
-                batch.push_back({tex, rect, depth, 0});
+bool Renderer::draw_region(const World& world, int map_layer, int rx, int ry, CachedRegion& region, float time) {
+    SDL_FRect area = {(float)rx * REGION_SIZE, (float)ry * REGION_SIZE, (float)REGION_SIZE, (float)REGION_SIZE};
+    tile_list.clear();
+    region.next_frame_change = INFINITY;
+    region.loading = false;
+    region.generation = textures.generation();
+    collect_tiles(world, map_layer, area, {-area.x, -area.y}, time, tile_list, region.next_frame_change, region.loading);
+    region.valid = true;
+    ++regions_redrawn;
+    if (tile_list.empty()) {  // Nothing here; no texture needed
+        if (region.texture) spare_regions.push_back(region.texture);
+        region.texture = nullptr;
+        return true;
+    }
+
+    if (!region.texture) {
+        if (!spare_regions.empty()) {
+            region.texture = spare_regions.back();
+            spare_regions.pop_back();
+        } else if (frame_number >= target_retry_frame) {
+            region.texture = SDL_CreateTexture(sdl_renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_TARGET, REGION_SIZE, REGION_SIZE);
+            if (region.texture) {
+                // Blending onto a cleared target leaves premultiplied colour
+                SDL_SetTextureBlendMode(region.texture, SDL_BLENDMODE_BLEND_PREMULTIPLIED);
+            } else {
+                SDL_Log("Tile cache region without a render target: %s", SDL_GetError());
+                target_retry_frame = frame_number + TARGET_RETRY_FRAMES;
             }
         }
+        if (!region.texture) {  // Uncached until a later frame manages one
+            region.valid = false;
+            return false;
+        }
     }
 
-    std::sort(batch.begin(), batch.end(), [](const Renderable& a, const Renderable& b) { return a.depth < b.depth; });
+    SDL_Texture* previous = SDL_GetRenderTarget(sdl_renderer);
+    SDL_SetRenderTarget(sdl_renderer, region.texture);
+    SDL_SetRenderDrawColor(sdl_renderer, 0, 0, 0, 0);
+    SDL_RenderClear(sdl_renderer);
+    draw_tiles(tile_list);
+    SDL_SetRenderTarget(sdl_renderer, previous);
+    return true;
+}
 
-    for (const auto& item : batch) {
-        if (item.texture) {
-            SDL_SetTextureBlendMode(item.texture, SDL_BLENDMODE_BLEND);
-            SDL_RenderTexture(sdl_renderer, item.texture, nullptr, &item.dst);
+void Renderer::draw_direct(const World& world, int map_layer, const SDL_FRect& area, float time) {
+    float next_frame_change = INFINITY;
+    bool loading = false;
+    tile_list.clear();
+    collect_tiles(world, map_layer, area, {(float)camera.x, (float)camera.y}, time, tile_list, next_frame_change, loading);
+    draw_tiles(tile_list);
+}
+
+void Renderer::render_layer(const World& world, int map_layer, float time) {
+    int w = 800, h = 600;
+    SDL_GetCurrentRenderOutputSize(sdl_renderer, &w, &h);
+    int rx0 = static_cast<int>(std::floor(-camera.x / (float)REGION_SIZE)), rx1 = static_cast<int>(std::floor((w - camera.x) / (float)REGION_SIZE));
+    int ry0 = static_cast<int>(std::floor(-camera.y / (float)REGION_SIZE)), ry1 = static_cast<int>(std::floor((h - camera.y) / (float)REGION_SIZE));
+    for (int ry = ry0; ry <= ry1; ++ry) {
+        for (int rx = rx0; rx <= rx1; ++rx) {
+            CachedRegion& region = regions[map_layer][region_key(rx, ry)];
+            region.last_used = frame_number;
+            bool arrived = region.loading && region.generation != textures.generation();
+            bool cached = region.valid && time < region.next_frame_change && !arrived;
+            if (!cached && !draw_region(world, map_layer, rx, ry, region, time)) {
+                // Just this region, clipped to it so sprites reaching into cached neighbours aren't drawn twice
+                SDL_Rect clip = {rx * REGION_SIZE + camera.x, ry * REGION_SIZE + camera.y, REGION_SIZE, REGION_SIZE};
+                SDL_SetRenderClipRect(sdl_renderer, &clip);
+                draw_direct(world, map_layer, {(float)rx * REGION_SIZE, (float)ry * REGION_SIZE, (float)REGION_SIZE, (float)REGION_SIZE}, time);
+                SDL_SetRenderClipRect(sdl_renderer, nullptr);
+                continue;
+            }
+            if (!region.texture) continue;
+            SDL_FRect dst = {(float)(rx * REGION_SIZE + camera.x), (float)(ry * REGION_SIZE + camera.y), (float)REGION_SIZE, (float)REGION_SIZE};
+            SDL_RenderTexture(sdl_renderer, region.texture, nullptr, &dst);
         }
     }
+}
 
-    // Emitters (fire, smoke, rain, snow, splash, spark, fog, grass_sway)
-    // Assume world has vectors; call emitter.render(sdl_renderer);
+void Renderer::trim_regions() {
+    for (auto& layer : regions) {
+        for (auto it = layer.begin(); it != layer.end();) {
+            if (frame_number - it->second.last_used <= REGION_KEEP_FRAMES) {
+                ++it;
+                continue;
+            }
+            if (it->second.texture) spare_regions.push_back(it->second.texture);
+            it = layer.erase(it);
+        }
+    }
+    while (spare_regions.size() > MAX_SPARE_REGIONS) {
+        SDL_DestroyTexture(spare_regions.back());
+        spare_regions.pop_back();
+    }
+}
+
+bool Renderer::load_particle_atlas(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) return false;
+    nlohmann::json atlas = nlohmann::json::parse(file, nullptr, false);
+    if (atlas.is_discarded() || !atlas.contains("image") || !atlas.contains("sprites")) {
+        SDL_Log("Particle atlas error: %s is malformed", path.c_str());
+        return false;
+    }
+
+    std::string image_path = "assets/" + atlas["image"].get<std::string>();
+    SDL_Surface* surf = IMG_Load(image_path.c_str());
+    if (!surf) {
+        SDL_Log("Particle atlas error: %s", SDL_GetError());
+        return false;
+    }
+    float w = static_cast<float>(surf->w), h = static_cast<float>(surf->h);
+    SDL_Texture* tex = SDL_CreateTextureFromSurface(sdl_renderer, surf);
+    SDL_DestroySurface(surf);
+    if (!tex) return false;
 
-    lighting.update_occluders(world.get_tileset(), world, map_layer);
-    lighting.render_lighting(world, map_layer);
+    std::array<SDL_FRect, NUM_PARTICLE_KINDS> uv{};
+    const auto& sprites = atlas["sprites"];
+    for (size_t k = 0; k < NUM_PARTICLE_KINDS; ++k) {
+        auto it = sprites.find(particle_kind_name(static_cast<ParticleKind>(k)));
+        if (it == sprites.end() || it->size() != 4) continue;  // Flat quads for this kind
+        uv[k] = {(*it)[0].get<float>() / w, (*it)[1].get<float>() / h, (*it)[2].get<float>() / w, (*it)[3].get<float>() / h};
+    }
+    if (particle_texture) SDL_DestroyTexture(particle_texture);
+    particle_texture = tex;
+    particle_batch.set_atlas(tex, uv);
+    return true;
 }
 
-void Renderer::render_world(const World& world, int player_layer, float time) {
+void Renderer::render_particles(const World& world, float lag) {
+    SDL_FPoint cam = {static_cast<float>(camera.x), static_cast<float>(camera.y)};
+    particle_batch.set_lag(lag);
+    for (size_t k = 0; k < NUM_PARTICLE_KINDS; ++k) {
+        auto kind = static_cast<ParticleKind>(k);
+        particle_batch.set_offset(ParticleStore::is_screen_space(kind) ? SDL_FPoint{0, 0} : cam);
+        world.get_particles().emit(kind, particle_batch);
+    }
+    particle_batch.flush(sdl_renderer);
+}
+
+void Renderer::render_world(const World& world, int player_layer, float time, float lag) {
     SDL_SetRenderDrawColor(sdl_renderer, 0, 0, 0, 255);
     SDL_RenderClear(sdl_renderer);
-    
+    tile_calls = 0;
+    regions_redrawn = 0;
+    ++frame_number;
+    textures.begin_frame();
+    refresh_band_raise(world.get_tileset());
+    apply_changes(world);
+    lighting.update_occluders(world.get_tileset(), world);
+    lighting.update_lights(world.get_jobs());
+
     // Render layers
     for (int layer = 0; layer < World::NUM_MAP_LAYERS; ++layer) {
         render_layer(world, layer, time);
     }
-    
+    lighting.render_lighting(world, {(float)camera.x, (float)camera.y});
+    render_particles(world, lag);
+    trim_regions();
+
     SDL_RenderPresent(sdl_renderer);
 }
@@ -2,16 +2,20 @@
 #define RENDERER_H
 
 #include <SDL3/SDL.h>
+#include <array>
 #include <unordered_map>
 #include <vector>
 #include "../game/world.h"
 #include "particles.h"
+#include "particle_batch.h"
+#include "texture_manager.h"
 #include "lighting.h"
 
 struct Renderable {
-    SDL_Texture* texture;
+    int page;  // Atlas page; -1 draws the untextured fallback
     SDL_FRect dst;
-    float depth;
+    SDL_FRect uv;
+    int depth;  // Draw order, back to front; screen rows, so sprites of any kind can share one list
     int z_offset = 0;
 };
 
@@ -21,17 +25,85 @@ private:
     int tile_w = 64, tile_h = 32;
     SDL_Point camera = {0, 0};
     Lighting lighting;
-    std::unordered_map<std::string, SDL_Texture*> texture_cache;
+    TextureManager textures;
+    std::vector<TextureHandle> frame_handles;  // Indexed by FrameId
+    SDL_Texture* particle_texture = nullptr;
+    std::vector<SDL_Vertex> tile_vertices;  // Current run of same-page tiles
+    std::vector<int> tile_indices;
+    size_t tile_calls = 0;  // This frame
+    ParticleBatch particle_batch;
+
+    // Iso cells that can reach the viewport: s = gx + gy runs down the screen, d = gx - gy across it
+    struct VisibleCells {
+        int s0, s1, d0, d1;
+    };
+    static constexpr int CULL_MARGIN = 2;  // Cells, on each side of the diamond
+    VisibleCells cells_in(const SDL_FRect& area, float raise);  // area in world pixels; raise = how far sprites are lifted
+    std::array<int, World::MAX_HEIGHT_LEVELS> band_raise{};  // Tallest lift per height band, in level units
+    void refresh_band_raise(const Tiles& tileset);
+
+    // Tiles whose sprites overlap a world-pixel area, moved by offset; next_frame_change
+    // is lowered to the time the first animated one among them changes frame, and
+    // loading is set if any of them is still a placeholder
+    void collect_tiles(const World& world, int map_layer, const SDL_FRect& area, SDL_FPoint offset, float time,
+                       std::vector<Renderable>& out, float& next_frame_change, bool& loading);
+    void sort_by_depth(std::vector<Renderable>& list);
+    void draw_tiles(std::vector<Renderable>& list);  // Depth-sorts, then batches by atlas page
+    std::vector<Renderable> tile_list;  // Reused every draw
+    std::vector<Renderable> depth_sorted;  // sort_by_depth scratch
+    std::vector<uint32_t> depth_starts;
+
+    // Static tiles are cached per layer in render targets covering REGION_SIZE
+    // squares of world pixels. A region redraws when a cell under it changes, a
+    // chunk pages in or out, an animated tile in it moves to its next frame, or
+    // images it was waiting for arrive.
+    struct CachedRegion {
+        SDL_Texture* texture = nullptr;  // nullptr while the region is empty
+        bool valid = false;
+        float next_frame_change = 0.0f;
+        bool loading = false;  // Drew placeholders; redraw when TextureManager::generation() moves past
+        uint64_t generation = 0;
+        uint64_t last_used = 0;
+    };
+    static constexpr int REGION_SIZE = 256;
+    static constexpr uint64_t REGION_KEEP_FRAMES = 120;  // Off-screen regions are dropped after this
+    static constexpr size_t MAX_SPARE_REGIONS = 32;
+    std::array<std::unordered_map<uint64_t, CachedRegion>, World::NUM_MAP_LAYERS> regions;
+    std::vector<SDL_Texture*> spare_regions;  // Textures of dropped regions, for reuse
+    uint64_t seen_revision = 0;  // ChunkCache::revision() already applied
+    uint64_t frame_number = 0;
+    size_t regions_redrawn = 0;  // This frame
+    static constexpr uint64_t TARGET_RETRY_FRAMES = 120;  // After a render target fails to create
+    uint64_t target_retry_frame = 0;  // No new region textures are tried before this frame
+    void apply_changes(const World& world);
+    void invalidate(int map_layer, const SDL_FRect& area);  // map_layer -1 = every layer
+    bool draw_region(const World& world, int map_layer, int rx, int ry, CachedRegion& region, float time);  // false: no texture for it
+    void draw_direct(const World& world, int map_layer, const SDL_FRect& area, float time);  // Straight to the screen
+    void trim_regions();
+
+    void prefetch(const World& world, const Chunk& chunk);  // Start decoding every frame of the chunk's tiles
+    void flush_tiles(int page);
 
 public:
-    Renderer(SDL_Renderer* r) : sdl_renderer(r), lighting(r) {}
+    Renderer(SDL_Renderer* r) : sdl_renderer(r), lighting(r), textures(r) {}
+    ~Renderer();
+    Renderer(const Renderer&) = delete;
+    Renderer& operator=(const Renderer&) = delete;
     SDL_FPoint grid_to_iso(int x, int y);
     std::pair<int, int> screen_to_grid(float mx, float my);
-    void update_camera(int px, int py);
+    void update_camera(float px, float py);  // Fractional while the player is between tiles
     void render_layer(const World& world, int map_layer, float time);
-    void render_world(const World& world, int player_layer, float time);
-    void add_light(const Light& light) { lighting.add_source(light); }
-    SDL_Texture* load_texture(const std::string& path);
+    void render_world(const World& world, int player_layer, float time, float lag = 0.0f);  // lag: see FixedTimestep::lag
+    void render_particles(const World& world, float lag);  // Every emitter, one draw call per blend mode and texture
+    bool load_particle_atlas(const std::string& path);  // Optional; particles draw as flat quads without it
+    size_t particle_draw_calls() const { return particle_batch.last_draw_calls(); }
+    size_t add_light(const Light& light) { return lighting.add_source(light); }
+    void move_light(size_t index, SDL_FPoint pos) { lighting.move_source(index, pos); }
+    const AtlasRegion& frame_region(const Tiles& tileset, FrameId frame);
+    size_t tile_draw_calls() const { return tile_calls; }
+    size_t tile_regions_redrawn() const { return regions_redrawn; }
+    TextureManager& get_textures() { return textures; }
+    Lighting& get_lighting() { return lighting; }
 };
 
 #endif
@@ -0,0 +1,143 @@
+#include "texture_manager.h"
+#include <SDL3_image/SDL_image.h>
+#include <cstdlib>
+
+TextureManager::TextureManager(SDL_Renderer* r, std::string root) : root(std::move(root)), atlas(r) {
+    for (int i = 0; i < DECODE_THREADS; ++i) workers.emplace_back(&TextureManager::worker_loop, this);
+}
+
+TextureManager::~TextureManager() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    work_cv.notify_all();
+    for (auto& worker : workers) worker.join();
+    for (auto& d : decoded) SDL_DestroySurface(d.surface);
+}
+
+TextureHandle TextureManager::handle(const std::string& path) {
+    auto it = handles.find(path);
+    if (it != handles.end()) return it->second;
+    TextureHandle h = static_cast<TextureHandle>(entries.size());
+    entries.push_back({path});
+    handles[path] = h;
+    return h;
+}
+
+void TextureManager::request(TextureHandle h) {
+    if (h >= entries.size() || entries[h].state != State::UNLOADED) return;
+    entries[h].state = State::QUEUED;
+    ++queued;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        requests.emplace_back(h, entries[h].path);
+    }
+    work_cv.notify_one();
+}
+
+const AtlasRegion& TextureManager::get(TextureHandle h) {
+    static const AtlasRegion loading = {LOADING_PAGE};
+    static const AtlasRegion missing;
+    if (h >= entries.size()) return missing;
+    Entry& e = entries[h];
+    switch (e.state) {
+    case State::RESIDENT:
+        page_used[e.region.page] = frame;
+        return e.region;
+    case State::FAILED:
+        return missing;
+    default:
+        request(h);
+        return loading;
+    }
+}
+
+// A frame's own PNG, or for "<tile>_frame<i>.png" frame i of the prebuilt
+// "<tile>_atlas.png" strip of square frames that generate_data.py writes
+SDL_Surface* TextureManager::decode(const std::string& path) const {
+    if (SDL_Surface* surf = IMG_Load((root + path).c_str())) return surf;
+
+    size_t mark = path.rfind("_frame");
+    if (mark == std::string::npos) return nullptr;
+    SDL_Surface* strip = IMG_Load((root + path.substr(0, mark) + "_atlas.png").c_str());
+    if (!strip) return nullptr;
+    int index = std::atoi(path.c_str() + mark + 6);
+    SDL_Rect src = {index * strip->h, 0, strip->h, strip->h};
+    SDL_Surface* frame = nullptr;
+    if (src.x + src.w <= strip->w && (frame = SDL_CreateSurface(src.w, src.h, SDL_PIXELFORMAT_RGBA32))) {
+        SDL_SetSurfaceBlendMode(strip, SDL_BLENDMODE_NONE);
+        SDL_BlitSurface(strip, &src, frame, nullptr);
+    }
+    SDL_DestroySurface(strip);
+    return frame;
+}
+
+void TextureManager::worker_loop() {
+    while (true) {
+        std::pair<TextureHandle, std::string> job;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            work_cv.wait(lock, [this] { return stopping || !requests.empty(); });
+            if (stopping) return;
+            job = std::move(requests.front());
+            requests.pop_front();
+        }
+        SDL_Surface* surface = decode(job.second);
+        std::lock_guard<std::mutex> lock(mtx);
+        decoded.push_back({job.first, surface});
+    }
+}
+
+void TextureManager::begin_frame() {
+    ++frame;
+    size_t uploaded = 0;
+    while (uploaded < upload_budget) {  // At least one image a frame, however large
+        Decoded d;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (decoded.empty()) break;
+            d = decoded.front();
+            decoded.pop_front();
+        }
+        Entry& e = entries[d.handle];
+        --queued;
+        ++changes;
+        if (d.surface) {
+            e.region = atlas.add(d.surface);
+            uploaded += static_cast<size_t>(d.surface->w) * d.surface->h * 4;
+            SDL_DestroySurface(d.surface);
+        }
+        if (!d.surface || !e.region.valid()) {
+            SDL_Log("Texture load error: %s", e.path.c_str());
+            e.state = State::FAILED;
+            e.region = {};
+            continue;
+        }
+        e.state = State::RESIDENT;
+        if (page_used.size() < atlas.page_count()) page_used.resize(atlas.page_count(), 0);
+        page_used[e.region.page] = frame;  // New pages count as used, so they aren't evicted straight away
+    }
+    evict();
+}
+
+void TextureManager::evict() {
+    while (atlas.memory_bytes() > memory_budget) {
+        // Least recently drawn page that wasn't on screen last frame
+        int victim = -1;
+        for (int page = 0; page < static_cast<int>(atlas.page_count()); ++page) {
+            if (!atlas.page_live(page) || page_used[page] + 1 >= frame) continue;
+            if (victim < 0 || page_used[page] < page_used[victim]) victim = page;
+        }
+        if (victim < 0) return;  // Everything is in view; over budget until it isn't
+
+        for (auto& e : entries) {
+            if (e.state == State::RESIDENT && e.region.page == victim) {
+                e.state = State::UNLOADED;
+                e.region = {};
+            }
+        }
+        atlas.release_page(victim);
+        ++changes;
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef TEXTURE_MANAGER_H
+#define TEXTURE_MANAGER_H
+
+#include <SDL3/SDL.h>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "atlas.h"
+
+using TextureHandle = uint32_t;  // Stable for the manager's lifetime
+static constexpr TextureHandle NO_TEXTURE = UINT32_MAX;
+
+// Images by handle, kept in a SpriteAtlas. Images decode on worker threads,
+// upload on the render thread within a per-frame budget, and when the atlas
+// grows past the memory budget the least recently drawn pages are freed; their
+// images decode again the next time they're needed.
+class TextureManager {
+public:
+    static constexpr size_t DEFAULT_MEMORY_BUDGET = 64u << 20;  // Bytes of atlas pages
+    static constexpr size_t DEFAULT_UPLOAD_BUDGET = 1u << 20;  // Bytes of new images per frame
+    static constexpr int DECODE_THREADS = 2;
+
+    explicit TextureManager(SDL_Renderer* r, std::string root = "assets/graphics/tiles/");
+    ~TextureManager();
+    TextureManager(const TextureManager&) = delete;
+    TextureManager& operator=(const TextureManager&) = delete;
+
+    TextureHandle handle(const std::string& path);  // Doesn't load anything
+    void request(TextureHandle h);  // Starts decoding unless resident, on its way or failed
+    // Marks it drawn this frame. Until it's resident this returns a LOADING_PAGE
+    // region (and requests it); an image that failed to load has page -1.
+    const AtlasRegion& get(TextureHandle h);
+    SDL_Texture* page_texture(int page) { return atlas.page_texture(page); }
+
+    void begin_frame();  // Uploads decoded images within the budget, then evicts over budget
+    uint64_t generation() const { return changes; }  // Changes whenever an image arrives or leaves
+
+    void set_memory_budget(size_t bytes) { memory_budget = bytes; }
+    void set_upload_budget(size_t bytes) { upload_budget = bytes; }
+    size_t memory_bytes() const { return atlas.memory_bytes(); }
+    size_t page_count() const { return atlas.page_count(); }
+    size_t in_flight() const { return queued; }  // Requested but not resident yet
+
+private:
+    enum class State : uint8_t { UNLOADED, QUEUED, RESIDENT, FAILED };
+    struct Entry {
+        std::string path;
+        State state = State::UNLOADED;
+        AtlasRegion region;
+    };
+    struct Decoded {
+        TextureHandle handle;
+        SDL_Surface* surface;  // nullptr if it failed
+    };
+
+    SDL_Surface* decode(const std::string& path) const;  // Worker threads
+    void worker_loop();
+    void evict();
+
+    std::string root;
+    SpriteAtlas atlas;
+    std::vector<Entry> entries;  // Indexed by handle; render thread only
+    std::unordered_map<std::string, TextureHandle> handles;
+    std::vector<uint64_t> page_used;  // Frame each atlas page was last drawn from
+    uint64_t frame = 0;
+    uint64_t changes = 0;
+    size_t queued = 0;
+    size_t memory_budget = DEFAULT_MEMORY_BUDGET;
+    size_t upload_budget = DEFAULT_UPLOAD_BUDGET;
+
+    // Shared with the decode threads, guarded by mtx
+    std::vector<std::thread> workers;
+    std::mutex mtx;
+    std::condition_variable work_cv;
+    std::deque<std::pair<TextureHandle, std::string>> requests;
+    std::deque<Decoded> decoded;
+    bool stopping = false;
+};
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstdint>
+
+// Stateless random value in [0, 1) for a cell. Lets parallel passes make the
+// same random choices no matter which thread visits the cell or in what order.
+inline float hash01(uint32_t seed, int x, int y, int salt = 0) {
+    uint64_t h = seed;
+    h ^= static_cast<uint64_t>(static_cast<uint32_t>(x)) * 0x9E3779B97F4A7C15ull;
+    h ^= static_cast<uint64_t>(static_cast<uint32_t>(y)) * 0xC2B2AE3D27D4EB4Full;
+    h ^= static_cast<uint64_t>(static_cast<uint32_t>(salt)) * 0x165667B19E3779F9ull;
+    h ^= h >> 30; h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 27; h *= 0x94D049BB133111EBull;
+    h ^= h >> 31;
+    return (h >> 40) * (1.0f / (1 << 24));
+}
+
+#endif
@@ -9,6 +9,7 @@
 class Actor {
 public:
     int x = 0, y = 0, current_map_layer = 1;  // Z-level
+    int prev_x = 0, prev_y = 0;  // Before the last simulation step
     int height = 1;  // Actor height for blocking
     int health = 100, max_health = 100;
     int mana = 100, max_mana = 100;
@@ -23,6 +24,10 @@ public:
     bool learn_spell(const Spell& spell);  // Returns success
     bool cast_spell(const std::string& spell_id, Actor& target);  // Returns success; affects target
     void regen_mana(int turns);  // Regens over time
+
+    // Where to draw: between the last two steps, alpha of the way (see FixedTimestep::alpha)
+    float draw_x(float alpha) const { return prev_x + (x - prev_x) * alpha; }
+    float draw_y(float alpha) const { return prev_y + (y - prev_y) * alpha; }
 };
 
 #endif
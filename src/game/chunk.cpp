@@ -0,0 +1,319 @@
+#include "chunk.h"
+#include <cstdlib>
+
+// ChunkPlane
+TileId ChunkPlane::get(int x, int y) const {
+    int i = y * CHUNK_SIZE + x;
+    switch (mode) {
+    case Storage::DENSE:
+        return dense[i];
+    case Storage::SPARSE: {
+        auto it = std::lower_bound(sparse.begin(), sparse.end(), i, [](const SparseCell& c, int idx) { return c.index < idx; });
+        return (it != sparse.end() && it->index == i) ? it->tile : fill;
+    }
+    default:
+        return fill;
+    }
+}
+
+void ChunkPlane::set(int x, int y, TileId id) {
+    uint16_t i = static_cast<uint16_t>(y * CHUNK_SIZE + x);
+    if (mode == Storage::DENSE) {
+        dense[i] = id;
+        return;
+    }
+    auto it = std::lower_bound(sparse.begin(), sparse.end(), i, [](const SparseCell& c, int idx) { return c.index < idx; });
+    bool listed = it != sparse.end() && it->index == i;
+    if (id == fill) {
+        if (listed) sparse.erase(it);
+    } else if (listed) {
+        it->tile = id;
+    } else {
+        sparse.insert(it, {i, id});
+    }
+    mode = sparse.empty() ? Storage::UNIFORM : Storage::SPARSE;
+    if (sparse.size() > SPARSE_LIMIT) densify();
+}
+
+void ChunkPlane::densify() {
+    std::vector<TileId> cells(CHUNK_CELLS, fill);
+    for (const auto& c : sparse) cells[c.index] = c.tile;
+    dense = std::move(cells);
+    sparse.clear();
+    sparse.shrink_to_fit();
+    mode = Storage::DENSE;
+}
+
+void ChunkPlane::assign(const TileId* cells) {
+    dense.assign(cells, cells + CHUNK_CELLS);
+    sparse.clear();
+    mode = Storage::DENSE;
+    compact();
+}
+
+void ChunkPlane::compact() {
+    if (mode != Storage::DENSE) densify();
+
+    // Most common tile becomes the fill
+    std::unordered_map<TileId, int> counts;
+    for (TileId id : dense) ++counts[id];
+    auto best = std::max_element(counts.begin(), counts.end(), [](const auto& a, const auto& b) { return a.second < b.second; });
+    fill = best->first;
+    size_t others = CHUNK_CELLS - best->second;
+
+    if (others == 0) {
+        mode = Storage::UNIFORM;
+        dense.clear();
+        dense.shrink_to_fit();
+    } else if (others <= SPARSE_LIMIT) {
+        sparse.reserve(others);
+        for (int i = 0; i < CHUNK_CELLS; ++i) {
+            if (dense[i] != fill) sparse.push_back({static_cast<uint16_t>(i), dense[i]});
+        }
+        mode = Storage::SPARSE;
+        dense.clear();
+        dense.shrink_to_fit();
+    }
+}
+
+// Chunk
+void Chunk::add_wetness(int layer, int x, int y, int amount, int cap) {
+    auto& plane = wetness[layer];
+    if (plane.empty()) plane.assign(CHUNK_CELLS, 0);
+    int v = plane[y * CHUNK_SIZE + x] + amount;
+    plane[y * CHUNK_SIZE + x] = static_cast<uint8_t>(std::clamp(v, 0, cap));
+}
+
+void Chunk::set_fuel(int layer, int x, int y, uint8_t amount) {
+    auto& plane = fuel[layer];
+    if (plane.empty()) plane.assign(CHUNK_CELLS, FUEL_UNTOUCHED);
+    plane[y * CHUNK_SIZE + x] = amount;
+}
+
+size_t Chunk::memory_bytes() const {
+    size_t bytes = sizeof(Chunk) + (elev.capacity() + moist.capacity()) * sizeof(float);
+    for (const auto& layer : layers) {
+        for (const auto& plane : layer.planes) bytes += plane.memory_bytes();
+    }
+    for (const auto& w : wetness) bytes += w.capacity();
+    for (const auto& f : fuel) bytes += f.capacity();
+    return bytes;
+}
+
+// ChunkCache
+ChunkCache::ChunkCache(size_t capacity) : capacity(capacity) {}
+
+ChunkCache::~ChunkCache() {
+    stop_worker();
+}
+
+void ChunkCache::set_source(std::unique_ptr<ChunkSource> new_source) {
+    stop_worker();
+    resident.clear();
+    drop_changes();
+    keep.clear();
+    requests.clear();
+    pending.clear();
+    loaded.clear();
+    to_store.clear();
+
+    source = std::move(new_source);
+    map_w = source ? source->width() : 0;
+    map_h = source ? source->height() : 0;
+    if (source) start_worker();
+}
+
+void ChunkCache::start_worker() {
+    stopping = false;
+    worker = std::thread(&ChunkCache::worker_loop, this);
+}
+
+void ChunkCache::stop_worker() {
+    if (!worker.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    work_cv.notify_all();
+    worker.join();
+
+    // Flush dirty chunks so edits survive a source swap or shutdown
+    for (auto& entry : resident) {
+        if (entry.second->dirty) to_store.push_back(std::move(entry.second));
+    }
+    resident.clear();
+    for (auto& chunk : to_store) source->store(*chunk);
+    to_store.clear();
+}
+
+void ChunkCache::worker_loop() {
+    while (true) {
+        std::vector<std::unique_ptr<Chunk>> stores;
+        ChunkCoord coord;
+        bool have_request = false;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            work_cv.wait(lock, [this] { return stopping || !requests.empty() || !to_store.empty(); });
+            if (stopping) return;
+            stores.swap(to_store);
+            if (!requests.empty()) {
+                coord = requests.front();
+                requests.pop_front();
+                have_request = true;
+            }
+        }
+
+        for (auto& chunk : stores) source->store(*chunk);
+        if (!have_request) continue;
+
+        auto chunk = std::make_unique<Chunk>();
+        chunk->coord = coord;
+        bool ok = source->load(coord, *chunk);
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (ok) loaded.push_back(std::move(chunk));
+            else pending.erase(coord.key());
+        }
+        done_cv.notify_all();
+    }
+}
+
+std::vector<ChunkCoord> ChunkCache::window(int x, int y, int radius) const {
+    ChunkCoord center = ChunkCoord::of_tile(x, y);
+    int max_cx = (map_w + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    int max_cy = (map_h + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    std::vector<ChunkCoord> coords;
+    for (int dy = -radius; dy <= radius; ++dy) {
+        for (int dx = -radius; dx <= radius; ++dx) {
+            ChunkCoord c = {center.cx + dx, center.cy + dy};
+            if (c.cx >= 0 && c.cx < max_cx && c.cy >= 0 && c.cy < max_cy) coords.push_back(c);
+        }
+    }
+    std::sort(coords.begin(), coords.end(), [center](const ChunkCoord& a, const ChunkCoord& b) {
+        return std::max(std::abs(a.cx - center.cx), std::abs(a.cy - center.cy)) < std::max(std::abs(b.cx - center.cx), std::abs(b.cy - center.cy));
+    });
+    return coords;
+}
+
+void ChunkCache::integrate(std::vector<std::unique_ptr<Chunk>>& chunks) {
+    for (auto& chunk : chunks) {
+        chunk->last_used = frame;
+        record({-1, chunk->origin_x(), chunk->origin_y()});
+        resident[chunk->coord.key()] = std::move(chunk);
+    }
+    chunks.clear();
+}
+
+void ChunkCache::evict() {
+    while (resident.size() > capacity) {
+        auto lru = resident.end();
+        for (auto it = resident.begin(); it != resident.end(); ++it) {
+            if (keep.count(it->first)) continue;
+            if (lru == resident.end() || it->second->last_used < lru->second->last_used) lru = it;
+        }
+        if (lru == resident.end()) return;  // Everything resident is in the focus window
+        record({-1, lru->second->origin_x(), lru->second->origin_y()});
+        if (lru->second->dirty) to_store.push_back(std::move(lru->second));
+        resident.erase(lru);
+    }
+}
+
+void ChunkCache::update(int x, int y, int radius) {
+    if (!source) return;
+    ++frame;
+
+    // The paging thread only holds the lock to move queue entries; if it's busy, try next frame
+    std::unique_lock<std::mutex> lock(mtx, std::try_to_lock);
+    if (!lock.owns_lock()) return;
+
+    for (auto& chunk : loaded) pending.erase(chunk->coord.key());
+    integrate(loaded);
+
+    keep.clear();
+    std::deque<ChunkCoord> wanted;
+    for (const auto& c : window(x, y, radius)) {
+        uint64_t key = c.key();
+        keep.insert(key);
+        auto it = resident.find(key);
+        if (it != resident.end()) {
+            it->second->last_used = frame;
+        } else {
+            wanted.push_back(c);
+        }
+    }
+
+    // Requests the player has moved away from are dropped before they're loaded
+    for (const auto& c : requests) pending.erase(c.key());
+    requests.clear();
+    for (const auto& c : wanted) {
+        if (pending.insert(c.key()).second) requests.push_back(c);
+    }
+
+    evict();
+    bool has_work = !requests.empty() || !to_store.empty();
+    lock.unlock();
+    if (has_work) work_cv.notify_one();
+}
+
+void ChunkCache::warm(int x, int y, int radius) {
+    if (!source) return;
+    std::unique_lock<std::mutex> lock(mtx);
+    auto coords = window(x, y, radius);
+    for (const auto& c : coords) {
+        if (!resident.count(c.key()) && pending.insert(c.key()).second) requests.push_back(c);
+    }
+    work_cv.notify_one();
+    done_cv.wait(lock, [&] {
+        for (const auto& c : coords) {
+            if (pending.count(c.key()) && std::none_of(loaded.begin(), loaded.end(), [&](const auto& l) { return l->coord == c; })) return false;
+        }
+        return true;
+    });
+    for (auto& chunk : loaded) pending.erase(chunk->coord.key());
+    integrate(loaded);
+}
+
+Chunk* ChunkCache::find(ChunkCoord coord) {
+    auto it = resident.find(coord.key());
+    return it != resident.end() ? it->second.get() : nullptr;
+}
+
+const Chunk* ChunkCache::find(ChunkCoord coord) const {
+    auto it = resident.find(coord.key());
+    return it != resident.end() ? it->second.get() : nullptr;
+}
+
+TileId ChunkCache::get(int layer, int x, int y, int h) const {
+    const Chunk* chunk = find(ChunkCoord::of_tile(x, y));
+    if (!chunk) return EMPTY_TILE;
+    return chunk->layers[layer].get(x - chunk->origin_x(), y - chunk->origin_y(), h);
+}
+
+bool ChunkCache::set(int layer, int x, int y, int h, TileId id) {
+    Chunk* chunk = find(ChunkCoord::of_tile(x, y));
+    if (!chunk) return false;
+    chunk->layers[layer].set(x - chunk->origin_x(), y - chunk->origin_y(), h, id);
+    chunk->dirty = true;
+    record({layer, x, y});
+    return true;
+}
+
+void ChunkCache::record(Change change) {
+    if (changes.size() >= MAX_CHANGES) {  // Keep the newer half; only readers further behind lose track
+        size_t drop = changes.size() / 2;
+        changes.erase(changes.begin(), changes.begin() + drop);
+        change_base += drop;
+    }
+    changes.push_back(change);
+}
+
+void ChunkCache::drop_changes() {
+    change_base += changes.size() + 1;  // Skip one revision so a reader exactly at the end still falls behind
+    changes.clear();
+}
+
+size_t ChunkCache::memory_bytes() const {
+    size_t bytes = 0;
+    for (const auto& entry : resident) bytes += entry.second->memory_bytes();
+    return bytes;
+}
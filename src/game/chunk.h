@@ -0,0 +1,211 @@
+#ifndef CHUNK_H
+#define CHUNK_H
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "tiles.h"  // TileId
+
+static constexpr int CHUNK_SIZE = 32;
+static constexpr int CHUNK_LAYERS = 6;  // World::NUM_MAP_LAYERS
+static constexpr int CHUNK_HEIGHTS = 3;  // World::MAX_HEIGHT_LEVELS
+static constexpr int CHUNK_CELLS = CHUNK_SIZE * CHUNK_SIZE;
+
+struct ChunkCoord {
+    int cx = 0, cy = 0;
+    bool operator==(const ChunkCoord& o) const { return cx == o.cx && cy == o.cy; }
+    uint64_t key() const { return (static_cast<uint64_t>(static_cast<uint32_t>(cx)) << 32) | static_cast<uint32_t>(cy); }
+    static ChunkCoord of_tile(int x, int y) { return {floor_div(x), floor_div(y)}; }
+    static int floor_div(int v) { return v >= 0 ? v / CHUNK_SIZE : (v - CHUNK_SIZE + 1) / CHUNK_SIZE; }
+};
+
+// One height level of one map layer of a chunk. Planes holding a single tile
+// store only that tile, planes with few other cells store a sorted (cell, tile)
+// list, the rest are dense.
+class ChunkPlane {
+public:
+    enum class Storage : uint8_t { UNIFORM, SPARSE, DENSE };
+
+    TileId get(int x, int y) const;
+    void set(int x, int y, TileId id);
+    void assign(const TileId* cells);  // CHUNK_CELLS entries in row order, compacted on the way in
+    void compact();  // Pick the smallest storage for the current contents
+
+    // Visits (x, y, tile) for every non-empty cell, in row order
+    template <typename Fn> void for_each(Fn&& fn) const;
+
+    Storage storage() const { return mode; }
+    TileId fill_tile() const { return fill; }
+    size_t memory_bytes() const { return sparse.capacity() * sizeof(SparseCell) + dense.capacity() * sizeof(TileId); }
+
+private:
+    struct SparseCell {
+        uint16_t index;  // y * CHUNK_SIZE + x
+        TileId tile;
+    };
+    static constexpr size_t SPARSE_LIMIT = CHUNK_CELLS / 8;
+    void densify();
+
+    Storage mode = Storage::UNIFORM;
+    TileId fill = EMPTY_TILE;
+    std::vector<SparseCell> sparse;  // Sorted by index; cells not listed hold fill
+    std::vector<TileId> dense;
+};
+
+struct ChunkLayer {
+    std::array<ChunkPlane, CHUNK_HEIGHTS> planes;
+
+    TileId get(int x, int y, int h) const { return planes[h].get(x, y); }
+    void set(int x, int y, int h, TileId id) { planes[h].set(x, y, id); }
+    template <typename Fn> void for_each(int h, Fn&& fn) const { planes[h].for_each(fn); }
+};
+
+struct Chunk {
+    ChunkCoord coord;
+    std::array<ChunkLayer, CHUNK_LAYERS> layers;
+    std::array<std::vector<uint8_t>, CHUNK_LAYERS> wetness;  // Per cell, allocated on first wetting
+    std::array<std::vector<uint8_t>, CHUNK_LAYERS> fuel;  // Per cell fire fuel, allocated on first ignition
+    std::vector<float> elev, moist;  // Biome planes, empty when the map has none
+    bool dirty = false;  // Tiles or fuel modified since load; written back on eviction, wetness with them
+    uint64_t last_used = 0;
+
+    int origin_x() const { return coord.cx * CHUNK_SIZE; }
+    int origin_y() const { return coord.cy * CHUNK_SIZE; }
+    int get_wetness(int layer, int x, int y) const { return wetness[layer].empty() ? 0 : wetness[layer][y * CHUNK_SIZE + x]; }
+    void add_wetness(int layer, int x, int y, int amount, int cap);
+    static constexpr uint8_t FUEL_UNTOUCHED = 255;  // Never burnt; fuel comes from the tile
+    uint8_t get_fuel(int layer, int x, int y) const { return fuel[layer].empty() ? FUEL_UNTOUCHED : fuel[layer][y * CHUNK_SIZE + x]; }
+    void set_fuel(int layer, int x, int y, uint8_t amount);
+    size_t memory_bytes() const;
+};
+
+// Supplies chunk contents. Only ever called from the paging thread.
+class ChunkSource {
+public:
+    virtual ~ChunkSource() = default;
+    virtual int width() const = 0;  // Map size in tiles
+    virtual int height() const = 0;
+    virtual bool load(ChunkCoord coord, Chunk& out) = 0;
+    virtual void store(const Chunk& chunk) {}  // Write back a dirty chunk on eviction
+};
+
+// LRU cache of resident chunks around a focus point. Neighbouring chunks are
+// loaded on a background thread; the main thread only swaps finished chunks in.
+class ChunkCache {
+public:
+    explicit ChunkCache(size_t capacity = 64);
+    ~ChunkCache();
+
+    void set_source(std::unique_ptr<ChunkSource> source);  // Drops all resident chunks
+    int width() const { return map_w; }
+    int height() const { return map_h; }
+    bool in_bounds(int x, int y) const { return x >= 0 && x < map_w && y >= 0 && y < map_h; }
+
+    // Per frame: integrate finished loads, request missing chunks around (x, y), evict LRU. Never blocks.
+    void update(int x, int y, int radius);
+    // Blocking load of the chunks around (x, y); for startup and teleports only
+    void warm(int x, int y, int radius);
+
+    Chunk* find(ChunkCoord coord);
+    const Chunk* find(ChunkCoord coord) const;
+    TileId get(int layer, int x, int y, int h) const;
+    bool set(int layer, int x, int y, int h, TileId id);  // False if the chunk isn't resident
+
+    template <typename Fn> void for_each_resident(Fn&& fn) const {
+        for (const auto& entry : resident) fn(*entry.second);
+    }
+    template <typename Fn> void for_each_resident(Fn&& fn) {
+        for (auto& entry : resident) fn(*entry.second);
+    }
+
+    size_t resident_count() const { return resident.size(); }
+    size_t memory_bytes() const;
+
+    // Log of what changed, for caches of drawn tiles. A chunk paging in or out
+    // counts as a change to every cell of it.
+    struct Change {
+        int layer;  // -1 = the whole chunk at (x, y), every layer
+        int x, y;
+    };
+    uint64_t revision() const { return change_base + changes.size(); }
+    // Visits the changes after revision `since`; false if some were dropped and everything must count as changed
+    template <typename Fn> bool changes_since(uint64_t since, Fn&& fn) const {
+        if (since < change_base) return false;
+        for (size_t i = since - change_base; i < changes.size(); ++i) fn(changes[i]);
+        return true;
+    }
+
+private:
+    void start_worker();
+    void stop_worker();
+    void worker_loop();
+    void integrate(std::vector<std::unique_ptr<Chunk>>& chunks);
+    void evict();
+    std::vector<ChunkCoord> window(int x, int y, int radius) const;  // Nearest first
+    void record(Change change);
+    void drop_changes();  // Every reader sees everything as changed, e.g. on a new map
+
+    size_t capacity;
+    uint64_t frame = 0;
+    int map_w = 0, map_h = 0;
+    std::unordered_map<uint64_t, std::unique_ptr<Chunk>> resident;
+    std::unordered_set<uint64_t> keep;  // Current focus window, never evicted
+    static constexpr size_t MAX_CHANGES = 4096;
+    std::vector<Change> changes;
+    uint64_t change_base = 0;  // Revision of changes[0]
+
+    // Shared with the paging thread, guarded by mtx
+    std::unique_ptr<ChunkSource> source;
+    std::thread worker;
+    std::mutex mtx;
+    std::condition_variable work_cv, done_cv;
+    std::deque<ChunkCoord> requests;
+    std::unordered_set<uint64_t> pending;  // Requested or loading
+    std::vector<std::unique_ptr<Chunk>> loaded;
+    std::vector<std::unique_ptr<Chunk>> to_store;
+    bool stopping = false;
+};
+
+template <typename Fn> void ChunkPlane::for_each(Fn&& fn) const {
+    switch (mode) {
+    case Storage::UNIFORM:
+        if (fill == EMPTY_TILE) return;
+        for (int y = 0; y < CHUNK_SIZE; ++y)
+            for (int x = 0; x < CHUNK_SIZE; ++x) fn(x, y, fill);
+        break;
+    case Storage::SPARSE:
+        if (fill == EMPTY_TILE) {
+            // Only the listed cells can be non-empty
+            for (const auto& c : sparse) {
+                if (c.tile != EMPTY_TILE) fn(c.index % CHUNK_SIZE, c.index / CHUNK_SIZE, c.tile);
+            }
+        } else {
+            auto it = sparse.begin();
+            for (int i = 0; i < CHUNK_CELLS; ++i) {
+                TileId id = fill;
+                if (it != sparse.end() && it->index == i) id = (it++)->tile;
+                if (id != EMPTY_TILE) fn(i % CHUNK_SIZE, i / CHUNK_SIZE, id);
+            }
+        }
+        break;
+    case Storage::DENSE:
+        for (int y = 0; y < CHUNK_SIZE; ++y) {
+            const TileId* row = dense.data() + y * CHUNK_SIZE;
+            for (int x = 0; x < CHUNK_SIZE; ++x) {
+                if (row[x] != EMPTY_TILE) fn(x, y, row[x]);
+            }
+        }
+        break;
+    }
+}
+
+#endif
@@ -0,0 +1,154 @@
+#include "fire.h"
+#include "../engine/utils/hash.h"
+#include <algorithm>
+#include <array>
+
+bool FireSystem::ignite(int layer, int x, int y, std::mt19937& rng) {
+    float chance = catch_chance(layer, x, y);
+    if (chance <= 0.0f || std::uniform_real_distribution<float>(0, 1)(rng) >= chance) return false;
+    start(layer, x, y);
+    return true;
+}
+
+void FireSystem::extinguish(int layer, int x, int y) {
+    auto it = index.find(cell_key(layer, x, y));
+    if (it != index.end()) remove_at(it->second);
+}
+
+void FireSystem::clear() {
+    burning.clear();
+    index.clear();
+    clusters.clear();
+    dying.clear();
+}
+
+float FireSystem::dryness(const Chunk& chunk, int layer, int lx, int ly, const TileHot& hot) const {
+    if (hot.wetness_threshold <= 0) return 1.0f;
+    return std::clamp(1.0f - chunk.get_wetness(layer, lx, ly) / static_cast<float>(hot.wetness_threshold), 0.0f, 1.0f);
+}
+
+float FireSystem::catch_chance(int layer, int x, int y) const {
+    if (layer < 0 || layer >= CHUNK_LAYERS || !chunks.in_bounds(x, y) || is_burning(layer, x, y)) return 0.0f;
+    const Chunk* chunk = chunks.find(ChunkCoord::of_tile(x, y));
+    if (!chunk) return 0.0f;
+    int lx = x - chunk->origin_x(), ly = y - chunk->origin_y();
+    const TileHot& hot = tileset.hot_data(chunk->layers[layer].get(lx, ly, 0));
+    if (hot.flammability <= 0 || chunk->get_fuel(layer, lx, ly) == 0) return 0.0f;  // Not flammable, or already burnt out
+    return std::min(hot.flammability, int16_t(100)) / 100.0f * dryness(*chunk, layer, lx, ly, hot);
+}
+
+void FireSystem::start(int layer, int x, int y) {
+    Chunk* chunk = chunks.find(ChunkCoord::of_tile(x, y));
+    int lx = x - chunk->origin_x(), ly = y - chunk->origin_y();
+    if (chunk->get_fuel(layer, lx, ly) == Chunk::FUEL_UNTOUCHED) {
+        const TileHot& hot = tileset.hot_data(chunk->layers[layer].get(lx, ly, 0));
+        chunk->set_fuel(layer, lx, ly, static_cast<uint8_t>(std::clamp<int>(hot.flammability, 1, Chunk::FUEL_UNTOUCHED - 1)));
+        chunk->dirty = true;
+    }
+    index[cell_key(layer, x, y)] = burning.size();
+    burning.push_back({layer, x, y, 0.0f});
+
+    auto it = clusters.find(cluster_key(layer, x, y));
+    if (it == clusters.end()) it = clusters.emplace(cluster_key(layer, x, y), Cluster{0, 0, 0, FireEmitter(particles, grid_to_world(x, y), 1)}).first;
+    Cluster& cluster = it->second;
+    ++cluster.count;
+    cluster.sum_x += x;
+    cluster.sum_y += y;
+}
+
+void FireSystem::remove_at(size_t i) {
+    Cell cell = burning[i];
+    index.erase(cell_key(cell.layer, cell.x, cell.y));
+    if (i != burning.size() - 1) {
+        burning[i] = burning.back();
+        index[cell_key(burning[i].layer, burning[i].x, burning[i].y)] = i;
+    }
+    burning.pop_back();
+
+    auto it = clusters.find(cluster_key(cell.layer, cell.x, cell.y));
+    if (it == clusters.end()) return;
+    Cluster& cluster = it->second;
+    cluster.sum_x -= cell.x;
+    cluster.sum_y -= cell.y;
+    if (--cluster.count == 0) {
+        cluster.emitter.stop();
+        dying.push_back(std::move(cluster.emitter));
+        clusters.erase(it);
+    }
+}
+
+static constexpr std::array<std::pair<int, int>, 4> dirs = {{{0,1},{1,0},{0,-1},{-1,0}}};
+
+void FireSystem::scan(size_t begin, size_t end, float dt, uint32_t seed) {
+    for (size_t i = begin; i < end; ++i) {
+        Cell& cell = burning[i];
+        Outcome& out = outcomes[i];
+        out = {};
+        const Chunk* chunk = chunks.find(ChunkCoord::of_tile(cell.x, cell.y));
+        if (!chunk) continue;  // Paged out; the fire stops at the edge of the resident map
+        int lx = cell.x - chunk->origin_x(), ly = cell.y - chunk->origin_y();
+        const TileHot& hot = tileset.hot_data(chunk->layers[cell.layer].get(lx, ly, 0));
+        if (hot.flammability <= 0 || dryness(*chunk, cell.layer, lx, ly, hot) <= 0.0f) continue;  // Tile replaced, or rained out
+
+        cell.burn += BURN_RATE * dt;
+        int whole = static_cast<int>(cell.burn);
+        cell.burn -= whole;
+        out.fuel = std::max(0, chunk->get_fuel(cell.layer, lx, ly) - whole);
+        out.write = whole > 0;
+
+        for (int d = 0; d < 4; ++d) {
+            float chance = catch_chance(cell.layer, cell.x + dirs[d].first, cell.y + dirs[d].second);
+            if (chance > 0.0f && hash01(seed, cell.x, cell.y, cell.layer * 4 + d) < SPREAD_RATE * dt * chance) out.spread |= 1 << d;
+        }
+    }
+}
+
+void FireSystem::apply() {
+    size_t n = outcomes.size();
+    for (size_t i = 0; i < n; ++i) {
+        if (!outcomes[i].write) continue;
+        const Cell& cell = burning[i];
+        Chunk* chunk = chunks.find(ChunkCoord::of_tile(cell.x, cell.y));
+        chunk->set_fuel(cell.layer, cell.x - chunk->origin_x(), cell.y - chunk->origin_y(), static_cast<uint8_t>(outcomes[i].fuel));
+        chunk->dirty = true;
+    }
+
+    // New cells go on the end and first burn next tick; a cell reached from two sides starts once
+    for (size_t i = 0; i < n; ++i) {
+        for (int d = 0; d < 4; ++d) {
+            if (!(outcomes[i].spread & (1 << d))) continue;
+            int nx = burning[i].x + dirs[d].first, ny = burning[i].y + dirs[d].second;
+            if (catch_chance(burning[i].layer, nx, ny) > 0.0f) start(burning[i].layer, nx, ny);
+        }
+    }
+
+    // Backwards, so swap-and-pop only ever moves in cells that are staying
+    for (size_t i = n; i-- > 0;) {
+        if (outcomes[i].fuel <= 0) remove_at(i);
+    }
+    outcomes.clear();
+}
+
+JobGraph::JobId FireSystem::schedule(JobGraph& graph, float dt, uint32_t seed, const std::vector<JobGraph::JobId>& deps) {
+    outcomes.resize(burning.size());
+    JobGraph::JobId scanned = graph.parallel_for(burning.size(), 256, [this, dt, seed](size_t begin, size_t end) { scan(begin, end, dt, seed); }, deps);
+    return graph.add([this] { apply(); }, {scanned});
+}
+
+void FireSystem::tick(float dt, uint32_t seed) {
+    outcomes.resize(burning.size());
+    scan(0, burning.size(), dt, seed);
+    apply();
+}
+
+void FireSystem::update_emitters(float dt) {
+    for (auto& entry : clusters) {
+        Cluster& cluster = entry.second;
+        cluster.emitter.set_origin(grid_to_world(static_cast<float>(cluster.sum_x) / cluster.count, static_cast<float>(cluster.sum_y) / cluster.count));
+        cluster.emitter.set_intensity(1 + cluster.count / CLUSTER_SIZE);
+        cluster.emitter.update(dt);
+    }
+    for (auto& emitter : dying) emitter.update(dt);
+    particles.step(ParticleKind::FIRE);
+    dying.erase(std::remove_if(dying.begin(), dying.end(), [](const FireEmitter& e) { return e.finished(); }), dying.end());
+}
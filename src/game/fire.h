@@ -0,0 +1,93 @@
+#ifndef FIRE_H
+#define FIRE_H
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <unordered_map>
+#include <vector>
+#include "chunk.h"
+#include "tiles.h"
+#include "../engine/jobs.h"
+#include "../engine/particles.h"
+
+// Cellular-automaton fire. Only burning cells are visited each tick, so the
+// cost follows the size of the fire rather than the size of the map. Fuel left
+// in a cell lives in its chunk (Chunk::fuel); a cell at 0 fuel has burnt out.
+class FireSystem {
+public:
+    static constexpr int CLUSTER_SIZE = 4;  // Burning cells in one CLUSTER_SIZE^2 block share an emitter
+    static constexpr float BURN_RATE = 20.0f;  // Fuel per second
+    static constexpr float SPREAD_RATE = 0.6f;  // Per neighbour per second, for a fully flammable dry tile
+
+    FireSystem(ChunkCache& chunks, const Tiles& tileset, ParticleStore& particles) : chunks(chunks), tileset(tileset), particles(particles) {}
+
+    bool ignite(int layer, int x, int y, std::mt19937& rng);  // Rolls against flammability and wetness
+    void extinguish(int layer, int x, int y);  // Leftover fuel stays, the cell can catch again
+    void clear();  // Drop all fires, e.g. when the map is replaced
+
+    // Burn, spread, put out wet cells. Cells are scanned in parallel slices and
+    // every change is applied afterwards in frontier order, so the outcome for a
+    // given seed doesn't depend on the thread count.
+    JobGraph::JobId schedule(JobGraph& graph, float dt, uint32_t seed, const std::vector<JobGraph::JobId>& deps = {});
+    void tick(float dt, uint32_t seed);  // The same on the calling thread
+    void update_emitters(float dt);  // Also steps the fire particles, then drops burnt-out emitters
+
+    bool is_burning(int layer, int x, int y) const { return index.count(cell_key(layer, x, y)) != 0; }
+    size_t burning_count() const { return burning.size(); }
+    template <typename Fn> void for_each_emitter(Fn&& fn) {
+        for (auto& entry : clusters) fn(entry.second.emitter);
+        for (auto& emitter : dying) fn(emitter);
+    }
+    template <typename Fn> void for_each_emitter(Fn&& fn) const {
+        for (const auto& entry : clusters) fn(entry.second.emitter);
+        for (const auto& emitter : dying) fn(emitter);
+    }
+
+    // Visits (key, layer, x, y, burning cells) per cluster; x, y is the cell nearest its centre
+    template <typename Fn> void for_each_cluster(Fn&& fn) const {
+        for (const auto& [key, cluster] : clusters) {
+            int x = static_cast<int>(std::lround(static_cast<float>(cluster.sum_x) / cluster.count));
+            int y = static_cast<int>(std::lround(static_cast<float>(cluster.sum_y) / cluster.count));
+            fn(key, static_cast<int>(key >> 48), x, y, cluster.count);
+        }
+    }
+
+private:
+    struct Cell {
+        int layer, x, y;
+        float burn;  // Fuel burnt since the last whole unit came off
+    };
+    struct Outcome {
+        int fuel = 0;  // Left after this tick; <= 0 and the cell goes out
+        bool write = false;  // Fuel changed
+        uint8_t spread = 0;  // Bit per neighbour that caught
+    };
+    struct Cluster {
+        int count = 0;
+        int sum_x = 0, sum_y = 0;
+        FireEmitter emitter;
+    };
+
+    static uint64_t cell_key(int layer, int x, int y) {
+        return (static_cast<uint64_t>(layer) << 48) | (static_cast<uint64_t>(y & 0xFFFFFF) << 24) | static_cast<uint64_t>(x & 0xFFFFFF);
+    }
+    static uint64_t cluster_key(int layer, int x, int y) { return cell_key(layer, x / CLUSTER_SIZE, y / CLUSTER_SIZE); }
+    float dryness(const Chunk& chunk, int layer, int lx, int ly, const TileHot& hot) const;  // 1 dry .. 0 at the wetness threshold
+    float catch_chance(int layer, int x, int y) const;  // Flammability times dryness; 0 if it can't burn
+    void start(int layer, int x, int y);
+    void remove_at(size_t i);
+    void scan(size_t begin, size_t end, float dt, uint32_t seed);  // Reads the map, writes only outcomes and Cell::burn
+    void apply();
+
+    ChunkCache& chunks;
+    const Tiles& tileset;
+    ParticleStore& particles;
+    std::vector<Cell> burning;  // Active frontier, unordered
+    std::vector<Outcome> outcomes;  // Parallel to burning during a tick
+    std::unordered_map<uint64_t, size_t> index;  // cell_key -> position in burning
+    std::unordered_map<uint64_t, Cluster> clusters;
+    std::vector<FireEmitter> dying;  // Burnt-out clusters whose particles are still in flight
+};
+
+#endif
@@ -0,0 +1,293 @@
+#include "lightmap.h"
+#include "fire.h"
+#include <algorithm>
+#include <cmath>
+
+LightId LightMap::add(int layer, int x, int y, const LightSource& light) {
+    LightId id;
+    if (!free_ids.empty()) {
+        id = free_ids.back();
+        free_ids.pop_back();
+    } else {
+        id = static_cast<LightId>(sources.size());
+        sources.emplace_back();
+    }
+    Source& s = sources[id];
+    s = Source();
+    s.layer = layer;
+    s.x = x;
+    s.y = y;
+    s.light = light;
+    s.live = true;
+    s.dirty = true;  // Lands in the map at the next update()
+    return id;
+}
+
+void LightMap::move(LightId id, int x, int y) {
+    if (id >= sources.size() || !sources[id].live) return;
+    Source& s = sources[id];
+    if (s.x == x && s.y == y) return;
+    s.x = x;
+    s.y = y;
+    s.dirty = true;
+}
+
+void LightMap::remove(LightId id) {
+    if (id >= sources.size() || !sources[id].live) return;
+    Source& s = sources[id];
+    if (s.applied_r >= 0) apply(s, -1.0f);
+    s = Source();
+    free_ids.push_back(id);
+}
+
+void LightMap::set_ambient(const std::array<float, 3>& rgb) {
+    ambient_rgb = rgb;
+}
+
+float LightMap::brightness(int layer, int x, int y) const {
+    float level = (ambient_rgb[0] + ambient_rgb[1] + ambient_rgb[2]) / 3.0f;
+    ChunkCoord coord = ChunkCoord::of_tile(x, y);
+    auto it = lit.find(coord.key());
+    if (it == lit.end() || it->second.planes[layer].empty()) return level;
+    int cell = (y - coord.cy * CHUNK_SIZE) * CHUNK_SIZE + (x - coord.cx * CHUNK_SIZE);
+    return level + std::max(0.0f, it->second.planes[layer][cell]);
+}
+
+std::array<float, 3> LightMap::color_at(int layer, int x, int y) const {
+    std::array<float, 3> rgb = ambient_rgb;
+    ChunkCoord coord = ChunkCoord::of_tile(x, y);
+    auto it = lit.find(coord.key());
+    if (it == lit.end() || it->second.planes[layer].empty()) return rgb;
+    int cell = (y - coord.cy * CHUNK_SIZE) * CHUNK_SIZE + (x - coord.cx * CHUNK_SIZE);
+    for (int c = 0; c < 3; ++c) rgb[c] += std::max(0.0f, it->second.planes[layer][(c + 1) * CHUNK_CELLS + cell]);
+    return rgb;
+}
+
+bool LightMap::layer_lit(int layer) const {
+    for (const auto& s : sources) {
+        if (s.live && s.applied_r >= 0 && s.applied_layer == layer) return true;
+    }
+    return false;
+}
+
+bool LightMap::opaque(int layer, int x, int y) const {
+    const Chunk* chunk = chunks.find(ChunkCoord::of_tile(x, y));
+    if (!chunk) return false;  // Not paged in; recomputed when it is
+    int lx = x - chunk->origin_x(), ly = y - chunk->origin_y();
+    for (int h = 0; h < CHUNK_HEIGHTS; ++h) {
+        if (tileset.hot_data(chunk->layers[layer].get(lx, ly, h)).blocks_sight(h)) return true;
+    }
+    return false;
+}
+
+// Rays from the centre to every cell on the square's rim, each stopping after
+// the first opaque cell it lights; then linear falloff to zero at r + 1
+void LightMap::compute(Source& s) {
+    int r = radius_of(s.light), n = 2 * r + 1;
+    s.weights.assign(static_cast<size_t>(n) * n, 0.0f);
+    patch.resize(static_cast<size_t>(n) * n);
+    for (int dy = -r; dy <= r; ++dy) {
+        for (int dx = -r; dx <= r; ++dx) patch[(dy + r) * n + dx + r] = opaque(s.layer, s.x + dx, s.y + dy);
+    }
+
+    auto cast = [&](int tx, int ty) {
+        int adx = std::abs(tx), ady = std::abs(ty), sx = tx < 0 ? -1 : 1, sy = ty < 0 ? -1 : 1;
+        int x = 0, y = 0, err = adx - ady;
+        while (x != tx || y != ty) {  // Bresenham
+            int e2 = 2 * err;
+            if (e2 > -ady) { err -= ady; x += sx; }
+            if (e2 < adx) { err += adx; y += sy; }
+            float d = std::sqrt(static_cast<float>(x * x + y * y));
+            if (d > r + 0.5f) return;
+            s.weights[(y + r) * n + x + r] = std::max(0.0f, 1.0f - d / (r + 1));
+            if (patch[(y + r) * n + x + r]) return;
+        }
+    };
+    s.weights[r * n + r] = 1.0f;
+    for (int i = -r; i <= r; ++i) {
+        cast(i, -r);
+        cast(i, r);
+        cast(-r, i);
+        cast(r, i);
+    }
+}
+
+void LightMap::apply(const Source& s, float sign) {
+    int r = s.applied_r, n = 2 * r + 1;
+    const LightSource& light = s.applied_light;
+    float k = sign * light.intensity / 100.0f;
+    const float scale[PLANES] = {k, k * light.color[0] / 255.0f, k * light.color[1] / 255.0f, k * light.color[2] / 255.0f};
+    int x0 = std::max(0, s.applied_x - r), x1 = std::min(chunks.width() - 1, s.applied_x + r);
+    int y0 = std::max(0, s.applied_y - r), y1 = std::min(chunks.height() - 1, s.applied_y + r);
+    for (int y = y0; y <= y1; ++y) {
+        const float* row = &s.weights[(y - s.applied_y + r) * n + (x0 - s.applied_x + r)];
+        // One run per chunk the row crosses
+        for (int x = x0; x <= x1;) {
+            ChunkCoord coord = ChunkCoord::of_tile(x, y);
+            int run_end = std::min(x1, (coord.cx + 1) * CHUNK_SIZE - 1);
+            int len = run_end - x + 1;
+            // Taking back skips planes made after the footprint went in, e.g. the chunk paged
+            // out and in again since; mark_near has the source re-added there
+            auto it = lit.find(coord.key());
+            bool reach = chunks.find(coord) != nullptr;
+            if (sign < 0.0f) reach = reach && it != lit.end() && it->second.since <= s.applied_at && !it->second.planes[s.applied_layer].empty();
+            if (!reach) {
+                row += len;
+                x = run_end + 1;
+                continue;
+            }
+            if (it == lit.end()) it = lit.emplace(coord.key(), ChunkLight{{}, s.applied_at}).first;
+            std::vector<float>& planes = it->second.planes[s.applied_layer];
+            if (planes.empty()) planes.assign(PLANES * CHUNK_CELLS, 0.0f);
+            int cell = (y - coord.cy * CHUNK_SIZE) * CHUNK_SIZE + (x - coord.cx * CHUNK_SIZE);
+            for (int p = 0; p < PLANES; ++p) {
+                float* dst = &planes[p * CHUNK_CELLS + cell];
+                const float f = scale[p];
+                for (int i = 0; i < len; ++i) dst[i] += f * row[i];
+            }
+            row += len;
+            x = run_end + 1;
+        }
+    }
+}
+
+void LightMap::mark_near(int layer, int x0, int y0, int x1, int y1) {
+    for (auto& s : sources) {
+        if (!s.live || (layer >= 0 && s.layer != layer)) continue;
+        int r = radius_of(s.light);
+        if (s.x + r < x0 || s.x - r > x1 || s.y + r < y0 || s.y - r > y1) continue;
+        s.dirty = true;
+    }
+}
+
+void LightMap::set_tile_source(int layer, int x, int y) {
+    // The brightest tile in the cell that emits light, if any
+    const LightSource* best = nullptr;
+    for (int h = 0; h < CHUNK_HEIGHTS; ++h) {
+        TileId id = chunks.get(layer, x, y, h);
+        if (id == EMPTY_TILE || !tileset.hot_data(id).has(TILE_EMITS_LIGHT)) continue;
+        const LightSource& light = tileset.cold_data(id).emits_light;
+        if (!best || light.intensity > best->intensity) best = &light;
+    }
+
+    uint64_t key = cell_key(layer, x, y);
+    auto it = tile_sources.find(key);
+    if (!best) {
+        if (it != tile_sources.end()) {
+            remove(it->second);
+            tile_sources.erase(it);
+        }
+    } else if (it == tile_sources.end()) {
+        tile_sources[key] = add(layer, x, y, *best);
+    } else {
+        Source& s = sources[it->second];
+        if (s.light.intensity != best->intensity || s.light.radius != best->radius || s.light.color != best->color) {
+            s.light = *best;
+            s.dirty = true;
+        }
+    }
+}
+
+void LightMap::scan_tiles(const Chunk& chunk) {
+    for (int layer = 0; layer < CHUNK_LAYERS; ++layer) {
+        for (int h = 0; h < CHUNK_HEIGHTS; ++h) {
+            chunk.layers[layer].for_each(h, [&](int lx, int ly, TileId id) {
+                if (tileset.hot_data(id).has(TILE_EMITS_LIGHT)) set_tile_source(layer, chunk.origin_x() + lx, chunk.origin_y() + ly);
+            });
+        }
+    }
+}
+
+void LightMap::drop_tiles(ChunkCoord coord) {
+    for (auto it = tile_sources.begin(); it != tile_sources.end();) {
+        const Source& s = sources[it->second];
+        if (ChunkCoord::of_tile(s.x, s.y) == coord) {
+            remove(it->second);
+            it = tile_sources.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void LightMap::sync_fires(const FireSystem& fire) {
+    std::unordered_map<uint64_t, LightId> current;
+    fire.for_each_cluster([&](uint64_t key, int layer, int x, int y, int cells) {
+        LightSource light;
+        light.intensity = std::min(100, 30 + 10 * cells);
+        light.radius = std::min(MAX_RADIUS, 3 + cells / 2);
+        light.color = {255, 150, 60};
+        auto it = fire_sources.find(key);
+        if (it == fire_sources.end()) {
+            current[key] = add(layer, x, y, light);
+            return;
+        }
+        Source& s = sources[it->second];
+        move(it->second, x, y);
+        if (s.light.intensity != light.intensity || s.light.radius != light.radius) {
+            s.light = light;
+            s.dirty = true;
+        }
+        current[key] = it->second;
+        fire_sources.erase(it);
+    });
+    for (const auto& entry : fire_sources) remove(entry.second);  // Burnt out
+    fire_sources.swap(current);
+}
+
+void LightMap::update(const FireSystem& fire) {
+    updated = 0;
+    if (tile_count != tileset.size()) {  // New tileset: every footprint is suspect
+        tile_count = tileset.size();
+        scanned = false;
+    }
+
+    bool tracked = scanned && chunks.changes_since(seen_revision, [&](const ChunkCache::Change& c) {
+        if (c.layer >= 0) {  // One cell: its own light, and the shadows it casts
+            set_tile_source(c.layer, c.x, c.y);
+            mark_near(c.layer, c.x, c.y, c.x, c.y);
+            return;
+        }
+        ChunkCoord coord = ChunkCoord::of_tile(c.x, c.y);
+        if (const Chunk* chunk = chunks.find(coord)) {
+            scan_tiles(*chunk);
+        } else {
+            drop_tiles(coord);
+            lit.erase(coord.key());
+        }
+        mark_near(-1, c.x, c.y, c.x + CHUNK_SIZE - 1, c.y + CHUNK_SIZE - 1);
+    });
+    if (!tracked) {  // Start over from what's resident
+        lit.clear();
+        for (const auto& entry : tile_sources) {
+            sources[entry.second].applied_r = -1;  // lit is gone already
+            remove(entry.second);
+        }
+        tile_sources.clear();
+        for (auto& s : sources) {
+            if (!s.live) continue;
+            s.applied_r = -1;
+            s.dirty = true;
+        }
+        chunks.for_each_resident([&](const Chunk& chunk) { scan_tiles(chunk); });
+    }
+    seen_revision = chunks.revision();
+    scanned = true;
+
+    sync_fires(fire);
+
+    for (auto& s : sources) {
+        if (!s.live || !s.dirty) continue;
+        if (s.applied_r >= 0) apply(s, -1.0f);
+        compute(s);
+        s.applied_light = s.light;
+        s.applied_layer = s.layer;
+        s.applied_x = s.x;
+        s.applied_y = s.y;
+        s.applied_r = radius_of(s.light);
+        s.applied_at = ++apply_count;
+        apply(s, 1.0f);
+        s.dirty = false;
+        ++updated;
+    }
+}
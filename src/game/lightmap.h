@@ -0,0 +1,93 @@
+#ifndef LIGHTMAP_H
+#define LIGHTMAP_H
+
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "chunk.h"
+#include "tiles.h"
+
+class FireSystem;
+
+using LightId = uint32_t;
+static constexpr LightId NO_LIGHT = UINT32_MAX;
+
+// Light level of every tile, per map layer. Each source keeps the footprint it
+// last added: its raycast visibility times falloff over a (2r+1)^2 square.
+// Adding, moving or removing a source, or changing a cell under one, takes
+// that footprint back out and adds the new one, so only the square is touched.
+// Levels are in light units, 1 = fully lit; the ambient level is added on top.
+class LightMap {
+public:
+    static constexpr int MAX_RADIUS = 16;  // Tiles
+
+    LightMap(const ChunkCache& chunks, const Tiles& tileset) : chunks(chunks), tileset(tileset) {}
+
+    // Gameplay sources such as carried lanterns; tiles that emit light and fires are tracked by update()
+    LightId add(int layer, int x, int y, const LightSource& light);
+    void move(LightId id, int x, int y);
+    void remove(LightId id);
+
+    // Once a tick: follows tile changes and chunk paging from the ChunkCache log, and fire clusters
+    void update(const FireSystem& fire);
+    void set_ambient(const std::array<float, 3>& rgb);  // 0..1 per channel; daylight, tint, moonlight
+
+    float brightness(int layer, int x, int y) const;  // Ambient plus every source reaching the tile
+    std::array<float, 3> color_at(int layer, int x, int y) const;  // The same per channel, 0..1 and up
+    const std::array<float, 3>& ambient() const { return ambient_rgb; }
+    bool layer_lit(int layer) const;  // Any source adds light to the layer; if not, everything there is ambient
+    size_t source_count() const { return sources.size() - free_ids.size(); }
+    size_t footprints_updated() const { return updated; }  // Last update()
+
+private:
+    struct Source {
+        int layer = 0, x = 0, y = 0;
+        LightSource light;
+        bool live = false;
+        bool dirty = false;  // Footprint recomputed at the next update
+        // Footprint currently in the map
+        std::vector<float> weights;  // Row-major (2 * applied_r + 1)^2
+        LightSource applied_light;
+        int applied_layer = 0, applied_x = 0, applied_y = 0, applied_r = -1;
+        uint64_t applied_at = 0;  // apply_count when it went in
+    };
+    // Per resident chunk, per layer: four CHUNK_CELLS planes, level then r, g, b.
+    // Allocated the first time a source reaches it and dropped when the chunk
+    // pages out; plain float rows so the adds vectorise.
+    struct ChunkLight {
+        std::array<std::vector<float>, CHUNK_LAYERS> planes;
+        uint64_t since = 0;  // apply_count when allocated; older footprints never reached these planes
+    };
+    static constexpr int PLANES = 4;
+
+    static uint64_t cell_key(int layer, int x, int y) {
+        return (static_cast<uint64_t>(layer) << 48) | (static_cast<uint64_t>(y & 0xFFFFFF) << 24) | static_cast<uint64_t>(x & 0xFFFFFF);
+    }
+    static int radius_of(const LightSource& light) { return std::min(light.radius, MAX_RADIUS); }
+    bool opaque(int layer, int x, int y) const;  // Any level that blocks sight
+    void compute(Source& s);  // Visibility and falloff into weights
+    void apply(const Source& s, float sign);  // Add or take back the footprint, over resident chunks only
+    void mark_near(int layer, int x0, int y0, int x1, int y1);  // Sources whose square overlaps
+    void scan_tiles(const Chunk& chunk);  // Sources for tiles in the chunk that emit light
+    void drop_tiles(ChunkCoord coord);
+    void set_tile_source(int layer, int x, int y);  // After the cell changed
+    void sync_fires(const FireSystem& fire);
+
+    const ChunkCache& chunks;
+    const Tiles& tileset;
+    std::vector<Source> sources;  // Indexed by LightId
+    std::vector<LightId> free_ids;
+    std::unordered_map<uint64_t, ChunkLight> lit;  // By ChunkCoord::key
+    uint64_t apply_count = 0;
+    std::unordered_map<uint64_t, LightId> tile_sources;  // By cell_key
+    std::unordered_map<uint64_t, LightId> fire_sources;  // By fire cluster key
+    size_t tile_count = 0;  // Tileset size at the last scan; a reload rescans
+    std::vector<uint8_t> patch;  // compute() scratch: opacity around the source
+    std::array<float, 3> ambient_rgb = {1.0f, 1.0f, 1.0f};
+    uint64_t seen_revision = 0;
+    bool scanned = false;
+    size_t updated = 0;
+};
+
+#endif
@@ -0,0 +1,207 @@
+#include "map_file.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+#include <nlohmann/json.hpp>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static uint64_t align8(uint64_t v) { return (v + 7) & ~uint64_t(7); }
+
+bool read_json_map(const std::string& path, int layers, int heights, MapData& out) {
+    std::ifstream f(path);
+    if (!f.is_open()) {
+        std::cerr << "Map load error: can't open " << path << std::endl;
+        return false;
+    }
+    nlohmann::json j;
+    try {
+        f >> j;
+    } catch (const std::exception& e) {
+        std::cerr << "Map load error: " << e.what() << std::endl;
+        return false;
+    }
+
+    // map[layer][x][y] = [{height, tile}, ...]
+    out = MapData();
+    out.layers = layers;
+    out.heights = heights;
+    for (const auto& layer_entry : j["map"].items()) {
+        out.width = std::max(out.width, static_cast<int>(layer_entry.value().size()));
+        if (!layer_entry.value().empty()) out.height = std::max(out.height, static_cast<int>(layer_entry.value()[0].size()));
+    }
+    out.cells.assign(static_cast<size_t>(layers) * heights * out.width * out.height, 0);
+
+    std::unordered_map<std::string, uint16_t> index = {{"", 0}, {"empty", 0}};
+    for (const auto& layer_entry : j["map"].items()) {
+        int layer = std::stoi(layer_entry.key());
+        if (layer >= layers) continue;
+        const auto& columns = layer_entry.value();
+        for (int x = 0; x < columns.size(); ++x) {
+            for (int y = 0; y < columns[x].size(); ++y) {
+                for (const auto& h_entry : columns[x][y]) {
+                    int h = h_entry["height"];
+                    if (h < 0 || h >= heights) continue;
+                    const std::string& tile_id = h_entry["tile"].get_ref<const std::string&>();
+                    auto it = index.find(tile_id);
+                    if (it == index.end()) {
+                        it = index.emplace(tile_id, static_cast<uint16_t>(out.tile_names.size())).first;
+                        out.tile_names.push_back(tile_id);
+                    }
+                    out.cell(layer, h, x, y) = it->second;
+                }
+            }
+        }
+    }
+
+    if (j.contains("biomes") && out.width > 0 && !j["biomes"]["elev"].empty()) {
+        const auto& elev = j["biomes"]["elev"];
+        const auto& moist = j["biomes"]["moist"];
+        out.elev.resize(static_cast<size_t>(out.width) * out.height);
+        out.moist.resize(out.elev.size());
+        for (int x = 0; x < out.width; ++x) {
+            for (int y = 0; y < out.height; ++y) {
+                out.elev[static_cast<size_t>(y) * out.width + x] = elev[x][y];
+                out.moist[static_cast<size_t>(y) * out.width + x] = moist[x][y];
+            }
+        }
+    }
+    return true;
+}
+
+bool write_map_file(const std::string& path, const MapData& map) {
+    MapFileHeader hdr = {};
+    std::memcpy(hdr.magic, MAP_FILE_MAGIC, 4);
+    hdr.version = MAP_FILE_VERSION;
+    hdr.width = map.width;
+    hdr.height = map.height;
+    hdr.layers = map.layers;
+    hdr.heights = map.heights;
+    hdr.num_tiles = static_cast<uint32_t>(map.tile_names.size());
+    hdr.flags = map.elev.empty() ? 0 : MAP_FILE_HAS_BIOMES;
+
+    uint64_t strings_size = 0;
+    for (const auto& name : map.tile_names) strings_size += sizeof(uint16_t) + name.size();
+    hdr.strings_offset = sizeof(MapFileHeader);
+    hdr.cells_offset = align8(hdr.strings_offset + strings_size);
+    hdr.biomes_offset = hdr.flags & MAP_FILE_HAS_BIOMES ? align8(hdr.cells_offset + map.cells.size() * sizeof(uint16_t)) : 0;
+
+    std::ofstream f(path, std::ios::binary);
+    if (!f.is_open()) {
+        std::cerr << "Map write error: can't open " << path << std::endl;
+        return false;
+    }
+    auto pad_to = [&f](uint64_t offset) {
+        static const char zeros[8] = {};
+        f.write(zeros, offset - static_cast<uint64_t>(f.tellp()));
+    };
+
+    f.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+    for (const auto& name : map.tile_names) {
+        uint16_t len = static_cast<uint16_t>(name.size());
+        f.write(reinterpret_cast<const char*>(&len), sizeof(len));
+        f.write(name.data(), len);
+    }
+    pad_to(hdr.cells_offset);
+    f.write(reinterpret_cast<const char*>(map.cells.data()), map.cells.size() * sizeof(uint16_t));
+    if (hdr.biomes_offset) {
+        pad_to(hdr.biomes_offset);
+        f.write(reinterpret_cast<const char*>(map.elev.data()), map.elev.size() * sizeof(float));
+        f.write(reinterpret_cast<const char*>(map.moist.data()), map.moist.size() * sizeof(float));
+    }
+    return f.good();
+}
+
+bool MapFile::is_map_file(const std::string& path) {
+    std::ifstream f(path, std::ios::binary);
+    char magic[4] = {};
+    return f.read(magic, 4) && std::memcmp(magic, MAP_FILE_MAGIC, 4) == 0;
+}
+
+bool MapFile::open(const std::string& path) {
+    close();
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Map load error: can't open " << path << std::endl;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED) {
+            data = static_cast<const unsigned char*>(mapped);
+            size = st.st_size;
+        }
+    }
+    ::close(fd);
+#endif
+    if (!data) {
+        std::ifstream f(path, std::ios::binary);
+        fallback.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+        data = fallback.data();
+        size = fallback.size();
+    }
+
+    hdr = reinterpret_cast<const MapFileHeader*>(data);
+    bool valid = size >= sizeof(MapFileHeader) && std::memcmp(hdr->magic, MAP_FILE_MAGIC, 4) == 0;
+    if (valid && hdr->version != MAP_FILE_VERSION) {
+        std::cerr << "Map load error: " << path << " is version " << hdr->version << ", expected " << MAP_FILE_VERSION << std::endl;
+        valid = false;
+    }
+    if (valid) {
+        uint64_t cells_size = static_cast<uint64_t>(hdr->layers) * hdr->heights * hdr->width * hdr->height * sizeof(uint16_t);
+        uint64_t biomes_size = static_cast<uint64_t>(hdr->width) * hdr->height * sizeof(float) * 2;
+        valid = hdr->cells_offset + cells_size <= size &&
+                (!(hdr->flags & MAP_FILE_HAS_BIOMES) || hdr->biomes_offset + biomes_size <= size);
+    }
+    if (!valid) {
+        std::cerr << "Map load error: " << path << " is not a valid map file" << std::endl;
+        close();
+        return false;
+    }
+
+    // The string table is the only part that's parsed
+    const unsigned char* p = data + hdr->strings_offset;
+    names.reserve(hdr->num_tiles);
+    const unsigned char* strings_end = data + hdr->cells_offset;
+    for (uint32_t i = 0; i < hdr->num_tiles && p + sizeof(uint16_t) <= strings_end; ++i) {
+        uint16_t len;
+        std::memcpy(&len, p, sizeof(len));
+        if (p + sizeof(len) + len > strings_end) break;
+        names.emplace_back(reinterpret_cast<const char*>(p + sizeof(len)), len);
+        p += sizeof(len) + len;
+    }
+    return true;
+}
+
+void MapFile::close() {
+#ifndef _WIN32
+    if (data && fallback.empty()) munmap(const_cast<unsigned char*>(data), size);
+#endif
+    data = nullptr;
+    size = 0;
+    hdr = nullptr;
+    names.clear();
+    fallback.clear();
+}
+
+const uint16_t* MapFile::plane(int layer, int h) const {
+    size_t offset = hdr->cells_offset + (static_cast<size_t>(layer) * hdr->heights + h) * hdr->width * hdr->height * sizeof(uint16_t);
+    return reinterpret_cast<const uint16_t*>(data + offset);
+}
+
+const float* MapFile::elev() const {
+    if (!(hdr->flags & MAP_FILE_HAS_BIOMES)) return nullptr;
+    return reinterpret_cast<const float*>(data + hdr->biomes_offset);
+}
+
+const float* MapFile::moist() const {
+    if (!(hdr->flags & MAP_FILE_HAS_BIOMES)) return nullptr;
+    return reinterpret_cast<const float*>(data + hdr->biomes_offset) + static_cast<size_t>(hdr->width) * hdr->height;
+}
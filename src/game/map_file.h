@@ -0,0 +1,72 @@
+#ifndef MAP_FILE_H
+#define MAP_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Binary map (.cmap), little-endian, sections 8-byte aligned:
+//   MapFileHeader
+//   string table: num_tiles x (uint16 length, bytes); entry 0 is "" (empty)
+//   cells: [layer][height][y][x] uint16 string table indices
+//   biomes (MAP_FILE_HAS_BIOMES): elev then moist, [y][x] float32
+static constexpr char MAP_FILE_MAGIC[4] = {'C', 'M', 'A', 'P'};
+static constexpr uint32_t MAP_FILE_VERSION = 1;
+static constexpr uint32_t MAP_FILE_HAS_BIOMES = 1 << 0;
+
+struct MapFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t width, height;
+    uint32_t layers, heights;
+    uint32_t num_tiles;
+    uint32_t flags;
+    uint64_t strings_offset, cells_offset, biomes_offset;
+};
+static_assert(sizeof(MapFileHeader) == 56, "MapFileHeader layout is part of the file format");
+
+// Whole map held in memory; what the JSON loader and the converter produce
+struct MapData {
+    int width = 0, height = 0, layers = 0, heights = 0;
+    std::vector<std::string> tile_names{""};
+    std::vector<uint16_t> cells;  // [layer][height][y][x] indices into tile_names
+    std::vector<float> elev, moist;  // [y][x], empty if the map has no biomes
+
+    uint16_t& cell(int layer, int h, int x, int y) {
+        return cells[((static_cast<size_t>(layer) * heights + h) * height + y) * width + x];
+    }
+};
+
+bool read_json_map(const std::string& path, int layers, int heights, MapData& out);
+bool write_map_file(const std::string& path, const MapData& map);
+
+// Read-only memory mapping of a .cmap file. Cell and biome planes point straight into the mapping.
+class MapFile {
+public:
+    MapFile() = default;
+    ~MapFile() { close(); }
+    MapFile(const MapFile&) = delete;
+    MapFile& operator=(const MapFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+    static bool is_map_file(const std::string& path);
+
+    const MapFileHeader& header() const { return *hdr; }
+    int width() const { return hdr->width; }
+    int height() const { return hdr->height; }
+    const std::vector<std::string>& tile_names() const { return names; }
+    const uint16_t* plane(int layer, int h) const;  // width * height cells
+    const float* elev() const;  // nullptr without biomes
+    const float* moist() const;
+
+private:
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+    const MapFileHeader* hdr = nullptr;
+    std::vector<std::string> names;
+    std::vector<unsigned char> fallback;  // Whole file, where mmap isn't available
+};
+
+#endif
@@ -0,0 +1,306 @@
+#include "map_sources.h"
+#include <cmath>
+
+// ChunkEdits
+void ChunkEdits::save(const Chunk& chunk, const Chunk* pristine) {
+    Saved next;
+    if (pristine) {
+        for (int l = 0; l < CHUNK_LAYERS; ++l) {
+            for (int h = 0; h < CHUNK_HEIGHTS; ++h) {
+                const ChunkPlane& now = chunk.layers[l].planes[h];
+                const ChunkPlane& was = pristine->layers[l].planes[h];
+                for (int i = 0; i < CHUNK_CELLS; ++i) {
+                    TileId id = now.get(i % CHUNK_SIZE, i / CHUNK_SIZE);
+                    if (id != was.get(i % CHUNK_SIZE, i / CHUNK_SIZE)) {
+                        next.tiles.push_back({static_cast<uint16_t>(i), static_cast<uint8_t>(l), static_cast<uint8_t>(h), id});
+                    }
+                }
+            }
+        }
+    }
+    // Only planes that hold something; a plane of all dry or untouched cells is the default
+    for (int l = 0; l < CHUNK_LAYERS; ++l) {
+        const auto& wet = chunk.wetness[l];
+        const auto& fuel = chunk.fuel[l];
+        if (std::any_of(wet.begin(), wet.end(), [](uint8_t v) { return v != 0; })) next.wetness[l] = wet;
+        if (std::any_of(fuel.begin(), fuel.end(), [](uint8_t v) { return v != Chunk::FUEL_UNTOUCHED; })) next.fuel[l] = fuel;
+        next.plane_bytes += next.wetness[l].size() + next.fuel[l].size();
+    }
+
+    uint64_t key = chunk.coord.key();
+    auto it = saved.find(key);
+    if (it != saved.end()) {
+        drop_planes(it->second);
+        saved.erase(it);
+    }
+    if (next.tiles.empty() && next.plane_bytes == 0) return;  // Back as the source has it
+    next.stamp = ++stamp;
+    if (next.plane_bytes > 0) order.emplace_back(next.stamp, key);
+    plane_bytes += next.plane_bytes;
+    saved.emplace(key, std::move(next));
+    trim();
+}
+
+void ChunkEdits::restore(Chunk& chunk) const {
+    auto it = saved.find(chunk.coord.key());
+    if (it == saved.end()) return;
+    const Saved& s = it->second;
+    for (const TileEdit& e : s.tiles) chunk.layers[e.layer].set(e.index % CHUNK_SIZE, e.index / CHUNK_SIZE, e.height, e.tile);
+    for (int l = 0; l < CHUNK_LAYERS; ++l) {
+        if (!s.wetness[l].empty()) chunk.wetness[l] = s.wetness[l];
+        if (!s.fuel[l].empty()) chunk.fuel[l] = s.fuel[l];
+    }
+}
+
+void ChunkEdits::clear() {
+    saved.clear();
+    order.clear();
+    plane_bytes = 0;
+}
+
+size_t ChunkEdits::memory_bytes() const {
+    size_t bytes = plane_bytes + order.size() * sizeof(order[0]);
+    for (const auto& entry : saved) bytes += sizeof(entry) + entry.second.tiles.capacity() * sizeof(TileEdit);
+    return bytes;
+}
+
+void ChunkEdits::drop_planes(Saved& s) {
+    for (int l = 0; l < CHUNK_LAYERS; ++l) {
+        std::vector<uint8_t>().swap(s.wetness[l]);
+        std::vector<uint8_t>().swap(s.fuel[l]);
+    }
+    plane_bytes -= s.plane_bytes;
+    s.plane_bytes = 0;
+}
+
+void ChunkEdits::trim() {
+    while (plane_bytes > plane_budget && !order.empty()) {
+        auto [when, key] = order.front();
+        order.pop_front();
+        auto it = saved.find(key);
+        if (it == saved.end() || it->second.stamp != when) continue;  // Resaved or gone since
+        drop_planes(it->second);
+        if (it->second.tiles.empty()) saved.erase(it);
+    }
+    // Entries of chunks saved again since pile up while under budget; drop them now and then
+    if (order.size() > 2 * saved.size() + 64) {
+        std::erase_if(order, [this](const auto& o) {
+            auto it = saved.find(o.second);
+            return it == saved.end() || it->second.stamp != o.first;
+        });
+    }
+}
+
+// GridChunkSource
+bool GridChunkSource::load(ChunkCoord coord, Chunk& out) {
+    int ox = coord.cx * CHUNK_SIZE, oy = coord.cy * CHUNK_SIZE;
+    if (!grid.in_bounds(ox, oy)) return false;
+    int cw = std::min(CHUNK_SIZE, grid.width() - ox);
+    int ch = std::min(CHUNK_SIZE, grid.height() - oy);
+
+    std::vector<TileId> cells(CHUNK_CELLS);
+    for (int l = 0; l < CHUNK_LAYERS && l < grid.num_layers(); ++l) {
+        for (int h = 0; h < CHUNK_HEIGHTS && h < grid.num_heights(); ++h) {
+            std::fill(cells.begin(), cells.end(), EMPTY_TILE);  // Edge chunks pad with empty
+            for (int y = 0; y < ch; ++y) {
+                auto row = grid.row(l, h, oy + y).subspan(ox, cw);
+                std::copy(row.begin(), row.end(), cells.begin() + y * CHUNK_SIZE);
+            }
+            out.layers[l].planes[h].assign(cells.data());
+        }
+    }
+
+    if (!elev.empty()) {
+        out.elev.assign(CHUNK_CELLS, 0.0f);
+        out.moist.assign(CHUNK_CELLS, 0.0f);
+        for (int y = 0; y < ch; ++y) {
+            for (int x = 0; x < cw; ++x) {
+                size_t src = static_cast<size_t>(oy + y) * grid.width() + ox + x;
+                out.elev[y * CHUNK_SIZE + x] = elev[src];
+                out.moist[y * CHUNK_SIZE + x] = moist[src];
+            }
+        }
+    }
+
+    saved_state.restore(out);
+    return true;
+}
+
+void GridChunkSource::store(const Chunk& chunk) {
+    int ox = chunk.origin_x(), oy = chunk.origin_y();
+    int cw = std::min(CHUNK_SIZE, grid.width() - ox);
+    int ch = std::min(CHUNK_SIZE, grid.height() - oy);
+    for (int l = 0; l < CHUNK_LAYERS && l < grid.num_layers(); ++l) {
+        for (int h = 0; h < CHUNK_HEIGHTS && h < grid.num_heights(); ++h) {
+            for (int y = 0; y < ch; ++y) {
+                for (int x = 0; x < cw; ++x) grid.set(l, ox + x, oy + y, h, chunk.layers[l].get(x, y, h));
+            }
+        }
+    }
+    saved_state.save(chunk, nullptr);
+}
+
+// MappedChunkSource
+MappedChunkSource::MappedChunkSource(std::unique_ptr<MapFile> map_file, Tiles& tileset) : file(std::move(map_file)) {
+    remap.assign(file->header().num_tiles, EMPTY_TILE);
+    const auto& names = file->tile_names();
+    for (size_t i = 1; i < names.size(); ++i) remap[i] = tileset.intern(names[i]);
+}
+
+bool MappedChunkSource::load(ChunkCoord coord, Chunk& out) {
+    int ox = coord.cx * CHUNK_SIZE, oy = coord.cy * CHUNK_SIZE;
+    int w = file->width(), h = file->height();
+    if (ox < 0 || oy < 0 || ox >= w || oy >= h) return false;
+    read(coord, out);
+    edited.restore(out);
+    return true;
+}
+
+void MappedChunkSource::read(ChunkCoord coord, Chunk& out) const {
+    int ox = coord.cx * CHUNK_SIZE, oy = coord.cy * CHUNK_SIZE;
+    int w = file->width(), h = file->height();
+    int cw = std::min(CHUNK_SIZE, w - ox);
+    int ch = std::min(CHUNK_SIZE, h - oy);
+    int layers = std::min<int>(CHUNK_LAYERS, file->header().layers);
+    int heights = std::min<int>(CHUNK_HEIGHTS, file->header().heights);
+    std::vector<TileId> cells(CHUNK_CELLS);
+    for (int l = 0; l < layers; ++l) {
+        for (int hl = 0; hl < heights; ++hl) {
+            const uint16_t* plane = file->plane(l, hl);
+            std::fill(cells.begin(), cells.end(), EMPTY_TILE);
+            for (int y = 0; y < ch; ++y) {
+                const uint16_t* row = plane + static_cast<size_t>(oy + y) * w + ox;
+                for (int x = 0; x < cw; ++x) {
+                    cells[y * CHUNK_SIZE + x] = row[x] < remap.size() ? remap[row[x]] : EMPTY_TILE;
+                }
+            }
+            out.layers[l].planes[hl].assign(cells.data());
+        }
+    }
+
+    if (const float* elev = file->elev()) {
+        const float* moist = file->moist();
+        out.elev.assign(CHUNK_CELLS, 0.0f);
+        out.moist.assign(CHUNK_CELLS, 0.0f);
+        for (int y = 0; y < ch; ++y) {
+            size_t src = static_cast<size_t>(oy + y) * w + ox;
+            std::copy(elev + src, elev + src + cw, out.elev.begin() + y * CHUNK_SIZE);
+            std::copy(moist + src, moist + src + cw, out.moist.begin() + y * CHUNK_SIZE);
+        }
+    }
+}
+
+void MappedChunkSource::store(const Chunk& chunk) {
+    Chunk pristine;
+    pristine.coord = chunk.coord;
+    read(chunk.coord, pristine);
+    edited.save(chunk, &pristine);
+}
+
+// GeneratedChunkSource
+static uint32_t hash3(uint32_t a, uint32_t b, uint32_t c) {
+    uint32_t h = a * 0x9E3779B1u ^ (b + 0x7F4A7C15u) * 0x85EBCA77u ^ (c + 0x165667B1u) * 0xC2B2AE3Du;
+    h ^= h >> 15; h *= 0x2C1B3C6Du;
+    h ^= h >> 12; h *= 0x297A2D39u;
+    h ^= h >> 15;
+    return h;
+}
+
+GeneratedChunkSource::GeneratedChunkSource(const Tiles& tileset, int width, int height, uint32_t seed)
+    : w(width), h(height), seed(seed) {
+    rock_boulder = tileset.find("rock_boulder");
+    grass_wispy = tileset.find("grass_wispy");
+    grass_tuft = tileset.find("grass_tuft");
+    tree_oak = tileset.find("tree_oak");
+    sand_dune = tileset.find("sand_dune");
+    water_wave = tileset.find("water_wave");
+    table_wooden = tileset.find("table_wooden");
+    chair_wooden = tileset.find("chair_wooden");
+    bridge_rope = tileset.find("bridge_rope");
+}
+
+float GeneratedChunkSource::rand01(int layer, int x, int y, uint32_t salt) const {
+    return hash3(static_cast<uint32_t>(x), static_cast<uint32_t>(y), seed + salt * 131u + static_cast<uint32_t>(layer)) / 4294967296.0f;
+}
+
+float GeneratedChunkSource::noise(int x, int y, uint32_t salt) const {
+    float total = 0.0f, amplitude = 1.0f, norm = 0.0f;
+    for (int octave = 0; octave < 4; ++octave) {
+        int scale = 32 >> octave;
+        int gx = x / scale, gy = y / scale;
+        float fx = static_cast<float>(x % scale) / scale, fy = static_cast<float>(y % scale) / scale;
+        fx = fx * fx * (3 - 2 * fx);
+        fy = fy * fy * (3 - 2 * fy);
+        auto lattice = [&](int lx, int ly) { return hash3(lx, ly, seed + salt + octave * 7919u) / 4294967296.0f; };
+        float top = lattice(gx, gy) + (lattice(gx + 1, gy) - lattice(gx, gy)) * fx;
+        float bottom = lattice(gx, gy + 1) + (lattice(gx + 1, gy + 1) - lattice(gx, gy + 1)) * fx;
+        total += (top + (bottom - top) * fy) * amplitude;
+        norm += amplitude;
+        amplitude *= 0.5f;
+    }
+    return total / norm;
+}
+
+TileId GeneratedChunkSource::biome_tile(float elev, float moist, float r) const {
+    if (elev > 0.7f) return rock_boulder;  // Mountain
+    if (moist > 0.7f) return r < 0.5f ? water_wave : grass_tuft;  // Swamp
+    if (moist < 0.3f && elev < 0.3f) return sand_dune;  // Desert
+    if (moist > 0.5f) return r < 0.5f ? grass_wispy : tree_oak;  // Forest
+    return grass_tuft;  // Plains
+}
+
+bool GeneratedChunkSource::load(ChunkCoord coord, Chunk& out) {
+    int ox = coord.cx * CHUNK_SIZE, oy = coord.cy * CHUNK_SIZE;
+    if (ox < 0 || oy < 0 || ox >= w || oy >= h) return false;
+    generate(coord, out);
+    edited.restore(out);
+    return true;
+}
+
+void GeneratedChunkSource::generate(ChunkCoord coord, Chunk& out) const {
+    int ox = coord.cx * CHUNK_SIZE, oy = coord.cy * CHUNK_SIZE;
+    out.elev.resize(CHUNK_CELLS);
+    out.moist.resize(CHUNK_CELLS);
+    for (int y = 0; y < CHUNK_SIZE; ++y) {
+        for (int x = 0; x < CHUNK_SIZE; ++x) {
+            out.elev[y * CHUNK_SIZE + x] = noise(ox + x, oy + y, 0);
+            out.moist[y * CHUNK_SIZE + x] = noise(ox + x, oy + y, 1);
+        }
+    }
+
+    std::vector<TileId> base(CHUNK_CELLS), upper(CHUNK_CELLS);
+    const std::vector<TileId> empty(CHUNK_CELLS, EMPTY_TILE);
+    for (int l = 0; l < CHUNK_LAYERS; ++l) {
+        std::fill(upper.begin(), upper.end(), EMPTY_TILE);
+        for (int y = 0; y < CHUNK_SIZE; ++y) {
+            for (int x = 0; x < CHUNK_SIZE; ++x) {
+                int gx = ox + x, gy = oy + y, i = y * CHUNK_SIZE + x;
+                TileId tile = EMPTY_TILE;
+                if (gx >= w || gy >= h) {
+                    // Past the map edge
+                } else if (l == 0) {  // Caves
+                    if (rand01(l, gx, gy, 0) < 0.1f) tile = rock_boulder;
+                } else if (l == 1 || l == 2) {  // Ground biomes
+                    tile = biome_tile(out.elev[i], out.moist[i], rand01(l, gx, gy, 1));
+                    if (rand01(l, gx, gy, 2) < 0.1f) tile = rand01(l, gx, gy, 3) < 0.5f ? table_wooden : chair_wooden;
+                } else if (l == 3) {  // Bridges, one span per 256x256 region
+                    if (gx % 256 == 25 && gy % 256 >= 10 && gy % 256 < 40) tile = bridge_rope;
+                } else if (rand01(l, gx, gy, 0) >= 0.9f) {
+                    tile = rock_boulder;
+                }
+                base[i] = tile;
+                if ((tile == tree_oak && rand01(l, gx, gy, 4) < 0.5f) || tile == table_wooden) upper[i] = tile;
+            }
+        }
+        out.layers[l].planes[0].assign(base.data());
+        out.layers[l].planes[1].assign(upper.data());
+        for (int hl = 2; hl < CHUNK_HEIGHTS; ++hl) out.layers[l].planes[hl].assign(empty.data());
+    }
+}
+
+void GeneratedChunkSource::store(const Chunk& chunk) {
+    Chunk pristine;
+    pristine.coord = chunk.coord;
+    generate(chunk.coord, pristine);
+    edited.save(chunk, &pristine);
+}
@@ -0,0 +1,106 @@
+#ifndef MAP_SOURCES_H
+#define MAP_SOURCES_H
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include "chunk.h"
+#include "map_file.h"
+#include "tile_grid.h"
+
+// What evicted chunks had that their source can't produce again: tile edits,
+// which are always kept, and wetness and fire fuel planes, which are dropped
+// oldest first past plane_budget so that travelling through rain or fire
+// doesn't grow memory without end; those cells come back dry and unburnt.
+class ChunkEdits {
+public:
+    static constexpr size_t DEFAULT_PLANE_BUDGET = 8u << 20;  // Bytes of wetness and fuel
+
+    explicit ChunkEdits(size_t plane_budget = DEFAULT_PLANE_BUDGET) : plane_budget(plane_budget) {}
+    // Records chunk's state; its tiles as cells that differ from pristine, the
+    // source's own contents for it, or none without one
+    void save(const Chunk& chunk, const Chunk* pristine);
+    void restore(Chunk& chunk) const;  // Onto the source's contents, right after loading them
+    void clear();
+    size_t memory_bytes() const;
+
+private:
+    struct TileEdit {
+        uint16_t index;  // y * CHUNK_SIZE + x
+        uint8_t layer, height;
+        TileId tile;
+    };
+    struct Saved {
+        std::vector<TileEdit> tiles;
+        std::array<std::vector<uint8_t>, CHUNK_LAYERS> wetness, fuel;
+        size_t plane_bytes = 0;
+        uint64_t stamp = 0;  // Save order, for dropping planes oldest first
+    };
+    void drop_planes(Saved& saved);
+    void trim();
+
+    std::unordered_map<uint64_t, Saved> saved;  // By ChunkCoord::key
+    std::deque<std::pair<uint64_t, uint64_t>> order;  // (stamp, key) of saves with planes; stale once resaved
+    size_t plane_bytes = 0, plane_budget;
+    uint64_t stamp = 0;
+};
+
+// Pages chunks out of a fully loaded map (e.g. map.json)
+class GridChunkSource : public ChunkSource {
+public:
+    GridChunkSource(TileGrid grid, std::vector<float> elev, std::vector<float> moist)
+        : grid(std::move(grid)), elev(std::move(elev)), moist(std::move(moist)) {}
+    int width() const override { return grid.width(); }
+    int height() const override { return grid.height(); }
+    bool load(ChunkCoord coord, Chunk& out) override;
+    void store(const Chunk& chunk) override;
+
+private:
+    TileGrid grid;
+    std::vector<float> elev, moist;  // [y * width + x], may be empty
+    ChunkEdits saved_state;  // Evicted chunks' wetness and fire fuel; tile edits go into grid
+};
+
+// Pages chunks straight out of a memory-mapped .cmap file; only touched pages are read
+class MappedChunkSource : public ChunkSource {
+public:
+    MappedChunkSource(std::unique_ptr<MapFile> file, Tiles& tileset);  // Resolves the file's tile table
+    int width() const override { return file->width(); }
+    int height() const override { return file->height(); }
+    bool load(ChunkCoord coord, Chunk& out) override;
+    void store(const Chunk& chunk) override;  // The mapping is read-only; edits are kept beside it
+
+private:
+    void read(ChunkCoord coord, Chunk& out) const;
+    std::unique_ptr<MapFile> file;
+    std::vector<TileId> remap;  // File tile index -> TileId
+    ChunkEdits edited;
+};
+
+// Procedural map of any size, same rules as generate_multi_layer_map in tools/generate_data.py.
+// Edits to chunks are kept on eviction so they come back as they were left.
+class GeneratedChunkSource : public ChunkSource {
+public:
+    GeneratedChunkSource(const Tiles& tileset, int width, int height, uint32_t seed);
+    int width() const override { return w; }
+    int height() const override { return h; }
+    bool load(ChunkCoord coord, Chunk& out) override;
+    void store(const Chunk& chunk) override;
+
+private:
+    void generate(ChunkCoord coord, Chunk& out) const;
+    float noise(int x, int y, uint32_t salt) const;  // Fractal value noise in [0, 1]
+    float rand01(int layer, int x, int y, uint32_t salt) const;
+    TileId biome_tile(float elev, float moist, float r) const;
+
+    int w, h;
+    uint32_t seed;
+    TileId rock_boulder, grass_wispy, grass_tuft, tree_oak, sand_dune, water_wave;
+    TileId table_wooden, chair_wooden, bridge_rope;
+    ChunkEdits edited;
+};
+
+#endif
@@ -0,0 +1,18 @@
+#include "tile_grid.h"
+#include <algorithm>
+
+void TileGrid::resize(int layers, int heights, int width, int height) {
+    this->layers = layers;
+    this->heights = heights;
+    w = width;
+    h = height;
+    cells.assign(static_cast<size_t>(layers) * heights * width * height, EMPTY_TILE);
+}
+
+void TileGrid::fill(TileId tile) {
+    std::fill(cells.begin(), cells.end(), tile);
+}
+
+std::span<const TileId> TileGrid::row(int layer, int height_level, int y) const {
+    return {cells.data() + index(layer, 0, y, height_level), static_cast<size_t>(w)};
+}
@@ -0,0 +1,42 @@
+#ifndef TILE_GRID_H
+#define TILE_GRID_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "tiles.h"  // TileId
+
+// Dense [layer][height][y][x] grid of tile handles. Rows are contiguous, so
+// loading a chunk copies memory linearly.
+class TileGrid {
+public:
+    TileGrid() = default;
+    TileGrid(int layers, int heights, int width, int height) { resize(layers, heights, width, height); }
+
+    void resize(int layers, int heights, int width, int height);
+    void fill(TileId tile);
+
+    int num_layers() const { return layers; }
+    int num_heights() const { return heights; }
+    int width() const { return w; }
+    int height() const { return h; }
+    bool in_bounds(int x, int y) const { return x >= 0 && x < w && y >= 0 && y < h; }
+
+    TileId get(int layer, int x, int y, int height_level) const { return cells[index(layer, x, y, height_level)]; }
+    void set(int layer, int x, int y, int height_level, TileId tile) { cells[index(layer, x, y, height_level)] = tile; }
+
+    std::span<const TileId> row(int layer, int height_level, int y) const;
+
+    size_t memory_bytes() const { return cells.capacity() * sizeof(TileId); }
+
+private:
+    size_t index(int layer, int x, int y, int height_level) const {
+        return ((static_cast<size_t>(layer) * heights + height_level) * h + y) * w + x;
+    }
+
+    int layers = 0, heights = 0, w = 0, h = 0;
+    std::vector<TileId> cells;
+};
+
+#endif
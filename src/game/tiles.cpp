@@ -1,8 +1,46 @@
 #include "tiles.h"
 #include <fstream>
 #include <unordered_map>
+#include <cmath>
 #include <SDL3/SDL.h>
 
+static TileType parse_tile_type(const std::string& type) {
+    static const std::unordered_map<std::string, TileType> types = {
+        {"empty", TileType::EMPTY}, {"ground", TileType::GROUND}, {"terrain", TileType::TERRAIN},
+        {"vegetation", TileType::VEGETATION}, {"structure", TileType::STRUCTURE},
+        {"furniture", TileType::FURNITURE}, {"bridge", TileType::BRIDGE}};
+    auto it = types.find(type);
+    return it != types.end() ? it->second : TileType::OTHER;
+}
+
+void Tiles::add_empty_tile() {
+    Tile empty_tile;
+    empty_tile.id = "empty";
+    empty_tile.type = "empty";
+    empty_tile.description = "Empty tile";
+    HeightLevel lev;
+    lev.height = 0;
+    lev.passable = true;
+    lev.transparent = true;
+    lev.views["default"] = "";
+    empty_tile.height_levels.push_back(lev);
+
+    TileHot h;
+    h.num_levels = 1;
+    hot.push_back(h);
+    cold.push_back(empty_tile);
+    ids["empty"] = EMPTY_TILE;
+}
+
+FrameId Tiles::intern_frame(const std::string& path) {
+    auto it = frame_ids.find(path);
+    if (it != frame_ids.end()) return it->second;
+    FrameId frame = static_cast<FrameId>(frame_paths.size());
+    frame_paths.push_back(path);
+    frame_ids[path] = frame;
+    return frame;
+}
+
 void Tiles::load(const std::string& path) {
     std::ifstream f(path);
     if (!f.is_open()) {
@@ -17,12 +55,20 @@ void Tiles::load(const std::string& path) {
         return;
     }
 
-    tileset.clear();
+    // Ids handed out before a reload are invalid afterwards; load tiles before the map
+    hot.clear();
+    cold.clear();
+    ids.clear();
+    frame_lists.clear();
+    frame_paths.clear();
+    frame_ids.clear();
+    add_empty_tile();
+
     for (const auto& entry : j["tiles"]) {
         Tile t;
         t.id = entry["id"];
         t.type = entry["type"];
-        t.description = entry["description"];
+        t.description = entry.value("description", "");
         t.preferred_layer = entry.value("preferred_layer", 1);
         t.blocks_sight = entry.value("blocks_sight", false);
         t.supports_furniture = entry.value("supports_furniture", false);
@@ -33,9 +79,9 @@ void Tiles::load(const std::string& path) {
         for (const auto& hl : entry["height_levels"]) {
             HeightLevel lev;
             lev.height = hl["height"];
-            lev.passable = hl["passable"];
-            lev.transparent = hl["transparent"];
-            if (hl["views"].contains("default")) {
+            lev.passable = hl.value("passable", true);
+            lev.transparent = hl.value("transparent", false);
+            if (hl.contains("views") && hl["views"].contains("default")) {
                 lev.views["default"] = hl["views"]["default"];
             }
             t.height_levels.push_back(lev);
@@ -64,43 +110,85 @@ void Tiles::load(const std::string& path) {
             t.wind_sway = entry.value("wind_sway", false);
         }
 
-        // Edges stub (pairs of points for line segments)
-        for (auto& lev : t.height_levels) {
-            if (!lev.transparent) {
-                lev.edges = {{0,0}, {64,0}, {64,32}, {0,32}};
-            }
+        // Hot data
+        TileHot h;
+        h.type = parse_tile_type(t.type);
+        if (t.supports_furniture) h.flags |= TILE_SUPPORTS_FURNITURE;
+        if (t.blocks_sight) h.flags |= TILE_BLOCKS_SIGHT;
+        if (t.emits_light.intensity > 0) h.flags |= TILE_EMITS_LIGHT;
+        if (t.wind_sway) h.flags |= TILE_WIND_SWAY;
+        h.num_levels = static_cast<uint8_t>(std::min<size_t>(t.height_levels.size(), TileHot::MAX_LEVELS));
+        h.passable_mask = h.transparent_mask = 0;
+        for (int lv = 0; lv < TileHot::MAX_LEVELS; ++lv) {
+            // Levels past the tile's own are open air
+            bool passable = lv >= h.num_levels || t.height_levels[lv].passable;
+            bool transparent = lv >= h.num_levels || t.height_levels[lv].transparent;
+            h.passable_mask |= passable << lv;
+            h.transparent_mask |= transparent << lv;
+            if (lv < h.num_levels) h.level_height[lv] = static_cast<uint8_t>(t.height_levels[lv].height);
+            // The floor itself doesn't shade; a tile flagged blocks_sight does at every level
+            if (lv < h.num_levels && ((!transparent && h.level_height[lv] > 0) || t.blocks_sight)) h.opaque_mask |= 1 << lv;
+        }
+        // Outline of the cell's diamond (corner points), on the levels that block sight so shadows match what
+        // Vision sees. Neighbours' diamonds share edges and never cross, which compute_visibility relies on.
+        for (int lv = 0; lv < h.num_levels; ++lv) {
+            if (h.blocks_sight(lv)) t.height_levels[lv].edges = {{32, 0}, {64, 16}, {32, 32}, {0, 16}};
+        }
+        for (int cl : t.connects_layers) {
+            if (cl >= 0 && cl < 8) h.connects_layers |= 1 << cl;
         }
+        h.flammability = static_cast<int16_t>(t.flammability);
+        h.wetness_threshold = static_cast<int16_t>(t.wetness_threshold);
+        h.animation_speed = t.animation_speed;
+        h.first_frame = static_cast<uint16_t>(frame_lists.size());
+        if (!t.animation_frames.empty()) {
+            for (const auto& frame : t.animation_frames) frame_lists.push_back(intern_frame(frame));
+        } else if (!t.height_levels.empty() && t.height_levels[0].views.count("default")) {
+            frame_lists.push_back(intern_frame(t.height_levels[0].views.at("default")));
+        }
+        h.num_frames = static_cast<uint16_t>(frame_lists.size() - h.first_frame);
 
-        tileset[t.id] = t;
+        auto existing = ids.find(t.id);
+        if (existing != ids.end()) {
+            hot[existing->second] = h;
+            cold[existing->second] = t;
+        } else {
+            ids[t.id] = static_cast<TileId>(hot.size());
+            hot.push_back(h);
+            cold.push_back(t);
+        }
     }
 }
 
-const Tile* Tiles::get(const std::string& id) const {
-    auto it = tileset.find(id);
-    if (it != tileset.end()) return &it->second;
-
-    static Tile empty_tile;
-    static bool init = false;
-    if (!init) {
-        empty_tile.id = "empty";
-        empty_tile.type = "empty";
-        empty_tile.description = "Empty tile";
-        HeightLevel lev;
-        lev.height = 0;
-        lev.passable = true;
-        lev.transparent = true;
-        lev.views["default"] = "";
-        empty_tile.height_levels.push_back(lev);
-        init = true;
-    }
+TileId Tiles::intern(const std::string& id) {
+    auto it = ids.find(id);
+    if (it != ids.end()) return it->second;
     SDL_Log("Warning: Missing tile '%s', using empty fallback", id.c_str());
-    return &empty_tile;
+    ids[id] = EMPTY_TILE;  // Alias so the warning fires once per id
+    return EMPTY_TILE;
+}
+
+TileId Tiles::find(const std::string& id) const {
+    auto it = ids.find(id);
+    return it != ids.end() ? it->second : EMPTY_TILE;
+}
+
+const Tile* Tiles::get(const std::string& id) const {
+    return &cold[find(id)];
+}
+
+FrameId Tiles::frame_at(TileId id, float time) const {
+    const TileHot& h = hot[id];
+    if (h.num_frames == 0) return NO_FRAME;
+    if (h.num_frames == 1) return frame_lists[h.first_frame];
+    size_t frame = static_cast<size_t>(std::fmod(time * h.animation_speed, static_cast<float>(h.num_frames)));
+    return frame_lists[h.first_frame + frame];
 }
 
 std::vector<LightSource> Tiles::get_all_lights() const {
     std::vector<LightSource> lights;
-    for (const auto& pair : tileset) {
-        if (pair.second.emits_light.intensity > 0) lights.push_back(pair.second.emits_light);
+    for (const auto& tile : cold) {
+        if (tile.emits_light.intensity > 0) lights.push_back(tile.emits_light);
     }
     return lights;
 }
@@ -7,6 +7,12 @@
 #include <unordered_map>
 #include <nlohmann/json.hpp>
 #include <array>
+#include <cstdint>
+
+using TileId = uint16_t;  // Dense handle assigned by Tiles::load
+static constexpr TileId EMPTY_TILE = 0;  // Also the fallback for unknown ids
+using FrameId = uint16_t;  // Handle into the tileset's frame path table
+static constexpr FrameId NO_FRAME = 0xFFFF;
 
 struct LightSource {
     int intensity = 0;
@@ -22,6 +28,40 @@ struct HeightLevel {
     std::vector<std::pair<int, int>> edges;
 };
 
+enum class TileType : uint8_t { EMPTY, GROUND, TERRAIN, VEGETATION, STRUCTURE, FURNITURE, BRIDGE, OTHER };
+
+enum TileFlags : uint8_t {
+    TILE_SUPPORTS_FURNITURE = 1 << 0,
+    TILE_BLOCKS_SIGHT = 1 << 1,
+    TILE_EMITS_LIGHT = 1 << 2,
+    TILE_WIND_SWAY = 1 << 3,
+};
+
+// Per-tile data read in per-cell loops. Kept small and flat; strings live in Tile.
+struct TileHot {
+    static constexpr int MAX_LEVELS = 8;
+
+    TileType type = TileType::EMPTY;
+    uint8_t flags = 0;
+    uint8_t num_levels = 0;
+    uint8_t passable_mask = 0xFF;  // Bit h = height level h is passable
+    uint8_t transparent_mask = 0xFF;  // Bit h = height level h is transparent
+    uint8_t opaque_mask = 0;  // Bit h = height level h blocks sight and light: opaque and above the floor
+    uint8_t connects_layers = 0;  // Bit l = connects to map layer l
+    int16_t flammability = 0;
+    int16_t wetness_threshold = 10;
+    uint16_t first_frame = 0, num_frames = 0;  // Range in Tiles' frame list
+    float animation_speed = 0.1f;
+    std::array<uint8_t, MAX_LEVELS> level_height = {};
+
+    bool has(TileFlags f) const { return flags & f; }
+    bool passable(int h) const { return (passable_mask >> h) & 1; }
+    bool transparent(int h) const { return (transparent_mask >> h) & 1; }
+    bool blocks_sight(int h) const { return (opaque_mask >> h) & 1; }
+    bool connects_to(int layer) const { return (connects_layers >> layer) & 1; }
+};
+
+// Cold per-tile data: descriptions, views and other authoring detail
 struct Tile {
     std::string id, type, description;
     int preferred_layer = 1;
@@ -41,11 +81,35 @@ struct Tile {
 
 class Tiles {
 private:
-    std::unordered_map<std::string, Tile> tileset;
+    std::vector<TileHot> hot;  // Indexed by TileId
+    std::vector<Tile> cold;  // Indexed by TileId
+    std::unordered_map<std::string, TileId> ids;
+    std::vector<FrameId> frame_lists;  // TileHot::first_frame/num_frames index here
+    std::vector<std::string> frame_paths;  // Indexed by FrameId
+    std::unordered_map<std::string, FrameId> frame_ids;
+
+    FrameId intern_frame(const std::string& path);
+    void add_empty_tile();
 
 public:
+    Tiles() { add_empty_tile(); }
     void load(const std::string& path);
+
+    // Resolve an id string once (e.g. at map load); unknown ids map to EMPTY_TILE and warn once
+    TileId intern(const std::string& id);
+    TileId find(const std::string& id) const;
+    size_t size() const { return hot.size(); }
+
+    const TileHot& hot_data(TileId id) const { return hot[id]; }
+    const Tile& cold_data(TileId id) const { return cold[id]; }
+    const Tile* get(TileId id) const { return id < cold.size() ? &cold[id] : nullptr; }
     const Tile* get(const std::string& id) const;
+
+    FrameId frame_at(TileId id, float time) const;
+    FrameId frame(TileId id, int i) const { return frame_lists[hot[id].first_frame + i]; }  // i < hot_data(id).num_frames
+    const std::string& frame_path(FrameId frame) const { return frame_paths[frame]; }
+    size_t frame_count() const { return frame_paths.size(); }
+
     std::vector<LightSource> get_all_lights() const;
 };
 
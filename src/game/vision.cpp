@@ -0,0 +1,197 @@
+#include "vision.h"
+#include "../engine/jobs.h"
+#include <algorithm>
+#include <cstdlib>
+
+ViewerId Vision::add_viewer(int layer, int x, int y, int radius) {
+    ViewerId id;
+    if (!free_ids.empty()) {
+        id = free_ids.back();
+        free_ids.pop_back();
+    } else {
+        id = static_cast<ViewerId>(viewers.size());
+        viewers.emplace_back();
+    }
+    Viewer& v = viewers[id];
+    v = Viewer();
+    v.layer = layer;
+    v.x = x;
+    v.y = y;
+    v.radius = std::clamp(radius, 0, MAX_RADIUS);
+    v.live = true;
+    return id;
+}
+
+void Vision::move_viewer(ViewerId id, int layer, int x, int y) {
+    if (id >= viewers.size() || !viewers[id].live) return;
+    Viewer& v = viewers[id];
+    if (v.layer == layer && v.x == x && v.y == y) return;
+    v.layer = layer;
+    v.x = x;
+    v.y = y;
+    v.dirty = true;
+}
+
+void Vision::remove_viewer(ViewerId id) {
+    if (id >= viewers.size() || !viewers[id].live) return;
+    viewers[id] = Viewer();
+    viewers[id].live = false;
+    free_ids.push_back(id);
+}
+
+bool Vision::opaque(int layer, int x, int y) const {
+    ChunkCoord coord = ChunkCoord::of_tile(x, y);
+    auto it = opacity.find(coord.key());
+    if (it == opacity.end()) return false;
+    return it->second[layer][(y - coord.cy * CHUNK_SIZE) * CHUNK_SIZE + (x - coord.cx * CHUNK_SIZE)];
+}
+
+void Vision::build_bits(const Chunk& chunk) {
+    ChunkBits& bits = opacity[chunk.coord.key()];
+    for (int layer = 0; layer < CHUNK_LAYERS; ++layer) {
+        bits[layer].reset();
+        for (int h = 0; h < CHUNK_HEIGHTS; ++h) {
+            chunk.layers[layer].for_each(h, [&](int lx, int ly, TileId id) {
+                if (tileset.hot_data(id).blocks_sight(h)) bits[layer].set(ly * CHUNK_SIZE + lx);
+            });
+        }
+    }
+}
+
+void Vision::set_bit(int layer, int x, int y) {
+    ChunkCoord coord = ChunkCoord::of_tile(x, y);
+    auto it = opacity.find(coord.key());
+    if (it == opacity.end()) return;
+    bool blocks = false;
+    for (int h = 0; h < CHUNK_HEIGHTS && !blocks; ++h) blocks = tileset.hot_data(chunks.get(layer, x, y, h)).blocks_sight(h);
+    it->second[layer][(y - coord.cy * CHUNK_SIZE) * CHUNK_SIZE + (x - coord.cx * CHUNK_SIZE)] = blocks;
+}
+
+void Vision::mark_near(int layer, int x0, int y0, int x1, int y1) {
+    for (auto& v : viewers) {
+        if (!v.live || (layer >= 0 && v.cast_layer != layer)) continue;
+        int r = v.cast_radius;
+        if (v.cast_x + r < x0 || v.cast_x - r > x1 || v.cast_y + r < y0 || v.cast_y - r > y1) continue;
+        v.dirty = true;
+    }
+}
+
+// Recursive shadowcasting (Bergstrom), one octant at a time. Rows run away from
+// the viewer; start and end are the slopes still lit in this octant, and an
+// opaque cell splits the remaining rows into the part before it and after it.
+void Vision::cast_octant(Viewer& v, int row, float start, float end, int xx, int xy, int yx, int yy) const {
+    if (start < end) return;
+    const int r = v.cast_radius, n = 2 * r + 1;
+    float new_start = 0.0f;
+    for (int j = row; j <= r; ++j) {
+        bool blocked = false;
+        for (int dx = -j, dy = -j; dx <= 0; ++dx) {
+            float l_slope = (dx - 0.5f) / (dy + 0.5f), r_slope = (dx + 0.5f) / (dy - 0.5f);
+            if (start < r_slope) continue;
+            if (end > l_slope) break;
+
+            int ox = dx * xx + dy * xy, oy = dx * yx + dy * yy;  // Offset from the viewer
+            if (dx * dx + dy * dy <= r * r) v.visible[(oy + r) * n + ox + r] = 1;
+            bool wall = opaque(v.cast_layer, v.cast_x + ox, v.cast_y + oy);
+            if (blocked) {
+                if (wall) {
+                    new_start = r_slope;
+                    continue;
+                }
+                blocked = false;
+                start = new_start;
+            } else if (wall && j < r) {
+                blocked = true;
+                cast_octant(v, j + 1, start, l_slope, xx, xy, yx, yy);
+                new_start = r_slope;
+            }
+        }
+        if (blocked) break;
+    }
+}
+
+void Vision::cast(Viewer& v) const {
+    static constexpr int OCTANTS[8][4] = {
+        {1, 0, 0, 1}, {0, 1, 1, 0}, {0, -1, 1, 0}, {-1, 0, 0, 1},
+        {-1, 0, 0, -1}, {0, -1, -1, 0}, {0, 1, -1, 0}, {1, 0, 0, -1},
+    };
+    v.cast_layer = v.layer;
+    v.cast_x = v.x;
+    v.cast_y = v.y;
+    v.cast_radius = v.radius;
+    int n = 2 * v.radius + 1;
+    v.visible.assign(static_cast<size_t>(n) * n, 0);
+    v.visible[v.radius * n + v.radius] = 1;
+    for (const auto& o : OCTANTS) cast_octant(v, 1, 1.0f, 0.0f, o[0], o[1], o[2], o[3]);
+    v.dirty = false;
+}
+
+void Vision::update(JobSystem& jobs) {
+    updated = 0;
+    if (tile_count != tileset.size()) {  // New tileset: rebuild every bit
+        tile_count = tileset.size();
+        built = false;
+    }
+
+    bool tracked = built && chunks.changes_since(seen_revision, [&](const ChunkCache::Change& c) {
+        if (c.layer >= 0) {
+            set_bit(c.layer, c.x, c.y);
+            mark_near(c.layer, c.x, c.y, c.x, c.y);
+            return;
+        }
+        ChunkCoord coord = ChunkCoord::of_tile(c.x, c.y);
+        if (const Chunk* chunk = chunks.find(coord)) build_bits(*chunk);
+        else opacity.erase(coord.key());
+        mark_near(-1, c.x, c.y, c.x + CHUNK_SIZE - 1, c.y + CHUNK_SIZE - 1);
+    });
+    if (!tracked) {
+        opacity.clear();
+        chunks.for_each_resident([&](const Chunk& chunk) { build_bits(chunk); });
+        for (auto& v : viewers) v.dirty = v.live;
+    }
+    seen_revision = chunks.revision();
+    built = true;
+
+    stale.clear();
+    for (ViewerId id = 0; id < viewers.size(); ++id) {
+        if (viewers[id].live && viewers[id].dirty) stale.push_back(id);
+    }
+    updated = stale.size();
+    if (stale.empty()) return;
+    JobGraph graph;
+    graph.parallel_for(stale.size(), 8, [this](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) cast(viewers[stale[i]]);  // Reads only the opacity bits
+    });
+    jobs.run(graph);
+}
+
+bool Vision::can_see(ViewerId id, int x, int y) const {
+    if (id >= viewers.size() || !viewers[id].live) return false;
+    const Viewer& v = viewers[id];
+    int ox = x - v.cast_x, oy = y - v.cast_y, r = v.cast_radius;
+    if (v.cast_layer < 0 || std::abs(ox) > r || std::abs(oy) > r) return false;
+    return v.visible[(oy + r) * (2 * r + 1) + ox + r];
+}
+
+bool Vision::line_of_sight(const LosQuery& q) const {
+    int dx = std::abs(q.x1 - q.x0), dy = std::abs(q.y1 - q.y0);
+    int sx = q.x0 < q.x1 ? 1 : -1, sy = q.y0 < q.y1 ? 1 : -1;
+    int err = dx - dy, x = q.x0, y = q.y0;
+    while (true) {  // Bresenham, checking the cells strictly between the ends
+        int e2 = 2 * err;
+        if (e2 > -dy) { err -= dy; x += sx; }
+        if (e2 < dx) { err += dx; y += sy; }
+        if (x == q.x1 && y == q.y1) return true;
+        if (opaque(q.layer, x, y)) return false;
+    }
+}
+
+void Vision::line_of_sight(JobSystem& jobs, const std::vector<LosQuery>& queries, std::vector<uint8_t>& out) const {
+    out.resize(queries.size());
+    if (queries.empty()) return;
+    JobGraph graph;
+    graph.parallel_for(queries.size(), 64, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) out[i] = line_of_sight(queries[i]);
+    });
+    jobs.run(graph);
+}
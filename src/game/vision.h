@@ -0,0 +1,77 @@
+#ifndef VISION_H
+#define VISION_H
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "chunk.h"
+#include "tiles.h"
+
+class JobSystem;
+
+using ViewerId = uint32_t;
+static constexpr ViewerId NO_VIEWER = UINT32_MAX;
+
+// What actors can see. Opacity comes from TileHot::blocks_sight and is kept as
+// a bit per cell per resident chunk, following the ChunkCache change log. Each
+// viewer's field of view is a recursive shadowcast over those bits, cached until
+// the viewer moves or a cell within its radius changes; stale ones are recast
+// in parallel by update(). Line-of-sight queries come in batches, also parallel.
+class Vision {
+public:
+    static constexpr int DEFAULT_RADIUS = 20;  // Tiles
+    static constexpr int MAX_RADIUS = 60;
+
+    struct LosQuery {
+        int layer, x0, y0, x1, y1;
+    };
+
+    Vision(const ChunkCache& chunks, const Tiles& tileset) : chunks(chunks), tileset(tileset) {}
+
+    ViewerId add_viewer(int layer, int x, int y, int radius = DEFAULT_RADIUS);
+    void move_viewer(ViewerId id, int layer, int x, int y);  // No-op if it hasn't moved
+    void remove_viewer(ViewerId id);
+
+    // Once a tick: applies map changes to the opacity bits, then recasts stale fields of view
+    void update(JobSystem& jobs);
+
+    bool can_see(ViewerId id, int x, int y) const;  // From the last update(); false off its layer or outside its radius
+    int viewer_layer(ViewerId id) const { return id < viewers.size() ? viewers[id].cast_layer : -1; }
+    bool opaque(int layer, int x, int y) const;  // Cells outside resident chunks are clear
+    bool line_of_sight(const LosQuery& q) const;  // Clear line between two cells; the end cells themselves never block
+    void line_of_sight(JobSystem& jobs, const std::vector<LosQuery>& queries, std::vector<uint8_t>& out) const;  // out[i] answers queries[i]
+
+    size_t fovs_updated() const { return updated; }  // Last update()
+
+private:
+    struct Viewer {
+        int layer = 0, x = 0, y = 0, radius = DEFAULT_RADIUS;
+        bool live = false;
+        bool dirty = true;
+        // Field of view as of the last cast: (2 * cast_radius + 1)^2 cells around (cast_x, cast_y)
+        std::vector<uint8_t> visible;
+        int cast_layer = -1, cast_x = 0, cast_y = 0, cast_radius = 0;
+    };
+    using ChunkBits = std::array<std::bitset<CHUNK_CELLS>, CHUNK_LAYERS>;
+
+    void build_bits(const Chunk& chunk);
+    void set_bit(int layer, int x, int y);  // From the cell's current tiles
+    void mark_near(int layer, int x0, int y0, int x1, int y1);
+    void cast(Viewer& v) const;
+    void cast_octant(Viewer& v, int row, float start, float end, int xx, int xy, int yx, int yy) const;
+
+    const ChunkCache& chunks;
+    const Tiles& tileset;
+    std::unordered_map<uint64_t, ChunkBits> opacity;  // By ChunkCoord::key
+    std::vector<Viewer> viewers;  // Indexed by ViewerId
+    std::vector<ViewerId> free_ids;
+    std::vector<ViewerId> stale;  // update() scratch
+    uint64_t seen_revision = 0;
+    size_t tile_count = 0;
+    bool built = false;
+    size_t updated = 0;
+};
+
+#endif
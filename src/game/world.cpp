@@ -1,36 +1,28 @@
 #include "world.h"
 #include "../engine/input.h"
 #include "../engine/particles.h"
-#include "../engine/audio.h"
+#include "map_sources.h"
+#include "../engine/utils/hash.h"
 #include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <random>
-#include <queue>
 #include <cmath>
 
 std::random_device rd;
 std::mt19937 gen(rd());
 std::uniform_real_distribution<float> dis(0.0f, 1.0f);
 
-World::World() {
-    audio = new AudioManager();
-    for (auto& layer : grid) {
-        layer.resize(WIDTH, std::vector<std::map<int, std::optional<std::string>>>(HEIGHT));
-    }
-    tile_wetness = std::array<std::vector<std::vector<int>>, NUM_MAP_LAYERS>();
-    for (auto& layer : tile_wetness) {
-        layer.resize(WIDTH, std::vector<int>(HEIGHT, 0));
-    }
-    start_time = std::chrono::steady_clock::now();
+World::World(AudioSink* sink) : audio(sink ? sink : &null_audio) {
+    thunder_sound = audio->sound("thunder");  // Files and voice policies come from the audio manifest
+    day_track = audio->sound("day_ambient");
+    night_track = audio->sound("night_ambient");
+    rain_track = audio->sound("rain_patter");
+    snow_track = audio->sound("snow_wind");
+    fire_track = audio->sound("fire_crackle");
     game_time = 12.0f;
     moon_phase = 0;
     global_time = 0.0f;
-    current_bgm = "day_ambient";  // Initial
-    current_overlay = "";
-}
-
-World::~World() {
-    delete audio;
 }
 
 void World::load_tiles(const std::string& path) {
@@ -38,210 +30,277 @@ void World::load_tiles(const std::string& path) {
 }
 
 void World::load_map(const std::string& path) {
-    std::ifstream f(path);
-    nlohmann::json j;
-    j << f;
-
-    for (const auto& layer_entry : j["map"].items()) {
-        int layer = std::stoi(layer_entry.key());
-        if (layer >= NUM_MAP_LAYERS) continue;
-        for (int x = 0; x < WIDTH; ++x) {
-            for (int y = 0; y < HEIGHT; ++y) {
-                for (const auto& h_entry : layer_entry.value()[x][y]) {
-                    int h = h_entry["height"];
-                    std::string tile_id = h_entry["tile"];
-                    place_tile(layer, x, y, h, tile_id);
-                }
-            }
-        }
+    if (MapFile::is_map_file(path)) {
+        auto file = std::make_unique<MapFile>();
+        if (!file->open(path)) return;
+        fire.clear();
+        chunks.set_source(std::make_unique<MappedChunkSource>(std::move(file), tileset));
+        return;
     }
 
-    if (j.contains("biomes")) {
-        elev_map.resize(WIDTH);
-        moist_map.resize(WIDTH);
-        for (int x = 0; x < WIDTH; ++x) {
-            elev_map[x].resize(HEIGHT);
-            moist_map[x].resize(HEIGHT);
-            for (int y = 0; y < HEIGHT; ++y) {
-                elev_map[x][y] = j["biomes"]["elev"][x][y];
-                moist_map[x][y] = j["biomes"]["moist"][x][y];
+    MapData map;
+    if (!read_json_map(path, NUM_MAP_LAYERS, MAX_HEIGHT_LEVELS, map)) return;
+
+    std::vector<TileId> ids(map.tile_names.size(), EMPTY_TILE);
+    for (size_t i = 1; i < ids.size(); ++i) ids[i] = tileset.intern(map.tile_names[i]);
+
+    TileGrid grid(NUM_MAP_LAYERS, MAX_HEIGHT_LEVELS, map.width, map.height);
+    for (int l = 0; l < NUM_MAP_LAYERS; ++l) {
+        for (int h = 0; h < MAX_HEIGHT_LEVELS; ++h) {
+            for (int y = 0; y < map.height; ++y) {
+                for (int x = 0; x < map.width; ++x) grid.set(l, x, y, h, ids[map.cell(l, h, x, y)]);
             }
         }
     }
+    fire.clear();
+    chunks.set_source(std::make_unique<GridChunkSource>(std::move(grid), std::move(map.elev), std::move(map.moist)));
+}
+
+void World::generate_map(int width, int height, uint32_t seed) {
+    fire.clear();
+    chunks.set_source(std::make_unique<GeneratedChunkSource>(tileset, width, height, seed));
+}
+
+void World::prefetch(int x, int y) {
+    focus_x = x;
+    focus_y = y;
+    chunks.warm(x, y, CHUNK_RADIUS);
 }
 
 void World::place_tile(int map_layer, int x, int y, int height_level, const std::string& tile_id) {
-    if (map_layer >= 0 && map_layer < NUM_MAP_LAYERS && x >= 0 && x < WIDTH && y >= 0 && y < HEIGHT && height_level < MAX_HEIGHT_LEVELS) {
-        grid[map_layer][x][y][height_level] = tile_id;
+    // Cells outside the resident chunks are ignored
+    if (map_layer >= 0 && map_layer < NUM_MAP_LAYERS && chunks.in_bounds(x, y) && height_level >= 0 && height_level < MAX_HEIGHT_LEVELS) {
+        chunks.set(map_layer, x, y, height_level, tileset.intern(tile_id));
     }
 }
 
 bool World::can_move_to(int from_layer, int to_layer, int x, int y, int actor_height) {
     if (from_layer != to_layer) return has_connection(from_layer, to_layer, x, y);
+    const Chunk* chunk = chunks.find(ChunkCoord::of_tile(x, y));
+    if (!chunk || !chunks.in_bounds(x, y)) return false;  // Not paged in yet
 
     for (int h = 0; h < MAX_HEIGHT_LEVELS; ++h) {
-        auto it = grid[to_layer][x][y].find(h);
-        if (it != grid[to_layer][x][y].end() && it->second) {
-            const auto* tile = tileset.get(*it->second);
-            if (tile && h < tile->height_levels.size()) {
-                const auto& lev = tile->height_levels[h];
-                if (!lev.passable && actor_height <= lev.height) return false;
-            }
-        }
+        const auto& tile = tileset.hot_data(chunk->layers[to_layer].get(x - chunk->origin_x(), y - chunk->origin_y(), h));
+        if (h < tile.num_levels && !tile.passable(h) && actor_height <= tile.level_height[h]) return false;
     }
     return true;
 }
 
 bool World::has_connection(int from_layer, int to_layer, int x, int y) const {
-    auto it = grid[from_layer][x][y].find(0);
-    if (it != grid[from_layer][x][y].end() && it->second) {
-        const auto* tile = tileset.get(*it->second);
-        if (tile && tile->type == "bridge") {
-            for (int cl : tile->connects_layers) {
-                if (cl == to_layer) return true;
-            }
-        }
-    }
-    return false;
+    const auto& tile = tileset.hot_data(get_tile_id(from_layer, x, y, 0));
+    return tile.type == TileType::BRIDGE && tile.connects_to(to_layer);
 }
 
 bool World::can_place_on_furniture(int layer, int x, int y) const {
-    auto it = grid[layer][x][y].find(0);
-    if (it != grid[layer][x][y].end() && it->second) {
-        const auto* tile = tileset.get(*it->second);
-        return tile && tile->supports_furniture;
-    }
-    return false;
+    return tileset.hot_data(get_tile_id(layer, x, y, 0)).has(TILE_SUPPORTS_FURNITURE);
 }
 
-void World::update(const Input& input) {
-    for (auto& actor : actors) {
-        if (input.is_key_down(SDLK_w)) actor.move(0, -1);
-        if (input.is_key_down(SDLK_s)) actor.move(0, 1);
-        if (input.is_key_down(SDLK_a)) actor.move(-1, 0);
-        if (input.is_key_down(SDLK_d)) actor.move(1, 0);
-        if (input.is_key_down(SDLK_PERIOD)) {  // Up
-            int new_layer = actor.current_map_layer + 1;
-            if (new_layer < NUM_MAP_LAYERS && has_connection(actor.current_map_layer, new_layer, actor.x, actor.y)) {
-                actor.move_z(1);
-            }
+SoundId World::update_actor(Actor& actor, const Input& input) const {
+    actor.prev_x = actor.x;
+    actor.prev_y = actor.y;
+    if (input.is_key_down(SDLK_w)) actor.move(0, -1);
+    if (input.is_key_down(SDLK_s)) actor.move(0, 1);
+    if (input.is_key_down(SDLK_a)) actor.move(-1, 0);
+    if (input.is_key_down(SDLK_d)) actor.move(1, 0);
+    if (input.is_key_down(SDLK_PERIOD)) {  // Up
+        int new_layer = actor.current_map_layer + 1;
+        if (new_layer < NUM_MAP_LAYERS && has_connection(actor.current_map_layer, new_layer, actor.x, actor.y)) {
+            actor.move_z(1);
         }
-        if (input.is_key_down(SDLK_COMMA)) {  // Down
-            int new_layer = actor.current_map_layer - 1;
-            if (new_layer >= 0 && has_connection(actor.current_map_layer, new_layer, actor.x, actor.y)) {
-                actor.move_z(-1);
-            }
+    }
+    if (input.is_key_down(SDLK_COMMA)) {  // Down
+        int new_layer = actor.current_map_layer - 1;
+        if (new_layer >= 0 && has_connection(actor.current_map_layer, new_layer, actor.x, actor.y)) {
+            actor.move_z(-1);
         }
+    }
+    actor.regen_mana(1);
+
+    // Footsteps
+    TileId tile = get_tile_id(actor.current_map_layer, actor.x, actor.y, 0);
+    return tile == EMPTY_TILE ? NO_SOUND : footstep_sounds[tile];
+}
 
-        // Footsteps
-        const auto* tile = get_tile(actor.current_map_layer, actor.x, actor.y, 0);
-        if (tile) {
-            std::string sfx = "footstep_" + tile->type;
-            audio->play_sfx(sfx, 80, actor.x / 50.0f - 0.5f, 1.0f);
+void World::update_region(ChunkCoord region, const EffectWindow& window, uint32_t seed, bool raining, RegionSpawns& out) {
+    Chunk* chunk = chunks.find(region);
+    if (!chunk) return;
+    // Same 5-tile sampling grid as the whole window, clipped to this chunk
+    auto first = [](int lo, int origin) { int v = std::max(lo, origin); return v + ((lo - v) % 5 + 5) % 5; };
+    int cx1 = std::min(window.x1, chunk->origin_x() + CHUNK_SIZE), cy1 = std::min(window.y1, chunk->origin_y() + CHUNK_SIZE);
+    for (int y = first(window.y0, chunk->origin_y()); y < cy1; y += 5) {
+        for (int x = first(window.x0, chunk->origin_x()); x < cx1; x += 5) {
+            int lx = x - chunk->origin_x(), ly = y - chunk->origin_y();
+            if (raining && hash01(seed, x, y, 0) < 0.1f) {  // Splashes/wetness
+                out.splashes.push_back({x, y, 3 + static_cast<int>(hash01(seed, x, y, 1) * 4)});
+                chunk->add_wetness(1, lx, ly, 1, 20);  // Ground layer; weather alone doesn't make a chunk dirty
+            }
+            // Grass sway on wind (for wind_sway tiles such as grass_wispy)
+            if (tileset.hot_data(chunk->layers[1].get(lx, ly, 0)).has(TILE_WIND_SWAY) && hash01(seed, x, y, 2) < 0.2f) {  // Ground
+                out.grass.push_back({x, y, 10});
+            }
         }
+    }
+}
 
-        actor.regen_mana(1);
+void World::update(const Input& input, float dt) {
+    auto mark = std::chrono::steady_clock::now();
+    auto lap = [&mark](float& phase) {  // Time since the last lap into phase
+        auto now = std::chrono::steady_clock::now();
+        phase = std::chrono::duration<float, std::milli>(now - mark).count();
+        mark = now;
+    };
+
+    if (!actors.empty()) {
+        focus_x = actors[0].x;
+        focus_y = actors[0].y;
     }
+    chunks.update(focus_x, focus_y, CHUNK_RADIUS);
+    lap(timings.paging);
 
-    float dt = 1.0f / 60.0f;
     float wind = 0.0f;
     if (current_weather == Weather::RAIN || current_weather == Weather::SNOW) wind = std::uniform_real_distribution<float>(-1,1)(gen);
-    for (auto& emitter : fire_emitters) emitter.update(dt);
-    for (auto& emitter : smoke_emitters) emitter.update(dt, wind);
-    for (auto& emitter : rain_emitters) emitter.update(dt, wind, 1.0f);
-    for (auto& emitter : snow_emitters) emitter.update(dt, wind);
-    for (auto& emitter : splash_emitters) emitter.update(dt);
-    for (auto& emitter : spark_emitters) emitter.update(dt);
-    for (auto& emitter : fog_emitters) emitter.update(dt);
-    for (auto& emitter : grass_emitters) emitter.update(dt, wind);
-
-    // Weather integration
+    uint32_t tick_seed = gen();  // Jobs take their randomness from this, never from gen
+
+    // Weather integration; emitters are added and removed before anything runs in parallel
     if (current_weather == Weather::RAIN) {
-        if (rain_emitters.empty()) rain_emitters.emplace_back(800, 600, 1.0f);
-        for (auto& emitter : rain_emitters) emitter.update(dt, wind, 1.0f);
-
-        // Splashes/wetness
-        for (int x = 0; x < WIDTH; x += 5) {
-            for (int y = 0; y < HEIGHT; y += 5) {
-                if (std::uniform_real_distribution<float>(0,1)(gen) < 0.1) {
-                    SDL_FPoint hit_pos = {static_cast<float>(x * 32), static_cast<float>(y * 16)};
-                    SplashEmitter splash(hit_pos);
-                    splash.spawn_splash(3 + std::uniform_int_distribution<int>(0,3)(gen));
-                    splash_emitters.push_back(splash);
-                    add_wetness(1, x, y, 1);  // Ground layer
-                }
-            }
-        }
-        audio->play_overlay("rain_patter", 40, true);
+        if (rain_emitters.empty()) rain_emitters.emplace_back(particles, 800, 600, 1.0f);
     } else if (current_weather == Weather::SNOW) {
-        if (snow_emitters.empty()) snow_emitters.emplace_back(800, 600, 0.7f);
-        for (auto& emitter : snow_emitters) emitter.update(dt, wind);
-        audio->play_overlay("snow_wind", 30, true);
+        if (snow_emitters.empty()) snow_emitters.emplace_back(particles, 800, 600, 0.7f);
     } else {
         rain_emitters.clear();
         snow_emitters.clear();
-        audio->stop_overlay("rain_patter");
-        audio->stop_overlay("snow_wind");
     }
 
     // Fog on low/night/biomes
     int check_layer = actors.empty() ? 1 : actors[0].current_map_layer;
     if (check_layer < 2 || game_time > 20 || game_time < 4) {
-        std::string biome = get_biome_at(check_layer, 25, 25);  // Avg
+        std::string biome = get_biome_at(check_layer, focus_x, focus_y);
         float fog_int = (biome == "swamp" ? 1.5f : 1.0f);
         if (fog_emitters.empty()) {
             SDL_FPoint fog_pos = {400, 300};
-            FogEmitter fog(fog_pos, fog_int);
-            fog_emitters.push_back(fog);
+            fog_emitters.emplace_back(particles, fog_pos, fog_int);
         }
-        for (auto& emitter : fog_emitters) emitter.update(dt);
     } else {
         fog_emitters.clear();
     }
 
-    // Grass sway on wind (for grass_wispy tiles)
-    for (int x = 0; x < WIDTH; x += 5) {
-        for (int y = 0; y < HEIGHT; y += 5) {
-            const auto* tile = get_tile(1, x, y, 0);  // Ground
-            if (tile && tile->id == "grass_wispy" && std::uniform_real_distribution<float>(0,1)(gen) < 0.2) {
-                SDL_FPoint grass_pos = {static_cast<float>(x * 32), static_cast<float>(y * 16)};
-                GrassSwayEmitter grass(grass_pos, 10);
-                grass_emitters.push_back(grass);
-            }
+    // Fire: a few random cells near the player may catch when it's dry, then the burning frontier spreads
+    if (current_weather == Weather::CLEAR) {
+        std::uniform_int_distribution<int> offset(-EFFECT_RADIUS, EFFECT_RADIUS);
+        for (int i = 0; i < 2; ++i) {
+            int layer = std::uniform_int_distribution<int>(0, NUM_MAP_LAYERS - 1)(gen);
+            if (dis(gen) < 0.001f) fire.ignite(layer, focus_x + offset(gen), focus_y + offset(gen), gen);
         }
     }
-    for (auto& emitter : grass_emitters) emitter.update(dt, wind);
 
-    // Fire spread
-    std::queue<std::tuple<int, int, int>> spread_queue;
-    for (int l = 0; l < NUM_MAP_LAYERS; ++l) {
-        for (int x = 0; x < WIDTH; ++x) {
-            for (int y = 0; y < HEIGHT; ++y) {
-                const auto* tile = get_tile(l, x, y, 0);
-                if (tile && tile->flammability > 0 && std::uniform_real_distribution<float>(0,1)(gen) < 0.1 * (1 - tile_wetness[l][x][y]/10.0f)) {
-                    spread_queue.push({l, x, y});
-                }
-            }
-        }
+    if (footstep_sounds.size() != tileset.size()) {  // One handle per tile, so actors never build names
+        footstep_sounds.assign(tileset.size(), NO_SOUND);
+        for (TileId id = 1; id < tileset.size(); ++id) footstep_sounds[id] = audio->sound("footstep_" + tileset.cold_data(id).type);
     }
-    while (!spread_queue.empty()) {
-        auto [l, x, y] = spread_queue.front(); spread_queue.pop();
-        for (auto [dx, dy] : {{0,1},{1,0},{0,-1},{-1,0}}) {
-            int nx = x + dx, ny = y + dy;
-            if (nx >= 0 && nx < WIDTH && ny >= 0 && ny < HEIGHT) {
-                const auto* nt = get_tile(l, nx, ny, 0);
-                if (nt && nt->flammability > 50 && std::uniform_real_distribution<float>(0,1)(gen) < 0.3) {
-                    SDL_FPoint fire_pos = {static_cast<float>(nx * 32), static_cast<float>(ny * 16)};
-                    FireEmitter new_fire(fire_pos, 1);
-                    fire_emitters.push_back(new_fire);
-                    spread_queue.push({l, nx, ny});
-                }
-            }
-        }
+
+    // The tick graph. Emitters, actors and the per-chunk weather passes are
+    // independent; the fire waits for wetness and for its own emitters. Anything
+    // spawned is collected per actor/region and merged below in that order.
+    JobGraph graph;
+    std::vector<SoundId> footsteps(actors.size());
+    graph.parallel_for(actors.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) footsteps[i] = update_actor(actors[i], input);
+    });
+
+    // A job per particle kind: its emitters spawn, then the kind's pool steps in one pass
+    auto update_kind = [&graph, this, dt, wind](auto& emitters, ParticleKind kind) {
+        graph.add([&emitters, kind, this, dt, wind] {
+            for (auto& e : emitters) e.update(dt);
+            particles.step(kind, wind);
+        });
+    };
+    update_kind(smoke_emitters, ParticleKind::SMOKE);
+    update_kind(rain_emitters, ParticleKind::RAIN);
+    update_kind(snow_emitters, ParticleKind::SNOW);
+    update_kind(splash_emitters, ParticleKind::SPLASH);
+    update_kind(spark_emitters, ParticleKind::SPARK);
+    update_kind(fog_emitters, ParticleKind::FOG);
+    update_kind(grass_emitters, ParticleKind::GRASS);
+    JobGraph::JobId fire_emitters = graph.add([this, dt] { fire.update_emitters(dt); });
+
+    EffectWindow window = {std::max(0, focus_x - EFFECT_RADIUS), std::max(0, focus_y - EFFECT_RADIUS),
+                           std::min(width(), focus_x + EFFECT_RADIUS), std::min(height(), focus_y + EFFECT_RADIUS)};
+    std::vector<ChunkCoord> regions;
+    for (int cy = ChunkCoord::floor_div(window.y0); cy <= ChunkCoord::floor_div(window.y1 - 1); ++cy) {
+        for (int cx = ChunkCoord::floor_div(window.x0); cx <= ChunkCoord::floor_div(window.x1 - 1); ++cx) regions.push_back({cx, cy});
+    }
+    std::vector<RegionSpawns> spawns(regions.size());
+    bool raining = current_weather == Weather::RAIN;
+    JobGraph::JobId weather = graph.parallel_for(regions.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t r = begin; r < end; ++r) update_region(regions[r], window, tick_seed, raining, spawns[r]);
+    });
+    fire.schedule(graph, dt, tick_seed, {weather, fire_emitters});
+
+    jobs.run(graph);
+
+    // Deterministic merge
+    for (size_t i = 0; i < actors.size(); ++i) {
+        if (footsteps[i] == NO_SOUND) continue;
+        // Pan by where the actor is on screen relative to the focus; iso screen x goes with x - y
+        int across = (actors[i].x - focus_x) - (actors[i].y - focus_y);
+        audio->play_sfx(footsteps[i], 80, std::clamp(across / static_cast<float>(EFFECT_RADIUS), -1.0f, 1.0f), 1.0f);
+    }
+    for (const auto& region : spawns) {
+        for (const auto& s : region.splashes) splash_emitters.emplace_back(particles, grid_to_world(s.x, s.y)).spawn_splash(s.count);
+        for (const auto& s : region.grass) grass_emitters.emplace_back(particles, grid_to_world(s.x, s.y), s.count);
     }
+    lap(timings.tick);
 
-    if (!fire_emitters.empty()) audio->play_overlay("fire_crackle", 60, true);
-    else audio->stop_overlay("fire_crackle");
+    // Sight: a viewer per actor, recast only where it moved or the map changed
+    while (actor_viewers.size() > actors.size()) {
+        vision.remove_viewer(actor_viewers.back());
+        actor_viewers.pop_back();
+    }
+    for (size_t i = 0; i < actors.size(); ++i) {
+        const Actor& a = actors[i];
+        if (i == actor_viewers.size()) actor_viewers.push_back(vision.add_viewer(a.current_map_layer, a.x, a.y));
+        else vision.move_viewer(actor_viewers[i], a.current_map_layer, a.x, a.y);
+    }
+    vision.update(jobs);
+    lap(timings.vision);
+
+    // Ambient: the time-of-day tint (percent per channel) plus moonlight at night
+    std::array<int, 3> tint = get_tint_color();
+    LightSource moon = get_moonlight();
+    float hour = fmod(game_time, 24.0f);
+    float moon_level = hour < 6 || hour > 18 ? moon.intensity / 100.0f : 0.0f;
+    std::array<float, 3> ambient;
+    for (int c = 0; c < 3; ++c) ambient[c] = std::min(1.0f, tint[c] / 100.0f + moon_level * moon.color[c] / 255.0f);
+    lightmap.set_ambient(ambient);
+    lightmap.update(fire);
+    lap(timings.lighting);
+
+    // Ambient beds layer over the day/night one; only changes reach the audio thread
+    if (current_weather == Weather::RAIN) audio->set_ambient(AmbientLayer::WEATHER, rain_track, 0.3f);
+    else if (current_weather == Weather::SNOW) audio->set_ambient(AmbientLayer::WEATHER, snow_track, 0.25f);
+    else audio->set_ambient(AmbientLayer::WEATHER, NO_SOUND);
+    size_t burning = fire.burning_count();
+    audio->set_ambient(AmbientLayer::FIRE, burning > 0 ? fire_track : NO_SOUND, std::min(0.6f, 0.2f + burning / 100.0f), 1.0f);
+    audio->update();
+    lap(timings.audio);
+
+    balance_particles();
+    lap(timings.particles);
+}
+
+void World::balance_particles() {
+    particle_budget.begin_frame(grid_to_world(focus_x, focus_y));
+    for_each_emitter([this](ParticleEmitter& emitter) { particle_budget.add(emitter); });
+    particle_budget.end_frame();
+    particles.cull();
+
+    // Splashes, sparks and grass never spawn again once their burst is gone
+    auto drop_empty = [](auto& emitters) {
+        emitters.erase(std::remove_if(emitters.begin(), emitters.end(), [](const auto& e) { return e.particle_count() == 0; }), emitters.end());
+    };
+    drop_empty(splash_emitters);
+    drop_empty(spark_emitters);
+    drop_empty(grass_emitters);
 }
 
 std::array<int, 3> World::get_tint_color() const {
@@ -264,30 +323,12 @@ LightSource World::get_moonlight() const {
 }
 
 void World::update_time(float dt) {
-    auto now = std::chrono::steady_clock::now();
-    float real_dt = std::chrono::duration<float>(now - start_time).count() / 60.0f;
-    game_time += real_dt / 60.0f * 24.0f;
+    game_time += dt / 3600.0f * 24.0f;  // A day an hour, in simulated time only
     game_time = fmod(game_time, 24.0f);
-    start_time = now;
     moon_phase = (moon_phase + 1) % 29;
 
     float hour = fmod(game_time, 24.0f);
-    std::string new_bgm;
-    if (hour < 6 || hour > 18) new_bgm = "night_ambient";
-    else new_bgm = "day_ambient";
-    if (new_bgm != current_bgm) {
-        audio->crossfade_bgm(new_bgm, 3000);
-        current_bgm = new_bgm;
-    }
-
-    std::string overlay;
-    if (current_weather == Weather::RAIN) overlay = "rain_patter";
-    else if (current_weather == Weather::SNOW) overlay = "snow_wind";
-    else overlay = "";
-    if (overlay != current_overlay) {
-        audio->play_overlay(overlay, 40, true);
-        current_overlay = overlay;
-    }
+    audio->set_ambient(AmbientLayer::BGM, hour < 6 || hour > 18 ? night_track : day_track, 0.45f, 3.0f);
 
     if (current_weather == Weather::RAIN && std::uniform_real_distribution<float>(0,1)(gen) < 0.02) {
         strike_lightning();
@@ -298,8 +339,11 @@ void World::update_time(float dt) {
 
 std::string World::get_biome_at(int layer, int x, int y) const {
     if (layer < 1 || layer > 2) return "none";
-    float elev = elev_map[x][y];
-    float moist = moist_map[x][y];
+    const Chunk* chunk = chunks.find(ChunkCoord::of_tile(x, y));
+    if (!chunk || chunk->elev.empty()) return "none";
+    int i = (y - chunk->origin_y()) * CHUNK_SIZE + (x - chunk->origin_x());
+    float elev = chunk->elev[i];
+    float moist = chunk->moist[i];
     if (elev > 0.7) return "mountain";
     if (moist > 0.7) return "swamp";
     if (moist < 0.3 && elev < 0.3) return "desert";
@@ -308,27 +352,37 @@ std::string World::get_biome_at(int layer, int x, int y) const {
 }
 
 void World::add_wetness(int layer, int x, int y, int amount) {
-    if (layer >= 0 && layer < NUM_MAP_LAYERS && x >= 0 && x < WIDTH && y >= 0 && y < HEIGHT) {
-        tile_wetness[layer][x][y] += amount;
-        tile_wetness[layer][x][y] = std::min(20, tile_wetness[layer][x][y]);
+    if (layer < 0 || layer >= NUM_MAP_LAYERS) return;
+    Chunk* chunk = chunks.find(ChunkCoord::of_tile(x, y));
+    if (chunk) {
+        chunk->add_wetness(layer, x - chunk->origin_x(), y - chunk->origin_y(), amount, 20);
     }
 }
 
+int World::get_wetness(int layer, int x, int y) const {
+    const Chunk* chunk = chunks.find(ChunkCoord::of_tile(x, y));
+    return chunk ? chunk->get_wetness(layer, x - chunk->origin_x(), y - chunk->origin_y()) : 0;
+}
+
 void World::strike_lightning() {
     lightning_flash_timer = 1.0f;
-    audio->play_sfx("thunder", 100);
+    audio->play_sfx(thunder_sound, 100);
+    audio->duck_ambient(AmbientLayer::BGM, 0.3f, 1.5f);
+    audio->duck_ambient(AmbientLayer::WEATHER, 0.6f, 1.5f);
+
+    int rx = focus_x + std::uniform_int_distribution<int>(-EFFECT_RADIUS, EFFECT_RADIUS)(gen);
+    int ry = focus_y + std::uniform_int_distribution<int>(-EFFECT_RADIUS, EFFECT_RADIUS)(gen);
+    SDL_FPoint strike_pos = grid_to_world(rx, ry);
+    spark_emitters.emplace_back(particles, strike_pos, 100);
+    fire.ignite(1, rx, ry, gen);  // Ground layer; usually too wet to catch in the rain
+}
 
-    int rx = std::uniform_int_distribution<int>(0, WIDTH-1)(gen);
-    int ry = std::uniform_int_distribution<int>(0, HEIGHT-1)(gen);
-    SDL_FPoint strike_pos = {static_cast<float>(rx * 32), static_cast<float>(ry * 16)};
-    SparkEmitter sparks(strike_pos, 100);
-    spark_emitters.push_back(sparks);
+TileId World::get_tile_id(int layer, int x, int y, int h) const {
+    if (layer < 0 || layer >= NUM_MAP_LAYERS || h < 0 || h >= MAX_HEIGHT_LEVELS) return EMPTY_TILE;
+    return chunks.get(layer, x, y, h);  // EMPTY_TILE while the chunk is paged out
 }
 
 const Tile* World::get_tile(int layer, int x, int y, int h) const {
-    auto it = grid[layer][x][y].find(h);
-    if (it != grid[layer][x][y].end() && it->second) {
-        return tileset.get(*it->second);
-    }
-    return nullptr;
+    TileId id = get_tile_id(layer, x, y, h);
+    return id != EMPTY_TILE ? tileset.get(id) : nullptr;
 }
@@ -2,34 +2,48 @@
 #define WORLD_H
 
 #include <array>
-#include <optional>
 #include <string>
 #include <vector>
-#include <map>
 #include <random>  // For np.random stub
 #include "actor.h"
 #include "tiles.h"
+#include "chunk.h"
+#include "fire.h"
+#include "lightmap.h"
+#include "vision.h"
+#include "../engine/audio_sink.h"
+#include "../engine/jobs.h"
 #include "../engine/particles.h"  // All emitters
 #include <nlohmann/json.hpp>
-#include <chrono>
 
 // Forward declarations
-class AudioManager;
 class Input;
 
 class World {
 public:
-    static constexpr int NUM_MAP_LAYERS = 6;
-    static constexpr int WIDTH = 50, HEIGHT = 50;
-    static constexpr int MAX_HEIGHT_LEVELS = 3;
+    static constexpr int NUM_MAP_LAYERS = CHUNK_LAYERS;
+    static constexpr int MAX_HEIGHT_LEVELS = CHUNK_HEIGHTS;
+    static constexpr int CHUNK_RADIUS = 2;  // Chunks kept resident around the player, each way
+    static constexpr int EFFECT_RADIUS = 25;  // Tiles around the player that spawn weather/grass effects
 
     enum class Weather { CLEAR, RAIN, SNOW };
+    // Wall time of each phase of the last update(), in milliseconds
+    struct UpdateTimings {
+        float paging = 0.0f;  // ChunkCache::update
+        float tick = 0.0f;  // The job graph: actors, emitters, weather, fire; and the merge after it
+        float vision = 0.0f, lighting = 0.0f, audio = 0.0f, particles = 0.0f;
+    };
 private:
     Weather current_weather = Weather::CLEAR;
-    std::array<std::vector<std::vector<std::map<int, std::optional<std::string>>>>, NUM_MAP_LAYERS> grid;
+    ChunkCache chunks;  // Resident part of the map, paged around the player
+    int focus_x = 0, focus_y = 0;  // Paging centre, follows the first actor
     std::vector<Actor> actors;
     Tiles tileset;
-    std::vector<FireEmitter> fire_emitters;
+    ParticleStore particles;  // Before every emitter, which hold slots in it
+    FireSystem fire{chunks, tileset, particles};
+    LightMap lightmap{chunks, tileset};
+    Vision vision{chunks, tileset};
+    std::vector<ViewerId> actor_viewers;  // Parallel to actors
     std::vector<SmokeEmitter> smoke_emitters;
     std::vector<RainEmitter> rain_emitters;
     std::vector<SnowEmitter> snow_emitters;
@@ -37,27 +51,57 @@ private:
     std::vector<SparkEmitter> spark_emitters;
     std::vector<FogEmitter> fog_emitters;
     std::vector<GrassSwayEmitter> grass_emitters;
-    AudioManager* audio;
+    ParticleBudget particle_budget;
+    mutable JobSystem jobs;  // Also lends its threads to const readers such as the renderer
+    NullAudio null_audio;
+    AudioSink* audio;  // Not owned; null_audio unless one was given
+    std::vector<SoundId> footstep_sounds;  // By TileId, resolved when the tileset changes
+    SoundId thunder_sound = NO_SOUND;
+    SoundId day_track = NO_SOUND, night_track = NO_SOUND, rain_track = NO_SOUND, snow_track = NO_SOUND, fire_track = NO_SOUND;
 
     float game_time = 0.0f;
     int moon_phase = 0;
-    std::chrono::steady_clock::time_point start_time;
     float lightning_flash_timer = 0.0f;
-    std::vector<std::vector<std::vector<int>>> tile_wetness;  // [layer][x][y]
-    std::vector<std::vector<float>> elev_map, moist_map;  // For biomes
-    std::string current_bgm = "";
-    std::string current_overlay = "";
+    UpdateTimings timings;
+
+    void balance_particles();  // Budget pass over every emitter, then drop the empty one-shot ones
+    template <typename Self, typename Fn> static void visit_emitters(Self& self, Fn& fn) {
+        self.fire.for_each_emitter(fn);
+        for (auto& e : self.smoke_emitters) fn(e);
+        for (auto& e : self.rain_emitters) fn(e);
+        for (auto& e : self.snow_emitters) fn(e);
+        for (auto& e : self.splash_emitters) fn(e);
+        for (auto& e : self.spark_emitters) fn(e);
+        for (auto& e : self.fog_emitters) fn(e);
+        for (auto& e : self.grass_emitters) fn(e);
+    }
+
+    // Parallel parts of update(); see the job graph there
+    struct EffectWindow {
+        int x0, y0, x1, y1;  // Tiles around the player that get weather/grass effects
+    };
+    struct EffectSpawn {
+        int x, y, count;
+    };
+    struct RegionSpawns {
+        std::vector<EffectSpawn> splashes, grass;
+    };
+    SoundId update_actor(Actor& actor, const Input& input) const;  // Returns the footstep sound, or NO_SOUND
+    void update_region(ChunkCoord region, const EffectWindow& window, uint32_t seed, bool raining, RegionSpawns& out);
 
 public:
-    World();
-    ~World();
+    explicit World(AudioSink* sink = nullptr);  // No sink plays nothing, e.g. headless
     void load_tiles(const std::string& path);
     void load_map(const std::string& path);
+    void generate_map(int width, int height, uint32_t seed);  // Procedural, paged in as the player moves
+    void prefetch(int x, int y);  // Blocking load around (x, y), e.g. before the first frame
+    int width() const { return chunks.width(); }
+    int height() const { return chunks.height(); }
     void place_tile(int map_layer, int x, int y, int height_level, const std::string& tile_id);
     bool can_move_to(int from_layer, int to_layer, int x, int y, int actor_height);
     bool has_connection(int from_layer, int to_layer, int x, int y) const;
     bool can_place_on_furniture(int layer, int x, int y) const;
-    void update(const Input& input);
+    void update(const Input& input, float dt);  // One fixed simulation step
     void update_time(float dt);
     void set_weather(Weather w) { current_weather = w; }
     Weather get_weather() const { return current_weather; }
@@ -66,8 +110,24 @@ public:
     LightSource get_moonlight() const;
     std::string get_biome_at(int layer, int x, int y) const;
     void add_wetness(int layer, int x, int y, int amount = 1);
+    int get_wetness(int layer, int x, int y) const;
     void strike_lightning();
-    const auto& get_layer(int l) const { return grid[l]; }
+    FireSystem& get_fire() { return fire; }
+    LightMap& get_lightmap() { return lightmap; }
+    const LightMap& get_lightmap() const { return lightmap; }
+    Vision& get_vision() { return vision; }
+    const Vision& get_vision() const { return vision; }
+    ViewerId player_viewer() const { return actor_viewers.empty() ? NO_VIEWER : actor_viewers[0]; }
+    ParticleBudget& get_particle_budget() { return particle_budget; }
+    const ParticleStore& get_particles() const { return particles; }
+    // Every particle emitter: fire, weather, splashes, sparks and grass
+    template <typename Fn> void for_each_emitter(Fn&& fn) { visit_emitters(*this, fn); }
+    template <typename Fn> void for_each_emitter(Fn&& fn) const { visit_emitters(*this, fn); }
+    JobSystem& get_jobs() const { return jobs; }
+    AudioSink& get_audio() { return *audio; }
+    const UpdateTimings& last_timings() const { return timings; }
+    const ChunkCache& get_chunks() const { return chunks; }
+    TileId get_tile_id(int layer, int x, int y, int h) const;
     std::vector<Actor>& get_actors() { return actors; }
     const Tiles& get_tileset() const { return tileset; }
     const Tile* get_tile(int layer, int x, int y, int h) const;
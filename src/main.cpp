@@ -2,33 +2,60 @@
 #include <SDL3_image/SDL_image.h>
 #include "engine/renderer.h"
 #include "engine/input.h"
+#include "engine/audio.h"
+#include "engine/fixed_timestep.h"
 #include "game/world.h"
 #include "game/items.h"
 #include "engine/utils/log.h"
+#include <cstdlib>
+#include <filesystem>
+#include <string>
 
 // Forward declare Input class for world.update
 class Input;
 
 int main(int argc, char* argv[]) {
+    FixedTimestep::Settings timing;
+    int generate_size = 0;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--generate" && i + 1 < argc) generate_size = std::atoi(argv[++i]);  // Procedural size x size map, paged in chunks
+        else if (arg == "--vsync") timing.vsync = true;
+        else if (arg == "--fps-limit" && i + 1 < argc) timing.fps_limit = std::atof(argv[++i]);
+    }
+
     SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO);
     SDL_Window* window = SDL_CreateWindow("Cataclysm RPG", 800, 600, 0);
     SDL_Renderer* renderer = SDL_CreateRenderer(window, nullptr);
 
     Renderer engine_renderer(renderer);
     Input input;
-    World world;
+    AudioManager audio;
+    World world(&audio);
     Items items_db;
 
     world.load_tiles("assets/data/tilesets.json");
-    world.load_map("assets/data/map.json");
+    audio.load_manifest("assets/data/audio.json");  // Decodes on worker threads while the map loads
+    engine_renderer.load_particle_atlas("assets/data/particles.json");  // Written by tools/generate_data.py
+    if (generate_size > 0) {
+        world.generate_map(generate_size, generate_size, 42);
+    } else if (std::filesystem::exists("assets/data/map.cmap")) {
+        world.load_map("assets/data/map.cmap");  // Memory-mapped, paged on demand
+    } else {
+        world.load_map("assets/data/map.json");
+    }
     items_db.load_from_json("assets/data/items.json");
 
     Actor& player = world.get_actors().emplace_back();
     player.x = 25; player.y = 25; player.current_map_layer = 1;
+    world.prefetch(player.x, player.y);
+    AudioLoadProgress audio_progress = audio.load_progress();
+    SDL_Log("Audio: %zu of %zu files ready", audio_progress.done, audio_progress.total);
 
+    // Fixed simulation steps; rendering as fast as vsync or the limiter allow, between the last two steps
+    FixedTimestep clock(timing);
+    clock.apply_vsync(renderer);
     bool running = true;
-    float dt = 1.0f / 60.0f;
-    float time = 0.0f;
     while (running) {
         SDL_Event event;
         while (SDL_PollEvent(&event)) {
@@ -36,13 +63,15 @@ int main(int argc, char* argv[]) {
             input.handle_event(event);
         }
 
-        world.update(input);
-        world.update_time(dt);
-        engine_renderer.update_camera(player.x, player.y);
-        engine_renderer.render_world(world, player.current_map_layer, time);
-
-        time += dt;
-        SDL_Delay(16);
+        int steps = clock.begin_frame();
+        for (int i = 0; i < steps; ++i) {
+            world.update(input, clock.step());
+            world.update_time(clock.step());
+        }
+        float alpha = clock.alpha(), lag = clock.lag();
+        engine_renderer.update_camera(player.draw_x(alpha), player.draw_y(alpha));
+        engine_renderer.render_world(world, player.current_map_layer, static_cast<float>(clock.sim_time()) - lag, lag);
+        clock.end_frame();
     }
 
     SDL_DestroyRenderer(renderer);
@@ -0,0 +1,452 @@
+// Microbenchmarks of the engine's hot paths on synthetic data. Tilesets, maps
+// (50x50 up to 2000x2000) and item lists are generated into a scratch
+// directory on first use, so results don't depend on the assets; drawing goes
+// to an offscreen software renderer. To compare two builds:
+//   cataclysm-bench --benchmark_out=before.json --benchmark_out_format=json
+//   (rebuild) cataclysm-bench --benchmark_out=after.json --benchmark_out_format=json
+//   compare.py benchmarks before.json after.json  # From Google Benchmark's tools
+#include <benchmark/benchmark.h>
+#include <unistd.h>  // getpid
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "../engine/input.h"
+#include "../engine/lighting.h"
+#include "../engine/particles.h"
+#include "../engine/renderer.h"
+#include "../game/items.h"
+#include "../game/map_file.h"
+#include "../game/world.h"
+
+namespace {
+
+namespace fs = std::filesystem;
+
+constexpr int VIEW_W = 1280, VIEW_H = 720;  // Offscreen target
+constexpr float STEP = 1.0f / 60.0f;  // The game's fixed step
+constexpr int LOOKUPS = 1024;  // Per iteration of the lookup benchmarks
+
+const fs::path& scratch_dir() {
+    static const fs::path dir = [] {
+        fs::path d = fs::temp_directory_path() / ("cataclysm-bench-" + std::to_string(getpid()));
+        fs::create_directories(d);
+        return d;
+    }();
+    return dir;
+}
+
+void write_json(const fs::path& path, const nlohmann::json& j) {
+    std::ofstream f(path);
+    f << j;
+}
+
+// Ground that burns, trees and walls that cast shadows, plus extra plain tiles
+// to grow the id table
+const std::string& tileset_path(int extra = 0) {
+    static std::map<int, std::string> written;
+    auto it = written.find(extra);
+    if (it != written.end()) return it->second;
+
+    auto tile = [](const std::string& id, const std::string& type, int flammability, bool opaque) {
+        nlohmann::json level = {{"height", 0}, {"passable", !opaque}, {"transparent", !opaque},
+                                {"views", {{"default", id + ".png"}}}};
+        return nlohmann::json{{"id", id}, {"type", type}, {"flammability", flammability},
+                              {"blocks_sight", opaque}, {"height_levels", {level}}};
+    };
+    nlohmann::json tiles = nlohmann::json::array();
+    tiles.push_back(tile("grass", "ground", 30, false));
+    tiles.push_back(tile("dirt", "ground", 0, false));
+    tiles.push_back(tile("tree", "vegetation", 80, true));
+    tiles.push_back(tile("wall", "structure", 0, true));
+    for (int i = 0; i < extra; ++i) tiles.push_back(tile("filler_" + std::to_string(i), "ground", 0, false));
+
+    fs::path path = scratch_dir() / ("tiles_" + std::to_string(extra) + ".json");
+    write_json(path, {{"tiles", tiles}});
+    return written.emplace(extra, path.string()).first->second;
+}
+
+// Grass and dirt on layer 1 with scattered trees and the corners of rooms
+// every 24 tiles, the same for a given size
+MapData synthetic_map(int size) {
+    MapData map;
+    map.width = map.height = size;
+    map.layers = World::NUM_MAP_LAYERS;
+    map.heights = World::MAX_HEIGHT_LEVELS;
+    map.tile_names = {"", "grass", "dirt", "tree", "wall"};
+    map.cells.assign(static_cast<size_t>(map.layers) * map.heights * size * size, 0);
+    std::mt19937 rng(size);
+    std::uniform_int_distribution<int> roll(0, 99);
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            int r = roll(rng);
+            bool wall = (x % 24 == 0 && y % 24 < 8) || (y % 24 == 0 && x % 24 < 8);
+            map.cell(1, 0, x, y) = wall ? 4 : r < 8 ? 3 : r < 70 ? 1 : 2;
+        }
+    }
+    return map;
+}
+
+// map[layer][x][y] = [{height, tile}, ...], as read_json_map expects
+void write_json_map(const fs::path& path, const MapData& map) {
+    nlohmann::json columns = nlohmann::json::array();
+    for (int x = 0; x < map.width; ++x) {
+        nlohmann::json column = nlohmann::json::array();
+        for (int y = 0; y < map.height; ++y) {
+            nlohmann::json stack = nlohmann::json::array();
+            for (int h = 0; h < map.heights; ++h) {
+                uint16_t id = map.cells[((static_cast<size_t>(1) * map.heights + h) * map.height + y) * map.width + x];
+                if (id != 0) stack.push_back({{"height", h}, {"tile", map.tile_names[id]}});
+            }
+            column.push_back(std::move(stack));
+        }
+        columns.push_back(std::move(column));
+    }
+    write_json(path, {{"map", {{"1", std::move(columns)}}}});
+}
+
+const std::string& map_path(int size, bool json) {
+    static std::map<std::pair<int, bool>, std::string> written;
+    auto it = written.find({size, json});
+    if (it != written.end()) return it->second;
+
+    MapData map = synthetic_map(size);
+    fs::path path = scratch_dir() / ("map_" + std::to_string(size) + (json ? ".json" : ".cmap"));
+    if (json) write_json_map(path, map);
+    else write_map_file(path.string(), map);
+    return written.emplace(std::make_pair(size, json), path.string()).first->second;
+}
+
+// A loaded map with the player in the middle and the chunks around it resident
+std::unique_ptr<World> make_world(int size) {
+    auto world = std::make_unique<World>();
+    world->load_tiles(tileset_path());
+    world->load_map(map_path(size, false));
+    Actor& player = world->get_actors().emplace_back();
+    player.x = player.y = size / 2;
+    player.current_map_layer = 1;
+    world->prefetch(player.x, player.y);
+    return world;
+}
+
+struct Offscreen {
+    SDL_Surface* surface = SDL_CreateSurface(VIEW_W, VIEW_H, SDL_PIXELFORMAT_RGBA8888);
+    SDL_Renderer* renderer = surface ? SDL_CreateSoftwareRenderer(surface) : nullptr;
+    Offscreen() = default;
+    ~Offscreen() {
+        if (renderer) SDL_DestroyRenderer(renderer);
+        if (surface) SDL_DestroySurface(surface);
+    }
+    Offscreen(const Offscreen&) = delete;
+    Offscreen& operator=(const Offscreen&) = delete;
+};
+
+// Args: map size, binary (.cmap) or JSON. Timed through the first prefetch, so
+// the memory-mapped format pays for the paging it defers.
+void BM_LoadMap(benchmark::State& state) {
+    int size = static_cast<int>(state.range(0));
+    const std::string& path = map_path(size, state.range(1) == 0);
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto world = std::make_unique<World>();
+        world->load_tiles(tileset_path());
+        state.ResumeTiming();
+        world->load_map(path);
+        world->prefetch(size / 2, size / 2);
+        benchmark::DoNotOptimize(world->width());
+        state.PauseTiming();
+        world.reset();  // Joins the job threads
+        state.ResumeTiming();
+    }
+}
+// JSON past 500x500 takes gigabytes to parse; only the binary format goes to 2000
+BENCHMARK(BM_LoadMap)->ArgNames({"size", "binary"})->Unit(benchmark::kMillisecond)
+    ->Args({50, 0})->Args({200, 0})->Args({500, 0})
+    ->Args({50, 1})->Args({200, 1})->Args({500, 1})->Args({1000, 1})->Args({2000, 1});
+
+// Args: map size, cells kept burning, rain, actors
+void BM_WorldUpdate(benchmark::State& state) {
+    int size = static_cast<int>(state.range(0)), fires = static_cast<int>(state.range(1));
+    auto world = make_world(size);
+    if (state.range(2)) world->set_weather(World::Weather::RAIN);
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> near(-30, 30);
+    int centre = size / 2;
+    for (int i = 1; i < state.range(3); ++i) {
+        Actor& a = world->get_actors().emplace_back();
+        a.x = centre + near(rng);
+        a.y = centre + near(rng);
+        a.current_map_layer = 1;
+    }
+    FireSystem& fire = world->get_fire();
+    auto top_up = [&] {  // Fires burn out; keep the count steady between steps
+        for (int tries = 0; static_cast<int>(fire.burning_count()) < fires && tries < fires * 20; ++tries) {
+            fire.ignite(1, centre + near(rng), centre + near(rng), rng);
+        }
+    };
+    Input input;
+    top_up();
+    for (int i = 0; i < 60; ++i) world->update(input, STEP);  // Let emitters and viewers settle
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        top_up();
+        state.ResumeTiming();
+        world->update(input, STEP);
+    }
+    state.counters["burning"] = static_cast<double>(fire.burning_count());
+}
+BENCHMARK(BM_WorldUpdate)->ArgNames({"size", "fires", "rain", "actors"})->Unit(benchmark::kMillisecond)
+    ->ArgsProduct({{200, 2000}, {0, 64, 512}, {0, 1}, {1, 16, 128}});
+
+// Per emitter type, arg n scales it: intensity for the continuous ones, n * 8
+// particles for the one-shots
+template <typename E> E make_emitter(ParticleStore& store, int n);
+template <> FireEmitter make_emitter(ParticleStore& store, int n) { return FireEmitter(store, {VIEW_W / 2.0f, VIEW_H / 2.0f}, n); }
+template <> SmokeEmitter make_emitter(ParticleStore& store, int n) { return SmokeEmitter(store, {VIEW_W / 2.0f, VIEW_H / 2.0f}, n); }
+template <> RainEmitter make_emitter(ParticleStore& store, int n) { return RainEmitter(store, VIEW_W, VIEW_H, static_cast<float>(n)); }
+template <> SnowEmitter make_emitter(ParticleStore& store, int n) { return SnowEmitter(store, VIEW_W, VIEW_H, static_cast<float>(n)); }
+template <> SplashEmitter make_emitter(ParticleStore& store, int n) {
+    SplashEmitter e(store, {VIEW_W / 2.0f, VIEW_H / 2.0f});
+    e.spawn_splash(n * 8);
+    return e;
+}
+template <> SparkEmitter make_emitter(ParticleStore& store, int n) { return SparkEmitter(store, {VIEW_W / 2.0f, VIEW_H / 2.0f}, n * 8); }
+template <> FogEmitter make_emitter(ParticleStore& store, int n) { return FogEmitter(store, {VIEW_W / 2.0f, VIEW_H / 2.0f}, n); }
+template <> GrassSwayEmitter make_emitter(ParticleStore& store, int n) { return GrassSwayEmitter(store, {VIEW_W / 2.0f, VIEW_H / 2.0f}, n * 8); }
+
+// One-shots die out; start them again so every step has particles to move
+template <typename E> void keep_alive(ParticleStore& store, E& e, int n) {
+    if constexpr (std::is_same_v<E, SplashEmitter> || std::is_same_v<E, SparkEmitter>) {
+        if (e.particle_count() == 0) e = make_emitter<E>(store, n);
+    }
+}
+
+// An emitter's update plus its kind's step, as World runs them
+template <typename E> void step_emitter(ParticleStore& store, E& e) {
+    e.update(STEP);
+    store.step(e.get_kind());
+}
+
+template <typename E> E warm_emitter(ParticleStore& store, int n) {
+    E e = make_emitter<E>(store, n);
+    for (int i = 0; i < 180; ++i) {  // Continuous emitters reach their steady count
+        step_emitter(store, e);
+        keep_alive(store, e, n);
+    }
+    return e;
+}
+
+template <typename E> void BM_EmitterUpdate(benchmark::State& state) {
+    int n = static_cast<int>(state.range(0));
+    ParticleStore store;
+    E e = warm_emitter<E>(store, n);
+    size_t particles = 0;
+    for (auto _ : state) {
+        step_emitter(store, e);
+        particles += e.particle_count();
+        state.PauseTiming();
+        keep_alive(store, e, n);
+        state.ResumeTiming();
+    }
+    state.counters["particles"] = benchmark::Counter(static_cast<double>(particles), benchmark::Counter::kAvgIterations);
+}
+
+template <typename E> void BM_EmitterRender(benchmark::State& state) {
+    Offscreen out;
+    if (!out.renderer) {
+        state.SkipWithError(SDL_GetError());
+        return;
+    }
+    ParticleStore store;
+    E e = warm_emitter<E>(store, static_cast<int>(state.range(0)));
+    ParticleBatch batch;
+    for (auto _ : state) {
+        store.emit(e.get_kind(), batch);
+        batch.flush(out.renderer);
+        SDL_FlushRenderer(out.renderer);  // Rasterise now, inside the timing
+    }
+    state.counters["particles"] = static_cast<double>(e.particle_count());
+}
+
+#define EMITTER_BENCHMARKS(E) \
+    BENCHMARK_TEMPLATE(BM_EmitterUpdate, E)->RangeMultiplier(4)->Range(1, 16); \
+    BENCHMARK_TEMPLATE(BM_EmitterRender, E)->RangeMultiplier(4)->Range(1, 16)
+EMITTER_BENCHMARKS(FireEmitter);
+EMITTER_BENCHMARKS(SmokeEmitter);
+EMITTER_BENCHMARKS(RainEmitter);
+EMITTER_BENCHMARKS(SnowEmitter);
+EMITTER_BENCHMARKS(SplashEmitter);
+EMITTER_BENCHMARKS(SparkEmitter);
+EMITTER_BENCHMARKS(FogEmitter);
+EMITTER_BENCHMARKS(GrassSwayEmitter);
+#undef EMITTER_BENCHMARKS
+
+// Args: emitters, particles each. Many one-shots of a few particles, as rain
+// splashes and lightning sparks are in play; the kind steps as one pool however
+// they're split.
+void BM_SmallEmitters(benchmark::State& state) {
+    ParticleStore store;
+    std::vector<SplashEmitter> emitters;
+    auto refill = [&] {
+        emitters.clear();
+        for (int i = 0; i < state.range(0); ++i) {
+            emitters.emplace_back(store, SDL_FPoint{static_cast<float>(i % VIEW_W), static_cast<float>(i / VIEW_W)}).spawn_splash(static_cast<int>(state.range(1)));
+        }
+    };
+    refill();
+    size_t particles = 0;
+    for (auto _ : state) {
+        for (auto& e : emitters) e.update(STEP);
+        store.step(ParticleKind::SPLASH);
+        particles += store[ParticleKind::SPLASH].size();
+        if (store[ParticleKind::SPLASH].size() == 0) {  // Splashes last under half a second
+            state.PauseTiming();
+            refill();
+            state.ResumeTiming();
+        }
+    }
+    state.counters["particles"] = benchmark::Counter(static_cast<double>(particles), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_SmallEmitters)->ArgNames({"emitters", "each"})->Unit(benchmark::kMicrosecond)
+    ->Args({1, 100000})->Args({10000, 10})->Args({20000, 5});
+
+// Args: map size, scrolling. Still, every frame composites the cached regions;
+// scrolling a tile a frame shifts which regions are in view and draws any that
+// aren't cached yet.
+void BM_RenderLayer(benchmark::State& state) {
+    Offscreen out;
+    if (!out.renderer) {
+        state.SkipWithError(SDL_GetError());
+        return;
+    }
+    int size = static_cast<int>(state.range(0));
+    auto world = make_world(size);
+    Renderer renderer(out.renderer);
+    int centre = size / 2;
+    renderer.update_camera(centre, centre);
+    float time = 0.0f;
+    for (int i = 0; i < 10; ++i) renderer.render_world(*world, 1, time += STEP);  // Textures requested and uploaded
+
+    int frame = 0;
+    for (auto _ : state) {
+        if (state.range(1)) {
+            int offset = frame++ % 32 - 16;  // Back and forth over the prefetched area
+            renderer.update_camera(centre + offset, centre + offset);
+        }
+        renderer.render_layer(*world, 1, time += STEP);
+        SDL_FlushRenderer(out.renderer);
+    }
+    // Counts up from the last render_world, so this is per frame
+    state.counters["regions_redrawn"] = benchmark::Counter(static_cast<double>(renderer.tile_regions_redrawn()), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_RenderLayer)->ArgNames({"size", "scroll"})->Unit(benchmark::kMicrosecond)
+    ->ArgsProduct({{50, 200, 2000}, {0, 1}});
+
+// Args: map size, edit. A fresh Lighting builds every resident chunk; with
+// edit, one tile changes between calls and only its chunk is rebuilt.
+void BM_UpdateOccluders(benchmark::State& state) {
+    Offscreen out;
+    int size = static_cast<int>(state.range(0));
+    auto world = make_world(size);
+    int centre = size / 2;
+    auto lighting = std::make_unique<Lighting>(out.renderer);
+    lighting->update_occluders(world->get_tileset(), *world);
+    bool wall = false;
+    for (auto _ : state) {
+        state.PauseTiming();
+        if (state.range(1)) {
+            wall = !wall;
+            world->place_tile(1, centre + 1, centre + 1, 0, wall ? "wall" : "grass");
+        } else {
+            lighting = std::make_unique<Lighting>(out.renderer);
+        }
+        state.ResumeTiming();
+        lighting->update_occluders(world->get_tileset(), *world);
+    }
+    state.counters["chunks_rebuilt"] = static_cast<double>(lighting->occluder_chunks_rebuilt());
+}
+BENCHMARK(BM_UpdateOccluders)->ArgNames({"size", "edit"})->ArgsProduct({{50, 200, 2000}, {0, 1}});
+
+// Arg: light radius in tiles, over the walls of the synthetic map around the player
+void BM_ComputeVisibility(benchmark::State& state) {
+    Offscreen out;
+    auto world = make_world(200);
+    Lighting lighting(out.renderer);
+    lighting.update_occluders(world->get_tileset(), *world);
+    SDL_FPoint pos = grid_to_world(100.5f, 100.5f);
+    float reach = state.range(0) * 32.0f;  // Pixels per tile of Light::radius
+    std::vector<Occluder> walls;
+    lighting.occluders_in(1, {pos.x - reach, pos.y - reach, 2 * reach, 2 * reach}, walls);
+    for (auto _ : state) {
+        VisibilityPolygon poly = Lighting::compute_visibility(pos, reach, walls);
+        benchmark::DoNotOptimize(poly.points.data());
+    }
+    state.counters["walls"] = static_cast<double>(walls.size());
+}
+BENCHMARK(BM_ComputeVisibility)->ArgName("radius")->RangeMultiplier(2)->Range(4, 32);
+
+// Arg: tiles in the set; looked up by TileId, or by name with by_name
+void BM_TilesGet(benchmark::State& state) {
+    Tiles tiles;
+    tiles.load(tileset_path(static_cast<int>(state.range(0))));
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<TileId> pick(1, static_cast<TileId>(tiles.size() - 1));
+    std::vector<TileId> ids(LOOKUPS);
+    std::vector<std::string> names(LOOKUPS);
+    for (int i = 0; i < LOOKUPS; ++i) {
+        ids[i] = pick(rng);
+        names[i] = tiles.get(ids[i])->id;
+    }
+    for (auto _ : state) {
+        if (state.range(1)) {
+            for (const std::string& name : names) benchmark::DoNotOptimize(tiles.get(name));
+        } else {
+            for (TileId id : ids) benchmark::DoNotOptimize(tiles.get(id));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * LOOKUPS);
+}
+BENCHMARK(BM_TilesGet)->ArgNames({"tiles", "by_name"})->ArgsProduct({{16, 256, 4096}, {0, 1}});
+
+// Arg: items in the list; one lookup in eight misses
+void BM_ItemsGet(benchmark::State& state) {
+    int count = static_cast<int>(state.range(0));
+    nlohmann::json list = nlohmann::json::array();
+    for (int i = 0; i < count; ++i) {
+        list.push_back({{"id", "item_" + std::to_string(i)}, {"name", "Item " + std::to_string(i)},
+                        {"category", i % 2 ? "consumables" : "tools"}, {"price", i}});
+    }
+    fs::path path = scratch_dir() / ("items_" + std::to_string(count) + ".json");
+    write_json(path, {{"items", list}});
+    Items items;
+    items.load_from_json(path.string());
+
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> pick(0, count + count / 7);
+    std::vector<std::string> ids(LOOKUPS);
+    for (std::string& id : ids) id = "item_" + std::to_string(pick(rng));
+    for (auto _ : state) {
+        for (const std::string& id : ids) benchmark::DoNotOptimize(items.get(id));
+    }
+    state.SetItemsProcessed(state.iterations() * LOOKUPS);
+}
+BENCHMARK(BM_ItemsGet)->ArgName("items")->RangeMultiplier(16)->Range(16, 4096);
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    SDL_SetLogPriorities(SDL_LOG_PRIORITY_WARN);  // Placeholder tile images report themselves missing at info
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    std::error_code ignored;
+    fs::remove_all(scratch_dir(), ignored);
+    return 0;
+}
@@ -0,0 +1,21 @@
+// Converts a map.json into the binary .cmap format the engine memory-maps.
+// Usage: cataclysm-mapconv <map.json> <map.cmap>
+#include <cstdio>
+#include <iostream>
+#include "../game/chunk.h"  // CHUNK_LAYERS, CHUNK_HEIGHTS
+#include "../game/map_file.h"
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " <map.json> <map.cmap>" << std::endl;
+        return 1;
+    }
+
+    MapData map;
+    if (!read_json_map(argv[1], CHUNK_LAYERS, CHUNK_HEIGHTS, map)) return 1;
+    if (!write_map_file(argv[2], map)) return 1;
+
+    std::printf("Wrote %s: %dx%d, %d layers, %zu tile ids%s\n", argv[2], map.width, map.height, map.layers,
+                map.tile_names.size(), map.elev.empty() ? "" : ", biomes");
+    return 0;
+}
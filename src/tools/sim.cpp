@@ -0,0 +1,113 @@
+// Runs the simulation headless, with no window or audio device, as fast as it
+// will go, and reports its speed: ticks per second, peak memory and where the
+// time went in World::update.
+// Usage: cataclysm-sim [--ticks N] [--tiles tilesets.json] [--generate N | <map.cmap|map.json>]
+//                      [--weather clear|rain|snow] [--walk]
+#include <sys/resource.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include "../engine/input.h"
+#include "../game/world.h"
+
+namespace {
+
+struct PhaseStats {
+    const char* name;
+    float World::UpdateTimings::*field;
+    double total = 0.0, max = 0.0;  // Milliseconds
+};
+
+long peak_rss_kb() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;  // Kilobytes on Linux
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int ticks = 3600;
+    int generate_size = 0;
+    bool walk = false;
+    std::string tiles = "assets/data/tilesets.json", map, weather = "clear";
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--ticks" && i + 1 < argc) ticks = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--generate" && i + 1 < argc) generate_size = std::atoi(argv[++i]);
+        else if (arg == "--tiles" && i + 1 < argc) tiles = argv[++i];
+        else if (arg == "--weather" && i + 1 < argc) weather = argv[++i];
+        else if (arg == "--walk") walk = true;  // Holds east, so chunks page in as it goes
+        else if (arg[0] != '-') map = arg;
+        else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--ticks N] [--tiles tilesets.json] [--generate N | <map.cmap|map.json>]"
+                         " [--weather clear|rain|snow] [--walk]" << std::endl;
+            return 1;
+        }
+    }
+
+    World world;  // NullAudio, and no renderer at all
+    world.load_tiles(tiles);
+    if (generate_size > 0) world.generate_map(generate_size, generate_size, 42);
+    else if (!map.empty()) world.load_map(map);
+    else if (std::filesystem::exists("assets/data/map.cmap")) world.load_map("assets/data/map.cmap");  // As the game picks
+    else world.load_map("assets/data/map.json");
+    if (world.width() == 0) {
+        std::cerr << "No map loaded" << std::endl;
+        return 1;
+    }
+    if (weather == "rain") world.set_weather(World::Weather::RAIN);
+    else if (weather == "snow") world.set_weather(World::Weather::SNOW);
+
+    Actor& player = world.get_actors().emplace_back();
+    player.x = std::min(25, world.width() - 1);
+    player.y = std::min(25, world.height() - 1);
+    player.current_map_layer = 1;
+    world.prefetch(player.x, player.y);
+    long setup_rss = peak_rss_kb();
+
+    Input input;
+    if (walk) {
+        SDL_Event event{};
+        event.type = SDL_EVENT_KEY_DOWN;
+        event.key.key = SDLK_d;
+        input.handle_event(event);
+    }
+
+    PhaseStats phases[] = {
+        {"paging", &World::UpdateTimings::paging},
+        {"tick", &World::UpdateTimings::tick},
+        {"vision", &World::UpdateTimings::vision},
+        {"lighting", &World::UpdateTimings::lighting},
+        {"audio", &World::UpdateTimings::audio},
+        {"particles", &World::UpdateTimings::particles},
+    };
+    const float step = 1.0f / 60.0f;  // The game's fixed step
+    double slowest = 0.0;
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < ticks; ++t) {
+        auto tick_start = std::chrono::steady_clock::now();
+        world.update(input, step);
+        world.update_time(step);
+        slowest = std::max(slowest, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tick_start).count());
+        const World::UpdateTimings& timings = world.last_timings();
+        for (PhaseStats& p : phases) {
+            p.total += timings.*p.field;
+            p.max = std::max<double>(p.max, timings.*p.field);
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::printf("%d ticks in %.3f s: %.1f ticks/s (%.1fx real time), slowest %.3f ms\n", ticks, seconds,
+                ticks / seconds, ticks * step / seconds, slowest);
+    std::printf("Map %dx%d, player ended at (%d, %d)\n", world.width(), world.height(), player.x, player.y);
+    std::printf("Peak RSS %.1f MB (%.1f MB after loading)\n", peak_rss_kb() / 1024.0, setup_rss / 1024.0);
+    std::printf("%-10s %10s %10s\n", "phase", "mean ms", "max ms");
+    for (const PhaseStats& p : phases) std::printf("%-10s %10.4f %10.4f\n", p.name, p.total / ticks, p.max);
+    return 0;
+}
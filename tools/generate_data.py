@@ -1,4 +1,5 @@
 import json
+import struct
 import pandas as pd
 import numpy as np
 import os
@@ -57,6 +58,78 @@ def generate_tile_atlas(tile_id, frames=4, size=64):
     atlas.save(atlas_path)
     return [f"{tile_id}_frame{i}.png" for i in range(frames)]
 
+def generate_particle_atlas(size=16):
+    """White sprites in one strip; the renderer tints them per particle. Kinds left out draw as flat quads."""
+    shapes = ['soft', 'puff', 'flake']
+    atlas = Image.new('RGBA', (size * len(shapes), size), (255,255,255,0))
+    c = (size - 1) / 2
+    for i, shape in enumerate(shapes):
+        img = Image.new('RGBA', (size, size), (255,255,255,0))
+        for y in range(size):
+            for x in range(size):
+                d = np.hypot(x - c, y - c) / (size / 2)
+                if shape == 'soft':
+                    alpha = max(0.0, 1 - d) ** 2
+                elif shape == 'puff':
+                    alpha = max(0.0, 1 - d ** 2) * 0.8
+                else:  # Six-armed flake
+                    arm = abs(np.sin(3 * np.arctan2(y - c, x - c)))
+                    alpha = 1.0 if d < 0.25 or (d < 0.9 and arm > 0.85) else 0.0
+                img.putpixel((x, y), (255, 255, 255, int(alpha * 255)))
+        atlas.paste(img, (i * size, 0))
+    atlas.save('../assets/graphics/particles.png')
+
+    rect = {shape: [i * size, 0, size, size] for i, shape in enumerate(shapes)}
+    sprites = {'fire': rect['soft'], 'spark': rect['soft'], 'splash': rect['soft'],
+               'smoke': rect['puff'], 'fog': rect['puff'], 'snow': rect['flake']}
+    with open('../assets/data/particles.json', 'w') as f:
+        json.dump({'image': 'graphics/particles.png', 'sprites': sprites}, f, indent=2)
+
+def write_binary_map(map_json, path, layers=6, heights=3):
+    """Writes map_json in the engine's memory-mapped .cmap format (see src/game/map_file.h)."""
+    map_data = map_json['map']
+    first_layer = next(iter(map_data.values()), [])
+    width = len(first_layer)
+    height = len(first_layer[0]) if width else 0
+
+    names = ['']
+    index = {'': 0, 'empty': 0}
+    cells = np.zeros((layers, heights, height, width), dtype='<u2')
+    for layer, columns in map_data.items():
+        if int(layer) >= layers:
+            continue
+        for x, column in enumerate(columns):
+            for y, h_list in enumerate(column):
+                for entry in h_list:
+                    h = entry['height']
+                    if h >= heights:
+                        continue
+                    tile = entry['tile']
+                    if tile not in index:
+                        index[tile] = len(names)
+                        names.append(tile)
+                    cells[int(layer), h, y, x] = index[tile]
+
+    biomes = map_json.get('biomes')
+    has_biomes = bool(biomes and biomes['elev'])
+    strings = b''.join(struct.pack('<H', len(n.encode())) + n.encode() for n in names)
+    align8 = lambda v: (v + 7) & ~7
+    header_size = 56
+    cells_offset = align8(header_size + len(strings))
+    biomes_offset = align8(cells_offset + cells.nbytes) if has_biomes else 0
+
+    with open(path, 'wb') as f:
+        f.write(struct.pack('<4sIIIIIIIQQQ', b'CMAP', 1, width, height, layers, heights, len(names),
+                            1 if has_biomes else 0, header_size, cells_offset, biomes_offset))
+        f.write(strings)
+        f.write(b'\0' * (cells_offset - f.tell()))
+        f.write(cells.tobytes())
+        if has_biomes:
+            f.write(b'\0' * (biomes_offset - f.tell()))
+            # Stored [y][x]; the JSON planes are [x][y]
+            f.write(np.asarray(biomes['elev'], dtype='<f4').T.tobytes())
+            f.write(np.asarray(biomes['moist'], dtype='<f4').T.tobytes())
+
 def generate_data():
     # Items gen
     items_dir = 'items/'
@@ -202,6 +275,8 @@ def generate_data():
     map_json = generate_multi_layer_map()
     with open('../assets/data/map.json', 'w') as f:
         json.dump(map_json, f, indent=2)
+    write_binary_map(map_json, '../assets/data/map.cmap')
+    generate_particle_atlas()
 
 if __name__ == '__main__':
     generate_data()